@@ -1,5 +1,7 @@
 #pragma once
 
+#include "UnicodeTranscoding.h"
+
 namespace StringUtils
 {
 
@@ -53,35 +55,17 @@ inline void ToLowerAsciiInline(std::wstring& str)
 
 inline std::string Utf16ToUtf8(std::wstring_view utf16)
 {
-	if (utf16.empty())
-		return std::string();
-
-	auto utf8Length = WideCharToMultiByte(CP_UTF8, 0, utf16.data(), static_cast<int>(utf16.length()), nullptr, 0, nullptr, nullptr);
-	if (utf8Length == 0)
-		__fastfail(0);
-
 	std::string utf8;
-	utf8.resize(utf8Length);
-	utf8Length = WideCharToMultiByte(CP_UTF8, 0, utf16.data(), static_cast<int>(utf16.length()), &utf8[0], utf8Length, nullptr, nullptr);
-	Assert(utf8Length != 0);
-
+	utf8.resize(GetMaxUtf8Length(utf16.length()));
+	utf8.resize(Utf16ToUtf8(utf16.data(), utf16.length(), utf8.data()));
 	return utf8;
 }
 
 inline std::wstring Utf8ToUtf16(std::string_view utf8)
 {
-	if (utf8.empty())
-		return std::wstring();
-
-	auto utf16Length = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.length()), nullptr, 0);
-	if (utf16Length == 0)
-		__fastfail(0);
-
 	std::wstring utf16;
-	utf16.resize(utf16Length);
-	utf16Length = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.length()), &utf16[0], utf16Length);
-	Assert(utf16Length != 0);
-
+	utf16.resize(GetMaxUtf16Length(utf8.length()));
+	utf16.resize(Utf8ToUtf16(utf8.data(), utf8.length(), utf16.data()));
 	return utf16;
 }
 
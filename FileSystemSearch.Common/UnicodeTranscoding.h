@@ -0,0 +1,258 @@
+#pragma once
+
+// UTF-8 <-> UTF-16 transcoding into caller provided buffers. Runs of ASCII, which most paths and search strings consist of,
+// are converted 8 or 16 code units at a time. Invalid input is replaced with U+FFFD like the Win32 conversion functions do.
+// Doesn't depend on Windows, and takes any 16-bit code unit type, so it can be built and tested anywhere.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define UNICODE_TRANSCODING_SSE2 1
+#endif
+
+namespace StringUtils
+{
+
+constexpr inline size_t GetMaxUtf8Length(size_t utf16Length)
+{
+	return 3 * utf16Length;
+}
+
+constexpr inline size_t GetMaxUtf16Length(size_t utf8Length)
+{
+	return utf8Length;
+}
+
+namespace Details
+{
+
+constexpr uint32_t kReplacementCharacter = 0xFFFD;
+
+template <typename CodeUnit>
+inline size_t CopyAsciiUtf16ToUtf8(const CodeUnit* source, size_t length, char* destination)
+{
+	size_t i = 0;
+
+#if UNICODE_TRANSCODING_SSE2
+	const auto nonAsciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+	for (; length - i >= 8; i += 8)
+	{
+		auto units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, nonAsciiMask), _mm_setzero_si128())) != 0xFFFF)
+			break;
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(units, units));
+	}
+#else
+	for (; length - i >= 4; i += 4)
+	{
+		uint64_t units;
+		memcpy(&units, source + i, sizeof(units));
+		if ((units & 0xFF80FF80FF80FF80ull) != 0)
+			break;
+
+		for (size_t j = 0; j < 4; j++)
+			destination[i + j] = static_cast<char>(units >> (16 * j));
+	}
+#endif
+
+	return i;
+}
+
+template <typename CodeUnit>
+inline size_t CopyAsciiUtf8ToUtf16(const char* source, size_t length, CodeUnit* destination)
+{
+	size_t i = 0;
+
+#if UNICODE_TRANSCODING_SSE2
+	for (; length - i >= 16; i += 16)
+	{
+		auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+		if (_mm_movemask_epi8(bytes) != 0)
+			break;
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_unpacklo_epi8(bytes, _mm_setzero_si128()));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i + 8), _mm_unpackhi_epi8(bytes, _mm_setzero_si128()));
+	}
+#else
+	for (; length - i >= 8; i += 8)
+	{
+		uint64_t bytes;
+		memcpy(&bytes, source + i, sizeof(bytes));
+		if ((bytes & 0x8080808080808080ull) != 0)
+			break;
+
+		for (size_t j = 0; j < 8; j++)
+			destination[i + j] = static_cast<CodeUnit>((bytes >> (8 * j)) & 0xFF);
+	}
+#endif
+
+	return i;
+}
+
+}
+
+// destination must have room for GetMaxUtf8Length(length) bytes. Returns how many were written
+template <typename CodeUnit>
+inline size_t Utf16ToUtf8(const CodeUnit* source, size_t length, char* destination)
+{
+	static_assert(sizeof(CodeUnit) == 2, "UTF-16 code units have to be 2 bytes");
+
+	size_t i = 0;
+	char* output = destination;
+
+	while (i < length)
+	{
+		auto asciiLength = Details::CopyAsciiUtf16ToUtf8(source + i, length - i, output);
+		i += asciiLength;
+		output += asciiLength;
+
+		for (; i < length; i++)
+		{
+			uint32_t codePoint = static_cast<uint16_t>(source[i]);
+
+			if (codePoint < 0x80)
+			{
+				*output++ = static_cast<char>(codePoint);
+
+				// Back to the vectorized loop once the text looks like ASCII again
+				if (i + 1 < length && static_cast<uint16_t>(source[i + 1]) < 0x80)
+				{
+					i++;
+					break;
+				}
+			}
+			else if (codePoint < 0x800)
+			{
+				*output++ = static_cast<char>(0xC0 | (codePoint >> 6));
+				*output++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+				{
+					uint32_t nextUnit = i + 1 < length ? static_cast<uint16_t>(source[i + 1]) : 0;
+					if (codePoint <= 0xDBFF && nextUnit >= 0xDC00 && nextUnit <= 0xDFFF)
+					{
+						codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (nextUnit - 0xDC00);
+						*output++ = static_cast<char>(0xF0 | (codePoint >> 18));
+						*output++ = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+						*output++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+						*output++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+						i++;
+						continue;
+					}
+
+					codePoint = Details::kReplacementCharacter;
+				}
+
+				*output++ = static_cast<char>(0xE0 | (codePoint >> 12));
+				*output++ = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				*output++ = static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+		}
+	}
+
+	return static_cast<size_t>(output - destination);
+}
+
+// destination must have room for GetMaxUtf16Length(length) code units. Returns how many were written.
+// Each maximal invalid subsequence becomes a single U+FFFD
+template <typename CodeUnit>
+inline size_t Utf8ToUtf16(const char* source, size_t length, CodeUnit* destination)
+{
+	static_assert(sizeof(CodeUnit) == 2, "UTF-16 code units have to be 2 bytes");
+
+	auto bytes = reinterpret_cast<const uint8_t*>(source);
+	size_t i = 0;
+	CodeUnit* output = destination;
+
+	while (i < length)
+	{
+		auto asciiLength = Details::CopyAsciiUtf8ToUtf16(source + i, length - i, output);
+		i += asciiLength;
+		output += asciiLength;
+
+		while (i < length)
+		{
+			const uint8_t leadByte = bytes[i];
+
+			if (leadByte < 0x80)
+			{
+				*output++ = static_cast<CodeUnit>(leadByte);
+				i++;
+
+				if (i < length && bytes[i] < 0x80)
+					break;
+
+				continue;
+			}
+
+			// Sequence length and the range of the second byte, which rules out overlong forms, surrogates and code points past U+10FFFF
+			size_t sequenceLength = 0;
+			uint8_t secondByteMin = 0x80, secondByteMax = 0xBF;
+
+			if (leadByte >= 0xC2 && leadByte <= 0xDF)
+			{
+				sequenceLength = 2;
+			}
+			else if (leadByte >= 0xE0 && leadByte <= 0xEF)
+			{
+				sequenceLength = 3;
+				if (leadByte == 0xE0)
+					secondByteMin = 0xA0;
+				else if (leadByte == 0xED)
+					secondByteMax = 0x9F;
+			}
+			else if (leadByte >= 0xF0 && leadByte <= 0xF4)
+			{
+				sequenceLength = 4;
+				if (leadByte == 0xF0)
+					secondByteMin = 0x90;
+				else if (leadByte == 0xF4)
+					secondByteMax = 0x8F;
+			}
+
+			size_t validLength = sequenceLength == 0 ? 0 : 1;
+			uint32_t codePoint = leadByte & (0x7F >> sequenceLength);
+
+			for (; validLength < sequenceLength && i + validLength < length; validLength++)
+			{
+				const uint8_t continuationByte = bytes[i + validLength];
+				const uint8_t minimum = validLength == 1 ? secondByteMin : 0x80;
+				const uint8_t maximum = validLength == 1 ? secondByteMax : 0xBF;
+				if (continuationByte < minimum || continuationByte > maximum)
+					break;
+
+				codePoint = (codePoint << 6) | (continuationByte & 0x3F);
+			}
+
+			if (sequenceLength == 0 || validLength != sequenceLength)
+			{
+				*output++ = static_cast<CodeUnit>(Details::kReplacementCharacter);
+				i += validLength == 0 ? 1 : validLength;
+				continue;
+			}
+
+			if (codePoint >= 0x10000)
+			{
+				codePoint -= 0x10000;
+				*output++ = static_cast<CodeUnit>(0xD800 + (codePoint >> 10));
+				*output++ = static_cast<CodeUnit>(0xDC00 + (codePoint & 0x3FF));
+			}
+			else
+			{
+				*output++ = static_cast<CodeUnit>(codePoint);
+			}
+
+			i += sequenceLength;
+		}
+	}
+
+	return static_cast<size_t>(output - destination);
+}
+
+}
\ No newline at end of file
@@ -132,6 +132,9 @@ SearchResultWindow::SearchResultWindow(std::unique_ptr<SearchResultWindowArgumen
         args->searchString.c_str(),
         args->searchFlags,
         args->ignoreFilesLargerThan,
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
         this);
 
     m_HeaderText = L"Results for \"";
@@ -2,6 +2,8 @@
 
 #include "SearchEngineTypes.h"
 
+// Keeps file content reads to at most maxReadBytesPerSecond bytes and maxReadsPerSecond reads a second from the first read on, 0 leaving either unlimited.
+// The same goes for the searches below
 extern "C" EXPORT_SEARCHENGINE FileSearcher* Search(
 	FoundPathCallback foundPathCallback,
 	SearchProgressUpdated progressUpdatedCallback,
@@ -12,6 +14,81 @@ extern "C" EXPORT_SEARCHENGINE FileSearcher* Search(
 	const wchar_t* searchString,
 	SearchFlags searchFlags,
 	uint64_t ignoreFilesLargerThan,
+	uint64_t maxResults,
+	uint64_t maxReadBytesPerSecond,
+	uint32_t maxReadsPerSecond,
 	void* callbackContext);
 
-extern "C" EXPORT_SEARCHENGINE void CleanupSearchOperation(FileSearcher* searcher);
\ No newline at end of file
+// Searches file contents for every entry of a dictionary file (one UTF-8 entry per line) at once.
+// Files containing any entry are reported through foundPathCallback, followed by the zero based line indices of the entries they contain.
+extern "C" EXPORT_SEARCHENGINE FileSearcher* SearchWithDictionary(
+	FoundPathCallback foundPathCallback,
+	SearchProgressUpdated progressUpdatedCallback,
+	SearchDoneCallback searchDoneCallback,
+	ErrorCallback errorCallback,
+	DictionaryMatchesCallback dictionaryMatchesCallback,
+	const wchar_t* searchPath,
+	const wchar_t* searchPattern,
+	const wchar_t* dictionaryPath,
+	SearchFlags searchFlags,
+	uint64_t ignoreFilesLargerThan,
+	uint64_t maxResults,
+	uint64_t maxReadBytesPerSecond,
+	uint32_t maxReadsPerSecond,
+	void* callbackContext);
+
+// Searches file contents for firstSearchString and secondSearchString starting no more than maxDistance bytes apart, in either order.
+// maxDistance cannot exceed 65536.
+extern "C" EXPORT_SEARCHENGINE FileSearcher* SearchWithProximity(
+	FoundPathCallback foundPathCallback,
+	SearchProgressUpdated progressUpdatedCallback,
+	SearchDoneCallback searchDoneCallback,
+	ErrorCallback errorCallback,
+	const wchar_t* searchPath,
+	const wchar_t* searchPattern,
+	const wchar_t* firstSearchString,
+	const wchar_t* secondSearchString,
+	uint32_t maxDistance,
+	SearchFlags searchFlags,
+	uint64_t ignoreFilesLargerThan,
+	uint64_t maxResults,
+	uint64_t maxReadBytesPerSecond,
+	uint32_t maxReadsPerSecond,
+	void* callbackContext);
+
+// Stops the search if it's still running, and frees it. Reads in flight are cancelled rather than waited out and the file system enumeration stops
+// partway through a directory, so it's meant to return within 100 ms. Only opening a file, or a read the file system won't cancel, can take longer
+extern "C" EXPORT_SEARCHENGINE void CleanupSearchOperation(FileSearcher* searcher);
+
+// Changes the limits the search's file content reads were started with, 0 leaving either side unlimited.
+// Can be called at any point while the search runs, and takes effect for the reads it hasn't issued yet
+extern "C" EXPORT_SEARCHENGINE void SetSearchReadRateLimit(FileSearcher* searcher, uint64_t maxBytesPerSecond, uint32_t maxReadsPerSecond);
+
+// Reads file contents in chunks of chunkSize bytes, rounded up to whole pages, in searches started after this call, instead of picking a size
+// for each file from its size and the device it's on. 0 goes back to picking sizes. Applies to every search in the process, so it's only meant for tuning
+extern "C" EXPORT_SEARCHENGINE void SetReadChunkSizeOverride(uint32_t chunkSize);
+
+// Keeps up to queueDepth reads in flight against each device in searches started after this call, instead of tuning the limit while searching.
+// 0 goes back to tuning. Applies to every search in the process, so it's only meant for tuning
+extern "C" EXPORT_SEARCHENGINE void SetReadQueueDepthOverride(uint32_t queueDepth);
+
+// Searches in-memory buffers with the same matching as file content searches, spreading each batch over a pool of worker threads.
+// Only kSearchContentsAsUtf8, kSearchContentsAsUtf16, kIgnoreCase and kIgnoreWhitespace are used from searchFlags.
+// Returns nullptr if the search string is empty, longer than 1024 characters or can't be searched for with these flags.
+extern "C" EXPORT_SEARCHENGINE BufferSearcher* CreateBufferSearcher(const wchar_t* searchString, SearchFlags searchFlags);
+
+// Sets matches[i] to whether buffers[i] contains the search string, and returns once the whole batch has been searched.
+// The buffers are never modified. Multiple threads can search batches with the same searcher at once.
+extern "C" EXPORT_SEARCHENGINE void SearchBuffers(BufferSearcher* bufferSearcher, const SearchBuffer* buffers, uint32_t bufferCount, bool* matches);
+extern "C" EXPORT_SEARCHENGINE void FreeBufferSearcher(BufferSearcher* bufferSearcher);
+
+// Searches a byte stream fed in chunks of any size. Occurrences spanning chunks are found without the caller keeping any overlap,
+// and matchCallback receives each one's offset from the start of the stream before FeedStreamSearcher returns.
+// Only kSearchContentsAsUtf8, kSearchContentsAsUtf16 and kIgnoreCase are used from searchFlags; case insensitive search strings must be ASCII.
+// Returns nullptr if the search string is empty, longer than 1024 characters or can't be searched for with these flags.
+extern "C" EXPORT_SEARCHENGINE StreamSearcher* CreateStreamSearcher(const wchar_t* searchString, SearchFlags searchFlags, StreamMatchCallback matchCallback, void* callbackContext);
+extern "C" EXPORT_SEARCHENGINE void FeedStreamSearcher(StreamSearcher* streamSearcher, const uint8_t* bytes, size_t byteCount);
+
+// Starts a new stream, forgetting any bytes carried over from the previous one
+extern "C" EXPORT_SEARCHENGINE void ResetStreamSearcher(StreamSearcher* streamSearcher);
+extern "C" EXPORT_SEARCHENGINE void FreeStreamSearcher(StreamSearcher* streamSearcher);
\ No newline at end of file
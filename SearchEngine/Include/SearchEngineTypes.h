@@ -8,13 +8,31 @@ struct SearchStatistics
 	uint64_t resultsFound;
 	uint64_t totalFileSize;
 	int64_t scannedFileSize;
+	uint64_t binaryFilesSkipped;
+	int64_t binaryFileSizeSkipped;
+	int64_t bytesReadFromCache; // File contents read through ReadFile, by where they came from. Mapped views and DirectStorage reads aren't counted
+	int64_t bytesReadFromDisk;
+	uint64_t maxDeviceReadsInFlight; // The most reads one device had in flight at once. DirectStorage reads aren't counted either
+	int64_t compressedFileSize; // Of the compressed files searched, as read and as decompressed. It's the compressed size that counts as scanned
+	int64_t decompressedFileSize;
+	uint64_t dictionaryEntryCount;
+	uint64_t dictionaryMemoryUsage;
+	double dictionaryBuildTimeInSeconds;
 	double searchTimeInSeconds;
 };
 
+struct SearchBuffer
+{
+	const void* bytes;
+	uint64_t length;
+};
+
 typedef void(__stdcall* FoundPathCallback)(void* context, const WIN32_FIND_DATAW& findData, const wchar_t* path);
 typedef void(__stdcall* SearchProgressUpdated)(void* context, const SearchStatistics& searchStatistics, double progress);
 typedef void(__stdcall* SearchDoneCallback)(void* context, const SearchStatistics& searchStatistics);
 typedef void(__stdcall* ErrorCallback)(void* context, const wchar_t* errorMessage);
+typedef void(__stdcall* DictionaryMatchesCallback)(void* context, const wchar_t* path, const uint32_t* matchedEntries, uint32_t matchedEntryCount);
+typedef void(__stdcall* StreamMatchCallback)(void* context, uint64_t matchOffset);
 
 #define SearchFlagsEnumDefinition \
 	EnumValue(None,			              0) \
@@ -31,6 +49,18 @@ typedef void(__stdcall* ErrorCallback)(void* context, const wchar_t* errorMessag
 	EnumValue(IgnoreCase,            1 << 10) \
 	EnumValue(IgnoreDotStart,        1 << 11) \
 	EnumValue(UseDirectStorage,      1 << 12) \
+	EnumValue(SkipBinaryFiles,       1 << 13) \
+	EnumValue(IgnoreWhitespace,      1 << 14) \
+	EnumValue(InvertContentMatch,    1 << 15) \
+	EnumValue(UseCompletionPort,     1 << 16) \
+	EnumValue(UseFileMapping,        1 << 17) \
+	EnumValue(UseUnbufferedIO,       1 << 18) \
+	EnumValue(CacheNeutralReads,     1 << 19) \
+	EnumValue(SearchCompressedFiles, 1 << 20) \
+	EnumValue(SearchInArchives,      1 << 21) \
+	EnumValue(UseOverlappedIO,       1 << 22) \
+	EnumValue(SearchForProximity,    1 << 29) /* Internal */ \
+	EnumValue(SearchForDictionaryEntries, 1 << 30) /* Internal */ \
 	EnumValue(SearchStringIsAscii,   1 << 31) // Internal
 
 enum class SearchFlags
@@ -42,4 +72,6 @@ enum class SearchFlags
 
 MAKE_BIT_OPERATORS_FOR_ENUM_CLASS(SearchFlags)
 
-class FileSearcher;
\ No newline at end of file
+class BufferSearcher;
+class FileSearcher;
+class StreamSearcher;
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "PrecompiledHeader.h"
+#include "BufferSearcher.h"
+#include "StringUtils.h"
+#include "Utilities/ScopedStackAllocator.h"
+
+// Buffers are searched this many bytes at a time, so case folding copies stay in the cache
+constexpr size_t kSearchBlockSize = 1024 * 1024;
+
+// Work items cover roughly this many bytes: fewer would make queueing them cost more than searching them
+constexpr uint64_t kWorkItemSize = 8 * kSearchBlockSize;
+
+static SearchFlags GetBufferSearchFlags(SearchFlags searchFlags)
+{
+	// Only the flags that affect how contents are matched apply to buffers
+	searchFlags &= SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSearchContentsAsUtf16 | SearchFlags::kIgnoreCase | SearchFlags::kIgnoreWhitespace;
+	searchFlags |= SearchFlags::kSearchInFileContents;
+
+	if ((searchFlags & (SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSearchContentsAsUtf16)) == SearchFlags::kNone)
+		searchFlags |= SearchFlags::kSearchContentsAsUtf8;
+
+	return searchFlags;
+}
+
+BufferSearcher* BufferSearcher::Create(const wchar_t* searchString, SearchFlags searchFlags)
+{
+	std::wstring searchStringCopy(searchString);
+	if (searchStringCopy.empty() || searchStringCopy.length() > 1024)
+		return nullptr;
+
+	// Case insensitive UTF-8 searches only support ASCII search strings
+	searchFlags = GetBufferSearchFlags(searchFlags);
+	if ((searchFlags & SearchFlags::kIgnoreCase) != SearchFlags::kNone && (searchFlags & SearchFlags::kSearchContentsAsUtf8) != SearchFlags::kNone && !StringUtils::IsAscii(searchStringCopy))
+		return nullptr;
+
+	auto bufferSearcher = new BufferSearcher(searchString, searchFlags);
+
+	SYSTEM_INFO systemInfo;
+	GetNativeSystemInfo(&systemInfo);
+	bufferSearcher->MyBase::Initialize<&BufferSearcher::SearchThread>(bufferSearcher, systemInfo.dwNumberOfProcessors);
+
+	return bufferSearcher;
+}
+
+BufferSearcher::BufferSearcher(const wchar_t* searchString, SearchFlags searchFlags) :
+	m_SearchInstructions(nullptr, nullptr, nullptr, nullptr, L"", L"", searchString, searchFlags, 0, std::numeric_limits<uint64_t>::max(), 0, 0, nullptr),
+	m_StringSearcher(m_SearchInstructions),
+	m_MaxMatchLength(m_StringSearcher.GetMaxMatchLengthInBytes())
+{
+}
+
+BufferSearcher::~BufferSearcher()
+{
+	// The worker threads use the string searcher, so they have to be gone before it is
+	CompleteAllWork();
+}
+
+void BufferSearcher::SearchBuffers(const SearchBuffer* buffers, uint32_t bufferCount, bool* matches)
+{
+	BufferSearchBatch batch;
+	batch.buffers = buffers;
+	batch.matches = matches;
+	batch.pendingWorkItems = 1; // Keeps the batch from completing while we're still queueing it
+
+	for (uint32_t i = 0; i < bufferCount; i++)
+		matches[i] = false;
+
+	uint32_t groupStart = 0;
+	uint64_t groupSize = 0;
+
+	for (uint32_t i = 0; i < bufferCount; i++)
+	{
+		const auto length = buffers[i].length;
+
+		if (length <= kWorkItemSize)
+		{
+			groupSize += length;
+			if (groupSize < kWorkItemSize && i + 1 < bufferCount)
+				continue;
+
+			batch.pendingWorkItems++;
+			PushWorkItem(&batch, groupStart, i + 1, 0, std::numeric_limits<uint64_t>::max());
+		}
+		else
+		{
+			if (groupStart < i)
+			{
+				batch.pendingWorkItems++;
+				PushWorkItem(&batch, groupStart, i, 0, std::numeric_limits<uint64_t>::max());
+			}
+
+			for (uint64_t rangeBegin = 0; rangeBegin < length; rangeBegin += kWorkItemSize)
+			{
+				batch.pendingWorkItems++;
+				PushWorkItem(&batch, i, i + 1, rangeBegin, std::min(length, rangeBegin + kWorkItemSize));
+			}
+		}
+
+		groupStart = i + 1;
+		groupSize = 0;
+	}
+
+	CompleteWorkItem(batch);
+
+	auto waitResult = WaitForSingleObject(batch.doneEvent, INFINITE);
+	Assert(waitResult == WAIT_OBJECT_0);
+}
+
+void BufferSearcher::CompleteWorkItem(BufferSearchBatch& batch)
+{
+	if (--batch.pendingWorkItems == 0)
+		batch.doneEvent.Set();
+}
+
+void BufferSearcher::SearchThread()
+{
+	SetThreadDescription(GetCurrentThread(), L"FSS Buffer Search Thread");
+
+	ScopedStackAllocator stackAllocator;
+	std::unique_ptr<uint8_t[]> foldBuffer;
+
+	if (m_StringSearcher.ModifiesSearchedBytes())
+		foldBuffer.reset(new uint8_t[kSearchBlockSize + m_MaxMatchLength]);
+
+	DoWork([this, &stackAllocator, &foldBuffer](const BufferSearchWorkItem& workItem)
+	{
+		auto& batch = *workItem.batch;
+
+		for (uint32_t i = workItem.firstBuffer; i < workItem.lastBuffer; i++)
+		{
+			const auto& buffer = batch.buffers[i];
+			std::atomic_ref<bool> match(batch.matches[i]);
+
+			// Another part of a split buffer may have found a match already
+			if (buffer.length == 0 || match.load(std::memory_order_relaxed))
+				continue;
+
+			auto bytes = static_cast<const uint8_t*>(buffer.bytes);
+			auto rangeEnd = std::min(workItem.rangeEnd, buffer.length);
+
+			for (auto blockStart = workItem.rangeBegin; blockStart < rangeEnd; blockStart += kSearchBlockSize)
+			{
+				// Every block reaches far enough past its end to hold a match starting in it
+				auto blockLength = static_cast<uint32_t>(std::min<uint64_t>(buffer.length - blockStart, kSearchBlockSize + m_MaxMatchLength));
+				uint8_t* blockBytes;
+
+				if (foldBuffer != nullptr)
+				{
+					memcpy(foldBuffer.get(), bytes + blockStart, blockLength);
+					blockBytes = foldBuffer.get();
+				}
+				else
+				{
+					// Nothing writes to the bytes unless ModifiesSearchedBytes says so
+					blockBytes = const_cast<uint8_t*>(bytes + blockStart);
+				}
+
+				if (m_StringSearcher.PerformFileContentSearch(blockBytes, blockLength, stackAllocator))
+				{
+					match.store(true, std::memory_order_relaxed);
+					break;
+				}
+
+				if (match.load(std::memory_order_relaxed))
+					break;
+			}
+		}
+
+		CompleteWorkItem(batch);
+	});
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Event.h"
+#include "SearchInstructions.h"
+#include "StringSearch/StringSearcher.h"
+#include "Utilities/WorkQueue.h"
+
+struct BufferSearchBatch
+{
+	const SearchBuffer* buffers;
+	bool* matches;
+	std::atomic<uint32_t> pendingWorkItems;
+	Event<EventType::ManualReset> doneEvent;
+};
+
+struct BufferSearchWorkItem
+{
+	BufferSearchBatch* batch;
+	uint32_t firstBuffer;
+	uint32_t lastBuffer;
+
+	// Only matches starting in this range are looked for, which lets a big buffer be split across work items
+	uint64_t rangeBegin;
+	uint64_t rangeEnd;
+
+	BufferSearchWorkItem(BufferSearchBatch* batch, uint32_t firstBuffer, uint32_t lastBuffer, uint64_t rangeBegin, uint64_t rangeEnd) :
+		batch(batch),
+		firstBuffer(firstBuffer),
+		lastBuffer(lastBuffer),
+		rangeBegin(rangeBegin),
+		rangeEnd(rangeEnd)
+	{
+	}
+};
+
+// Searches batches of in-memory buffers on a pool of worker threads with the same kernels file content searches use.
+// Small buffers are grouped into one work item and big ones are split across several, so a batch spreads evenly over the pool.
+// Batches can be searched from multiple threads at once.
+class BufferSearcher : ThreadedWorkQueue<BufferSearcher, BufferSearchWorkItem>
+{
+public:
+	// Returns nullptr for search strings the content search kernels can't look for
+	static BufferSearcher* Create(const wchar_t* searchString, SearchFlags searchFlags);
+	~BufferSearcher();
+
+	void SearchBuffers(const SearchBuffer* buffers, uint32_t bufferCount, bool* matches);
+
+private:
+	typedef ThreadedWorkQueue<BufferSearcher, BufferSearchWorkItem> MyBase;
+
+	BufferSearcher(const wchar_t* searchString, SearchFlags searchFlags);
+
+	void SearchThread();
+	void CompleteWorkItem(BufferSearchBatch& batch);
+
+private:
+	const SearchInstructions m_SearchInstructions;
+	StringSearcher m_StringSearcher;
+	const size_t m_MaxMatchLength;
+};
\ No newline at end of file
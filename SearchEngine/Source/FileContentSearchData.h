@@ -92,3 +92,23 @@ struct FileOpenData : NonCopyable
 		return *this;
 	}
 };
+
+struct SlotSearchData
+{
+	uint32_t size;
+	uint16_t slot;
+	bool isFirstChunk;
+	bool searched;
+	bool found;
+	bool isBinary;
+
+	SlotSearchData(uint16_t slot, uint32_t size, bool isFirstChunk) :
+		size(size),
+		slot(slot),
+		isFirstChunk(isFirstChunk),
+		searched(false),
+		found(false),
+		isBinary(false)
+	{
+	}
+};
\ No newline at end of file
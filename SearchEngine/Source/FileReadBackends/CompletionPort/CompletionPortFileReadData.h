@@ -0,0 +1,68 @@
+#pragma once
+
+#include "FileContentSearchData.h"
+#include "HandleHolder.h"
+
+class DeviceReadQueue;
+
+// Where a file starts: the volume it's on, and its first cluster there. Cluster numbers only compare within a volume, so files sort by volume first
+struct DiskLocation
+{
+	uint32_t volumeSerialNumber;
+	uint64_t firstCluster;
+
+	DiskLocation() :
+		volumeSerialNumber(0),
+		firstCluster(0)
+	{
+	}
+
+	DiskLocation(uint32_t volumeSerialNumber, uint64_t firstCluster) :
+		volumeSerialNumber(volumeSerialNumber),
+		firstCluster(firstCluster)
+	{
+	}
+
+	inline bool operator<(const DiskLocation& other) const
+	{
+		if (volumeSerialNumber != other.volumeSerialNumber)
+			return volumeSerialNumber < other.volumeSerialNumber;
+
+		return firstCluster < other.firstCluster;
+	}
+};
+
+struct CompletionPortFileReadData : FileOpenData
+{
+	FileHandleHolder fileHandle;
+	DeviceReadQueue* device;
+	DiskLocation diskLocation; // Only looked up when reads are ordered by it, all zeros otherwise
+
+	CompletionPortFileReadData() :
+		device(nullptr)
+	{
+	}
+
+	CompletionPortFileReadData(CompletionPortFileReadData&& other) :
+		FileOpenData(std::move(other)),
+		fileHandle(std::move(other.fileHandle)),
+		device(other.device),
+		diskLocation(other.diskLocation)
+	{
+	}
+
+	CompletionPortFileReadData(FileOpenData&& other) :
+		FileOpenData(std::move(other)),
+		device(nullptr)
+	{
+	}
+
+	CompletionPortFileReadData& operator=(CompletionPortFileReadData&& other)
+	{
+		static_cast<FileOpenData&>(*this) = std::move(other);
+		fileHandle = std::move(other.fileHandle);
+		device = other.device;
+		diskLocation = other.diskLocation;
+		return *this;
+	}
+};
\ No newline at end of file
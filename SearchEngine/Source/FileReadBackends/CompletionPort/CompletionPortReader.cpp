@@ -0,0 +1,344 @@
+#include "PrecompiledHeader.h"
+#include "CompletionPortReader.h"
+
+#include <winioctl.h>
+
+const DWORD kFileSharingFlags = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+
+CompletionPortReader::CompletionPortReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter, ReadThrottle& readThrottle) :
+    MyPipelineBase(stringSearcher, searchInstructions, searchResultReporter),
+    m_ReadThrottle(readThrottle),
+    m_OrderReadsByDiskLocation(false),
+    m_CancelledOutstandingReads(false),
+    m_IsReadThrottled(false)
+{
+}
+
+void CompletionPortReader::Initialize()
+{
+    m_ReadChunkPolicy.Initialize(m_SearchInstructions.searchPath);
+    m_DeviceReadLimiter.Initialize(m_ReadChunkPolicy);
+
+    // Reading files in whatever order they were opened in has a rotational disk seek between every few reads
+    m_OrderReadsByDiskLocation = m_ReadChunkPolicy.GetDeviceClass() == StorageDeviceClass::kRotational;
+
+    // Every slot takes the same size of chunk, so it's the size for files that span several. Smaller files take a slot each either way
+    InitializeReadSlots(m_ReadChunkPolicy.GetChunkSize(ReadChunkPolicy::kMediumChunkSize));
+
+    m_CompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+    Assert(m_CompletionPort);
+
+    SYSTEM_INFO systemInfo;
+    GetNativeSystemInfo(&systemInfo);
+
+    uint32_t fileOpenThreads = 1;
+    uint32_t contentSearchThreads = 1;
+    if (systemInfo.dwNumberOfProcessors >= 3)
+    {
+        fileOpenThreads = systemInfo.dwNumberOfProcessors - 2;
+        contentSearchThreads = systemInfo.dwNumberOfProcessors - 1;
+    }
+
+    m_FileOpenWorkQueue.Initialize<&CompletionPortReader::FileOpenThread>(this, fileOpenThreads);
+    m_SearchWorkQueue.Initialize<&CompletionPortReader::ContentsSearchThread>(this, contentSearchThreads);
+
+    m_FileReadThread = CreateThread(nullptr, 64 * 1024, [](void* ctx) -> DWORD
+    {
+        static_cast<CompletionPortReader*>(ctx)->FileReadThread();
+        return 0;
+    }, this, 0, nullptr);
+    Assert(m_FileReadThread);
+
+    auto setThreadPriorityResult = SetThreadPriority(m_FileReadThread, THREAD_PRIORITY_BELOW_NORMAL);
+    Assert(setThreadPriorityResult != FALSE);
+}
+
+void CompletionPortReader::DrainWorkQueue()
+{
+    m_IsTerminating = true;
+    m_FileOpenWorkQueue.DrainWorkQueue();
+
+    // Slots queued for searching are left alone: the search threads hand them back unsearched, and the read thread waits for all of them
+    if (m_CompletionPort)
+        PostCompletion(kWakeUp);
+}
+
+void CompletionPortReader::CompleteAllWork()
+{
+    m_FileOpenWorkQueue.CompleteAllWork();
+
+    // Every opened file was posted before this, so the read thread sees all of them before it sees the end
+    PostCompletion(kNoMoreFiles);
+    WaitForSingleObject(m_FileReadThread, INFINITE);
+
+    m_SearchWorkQueue.CompleteAllWork();
+    m_SearchResultReporter.OnMaxDeviceReadsInFlightThreadUnsafe(m_DeviceReadLimiter.GetMaxReadsInFlight());
+}
+
+// Only the first extent counts: most files have just the one, and it's where reading them starts. Files small enough to live in the MFT
+// have none, so they come first on their volume. The handle isn't on the completion port yet, so waiting for the request can't post a packet there
+static DiskLocation GetDiskLocation(HANDLE fileHandle)
+{
+    // Volumes mounted inside the searched tree can be on other disks, or other partitions of the same one. Each gets swept on its own
+    BY_HANDLE_FILE_INFORMATION fileInformation;
+    if (!GetFileInformationByHandle(fileHandle, &fileInformation))
+        return DiskLocation();
+
+    STARTING_VCN_INPUT_BUFFER startingVcn = {};
+    RETRIEVAL_POINTERS_BUFFER retrievalPointers;
+    OVERLAPPED overlapped = {};
+    DWORD bytesReturned;
+
+    auto succeeded = DeviceIoControl(fileHandle, FSCTL_GET_RETRIEVAL_POINTERS, &startingVcn, sizeof(startingVcn), &retrievalPointers, sizeof(retrievalPointers), nullptr, &overlapped);
+    if (!succeeded && GetLastError() == ERROR_IO_PENDING)
+        succeeded = GetOverlappedResult(fileHandle, &overlapped, &bytesReturned, TRUE);
+
+    // ERROR_MORE_DATA only means the file has more extents than the one we asked for
+    if (!succeeded && GetLastError() != ERROR_MORE_DATA)
+        return DiskLocation(fileInformation.dwVolumeSerialNumber, 0);
+
+    // Compressed and sparse runs have no clusters of their own
+    if (retrievalPointers.ExtentCount == 0 || retrievalPointers.Extents[0].Lcn.QuadPart < 0)
+        return DiskLocation(fileInformation.dwVolumeSerialNumber, 0);
+
+    return DiskLocation(fileInformation.dwVolumeSerialNumber, static_cast<uint64_t>(retrievalPointers.Extents[0].Lcn.QuadPart));
+}
+
+void CompletionPortReader::FileOpenThread()
+{
+    SetThreadDescription(GetCurrentThread(), L"FSS Completion Port File Open Thread");
+
+    m_FileOpenWorkQueue.DoWork([this](FileOpenData& searchData)
+    {
+        if (m_IsTerminating || m_SearchResultReporter.HasReachedResultLimit())
+            return;
+
+        std::unique_ptr<CompletionPortFileReadData> readData(new CompletionPortFileReadData(std::move(searchData)));
+        readData->fileHandle = CreateFileW(readData->filePath.c_str(), GENERIC_READ, kFileSharingFlags, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+
+        if (m_OrderReadsByDiskLocation && readData->fileHandle != INVALID_HANDLE_VALUE)
+            readData->diskLocation = GetDiskLocation(readData->fileHandle);
+
+        if (readData->fileHandle == INVALID_HANDLE_VALUE || CreateIoCompletionPort(readData->fileHandle, m_CompletionPort, kReadCompleted, 0) == nullptr)
+        {
+            m_SearchResultReporter.AddToScannedFileCount();
+            m_SearchResultReporter.AddToScannedFileSize(readData->fileSize);
+            return;
+        }
+
+        SetFileCompletionNotificationModes(readData->fileHandle, FILE_SKIP_SET_EVENT_ON_HANDLE);
+        readData->device = &m_DeviceReadLimiter.GetDevice(readData->fileHandle, readData->filePath);
+
+        // The file travels in place of an OVERLAPPED, and the read thread takes ownership of it when it dequeues the packet
+        PostCompletion(kFileOpened, 0, reinterpret_cast<OVERLAPPED*>(readData.release()));
+    });
+}
+
+void CompletionPortReader::FileReadThread()
+{
+    SetThreadDescription(GetCurrentThread(), L"FSS Completion Port Read Thread");
+
+    bool noMoreFiles = false;
+    OVERLAPPED_ENTRY completions[kMaxCompletionsPerDequeue];
+
+    while (!noMoreFiles || m_FreeReadSlotCount != m_FileReadSlotCount || m_IsReadThrottled)
+    {
+        // Reads held back by the read budget get another go once it has room, whether or not anything completes in the meantime
+        ULONG completionCount;
+        auto dequeueResult = GetQueuedCompletionStatusEx(m_CompletionPort, completions, ARRAYSIZE(completions), &completionCount, m_IsReadThrottled ? m_ReadThrottle.GetRetryDelay() : INFINITE, FALSE);
+        Assert(dequeueResult != FALSE || GetLastError() == WAIT_TIMEOUT);
+
+        if (dequeueResult == FALSE && GetLastError() != WAIT_TIMEOUT)
+            break;
+
+        if (dequeueResult == FALSE)
+            completionCount = 0;
+
+        for (ULONG i = 0; i < completionCount; i++)
+        {
+            const auto& completion = completions[i];
+
+            switch (completion.lpCompletionKey)
+            {
+            case kReadCompleted:
+            case kReadFailed:
+            {
+                // Internal holds the status of the read: anything but STATUS_SUCCESS means it failed, got cancelled or started past the end of a file that shrank
+                const auto slot = static_cast<uint16_t>(completion.lpOverlapped - m_SlotOverlapped);
+                const bool succeeded = completion.lpCompletionKey == kReadCompleted && completion.lpOverlapped->Internal == 0;
+                ProcessReadCompletion(slot, completion.dwNumberOfBytesTransferred, succeeded);
+                break;
+            }
+
+            case kFileOpened:
+            {
+                std::unique_ptr<CompletionPortFileReadData> readData(reinterpret_cast<CompletionPortFileReadData*>(completion.lpOverlapped));
+                m_FilesToRead.emplace(readData->diskLocation, std::move(*readData));
+                break;
+            }
+
+            case kSearchCompleted:
+                RecordSearchResult(m_SlotSearchData[completion.dwNumberOfBytesTransferred]);
+                break;
+
+            case kNoMoreFiles:
+                noMoreFiles = true;
+                break;
+
+            case kWakeUp:
+                break;
+            }
+        }
+
+        PopFinishedFiles();
+
+        // Reads are only issued once the whole batch of completions is processed, so slots freed together get refilled together
+        if (m_IsTerminating || m_SearchResultReporter.HasReachedResultLimit())
+        {
+            m_IsReadThrottled = false;
+            CancelOutstandingReads();
+        }
+        else
+        {
+            QueueFileReads();
+        }
+    }
+}
+
+void CompletionPortReader::QueueFileReads()
+{
+    m_IsReadThrottled = false;
+
+    while (m_FreeReadSlotCount > 0)
+    {
+        const auto slot = FindFreeReadSlot();
+        const bool needsNextFile = m_FilesWithReadProgress.IsEmpty() || m_FilesWithReadProgress.Back().chunksRead == GetChunkCount(m_FilesWithReadProgress.Back());
+        if (needsNextFile && m_FilesToRead.empty())
+            return;
+
+        // Reads sweep up the disk like an elevator, through one volume after another, and files opened behind the sweep wait for the next pass.
+        // Without disk locations, every file is at the same one, so this takes them in the order they were opened in
+        auto nextFile = m_FilesToRead.end();
+        if (needsNextFile)
+        {
+            nextFile = m_FilesToRead.lower_bound(m_DiskSweepPosition);
+            if (nextFile == m_FilesToRead.end())
+                nextFile = m_FilesToRead.begin();
+        }
+
+        // The read has to fit under its device's limit and in the budget before it takes a slot, or a new file gets moved out of m_FilesToRead for it.
+        // A device at its limit has reads in flight, and the read thread comes back here once they complete
+        auto& device = needsNextFile ? *nextFile->second.device : *m_FilesWithReadProgress.Back().device;
+        const auto nextReadSize = needsNextFile ? std::min<uint64_t>(nextFile->second.fileSize, m_ReadChunkSize) :
+            std::min<uint64_t>(m_FilesWithReadProgress.Back().fileSize - static_cast<uint64_t>(m_FilesWithReadProgress.Back().chunksRead) * m_ReadChunkSize, m_ReadChunkSize);
+
+        if (!device.TryAcquireRead())
+            return;
+
+        if (!m_ReadThrottle.TryAcquireRead(static_cast<uint32_t>(nextReadSize)))
+        {
+            device.OnReadCancelled();
+            m_IsReadThrottled = true;
+            return;
+        }
+
+        if (needsNextFile)
+        {
+            m_DiskSweepPosition = nextFile->first;
+            m_FilesWithReadProgress.PushBack(std::move(nextFile->second));
+            m_FilesToRead.erase(nextFile);
+
+            m_FilesWithReadProgress.Back().awaitingClassification = m_SearchInstructions.SkipBinaryFiles();
+        }
+
+        auto& file = m_FilesWithReadProgress.Back();
+        const auto fileOffset = AssignReadSlot(slot);
+        const auto bytesToRead = m_SlotSearchData[slot].size;
+
+        auto& overlapped = m_SlotOverlapped[slot];
+        ZeroMemory(&overlapped, sizeof(overlapped));
+        overlapped.Offset = static_cast<uint32_t>(fileOffset & 0xFFFFFFFF);
+        overlapped.OffsetHigh = static_cast<uint32_t>(fileOffset >> 32);
+        m_SlotIssueTimes[slot] = DeviceReadQueue::GetTimestamp();
+
+        // A read that fails right away never reaches the port, so post its completion ourselves to free the slot the usual way
+        auto readResult = ReadFile(file.fileHandle, GetReadBuffer(slot), bytesToRead, nullptr, &overlapped);
+        m_SlotReadServedFromCache[slot] = readResult != FALSE;
+
+        if (readResult == FALSE && GetLastError() != ERROR_IO_PENDING)
+            PostCompletion(kReadFailed, 0, &overlapped);
+    }
+}
+
+void CompletionPortReader::ProcessReadCompletion(uint16_t slot, uint32_t bytesRead, bool succeeded)
+{
+    Assert(m_SlotReadInFlight[slot]);
+    m_SlotReadInFlight[slot] = false;
+
+    auto& file = m_FilesWithReadProgress[m_FileReadSlots[slot]];
+
+    // Files can shrink while we read them, in which case only what was actually read gets searched
+    m_SlotSearchData[slot].size = succeeded ? bytesRead : 0;
+
+    if (succeeded)
+    {
+        file.device->OnReadCompleted(bytesRead, m_SlotIssueTimes[slot]);
+        m_SearchResultReporter.OnFileBytesRead(bytesRead, m_SlotReadServedFromCache[slot]);
+    }
+    else
+    {
+        file.device->OnReadCancelled();
+    }
+
+    DispatchReadChunks(file);
+}
+
+void CompletionPortReader::ContentsSearchThread()
+{
+    ScopedStackAllocator allocator;
+    SetThreadDescription(GetCurrentThread(), L"FSS Content Search Thread");
+
+    m_SearchWorkQueue.DoWork([this, &allocator](SlotSearchData& searchData)
+    {
+        SearchChunk(searchData, allocator);
+
+        // Posting the slot back publishes the result to the read thread
+        m_SlotSearchData[searchData.slot] = searchData;
+        PostCompletion(kSearchCompleted, searchData.slot);
+    });
+}
+
+void CompletionPortReader::AbandonFileReads(FileReadStateData& file, uint32_t)
+{
+    file.chunksRead = GetChunkCount(file);
+
+    if (file.readsInProgress > 0)
+        CancelIoEx(file.fileHandle, nullptr);
+
+    // Chunks held back for their successors won't be searched anymore
+    DispatchReadChunks(file);
+}
+
+void CompletionPortReader::OnFileReadsFinished(FileReadStateData& file)
+{
+    file.fileHandle = INVALID_HANDLE_VALUE;
+}
+
+void CompletionPortReader::CancelOutstandingReads()
+{
+    if (m_CancelledOutstandingReads)
+        return;
+
+    // Cancelled reads still complete through the port, so their slots get freed as usual
+    for (uint16_t slot = 0; slot < m_FileReadSlotCount; slot++)
+    {
+        if (m_SlotReadInFlight[slot])
+            CancelIoEx(m_FilesWithReadProgress[m_FileReadSlots[slot]].fileHandle, &m_SlotOverlapped[slot]);
+    }
+
+    m_CancelledOutstandingReads = true;
+
+    // The last chunk issued may be waiting for one that now never will be
+    if (!m_FilesWithReadProgress.IsEmpty())
+        DispatchReadChunks(m_FilesWithReadProgress.Back());
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CompletionPortFileReadData.h"
+#include "FileContentSearchData.h"
+#include "FileReadBackends/DeviceReadLimiter.h"
+#include "FileReadBackends/ReadChunkPolicy.h"
+#include "FileReadBackends/ReadThrottle.h"
+#include "FileReadBackends/SlotSearchPipeline.h"
+#include "HandleHolder.h"
+#include "Utilities/WorkQueue.h"
+
+// Keeps many files and chunks in flight from a single read thread without DirectStorage. Files are opened on a pool of threads and
+// associated with one I/O completion port, the read thread issues overlapped reads into a fixed set of slots allocated up front,
+// and completed slots go to the search threads. Opened files, read completions and search results all arrive through the port,
+// and the read thread dequeues them in batches, so it never waits on more than one thing.
+// Chunks are sized for the device behind the search path, and each device only gets as many reads in flight as its read queue allows.
+// On rotational disks, opened files are read in the order they're laid out on the disk rather than the order they were found in.
+class CompletionPortReader : SlotSearchPipeline<CompletionPortReader, CompletionPortFileReadData, 64 * 1024 * 1024, 256 * 1024>
+{
+public:
+    CompletionPortReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter, ReadThrottle& readThrottle);
+
+    void Initialize();
+    void DrainWorkQueue();
+    void CompleteAllWork();
+
+    inline void ScanFile(FileOpenData fileOpenData)
+    {
+        m_FileOpenWorkQueue.PushWorkItem(std::move(fileOpenData));
+    }
+
+    static constexpr uint32_t kMaxCompletionsPerDequeue = 64;
+
+private:
+    typedef SlotSearchPipeline<CompletionPortReader, CompletionPortFileReadData, 64 * 1024 * 1024, 256 * 1024> MyPipelineBase;
+    friend class MyPipelineBase;
+
+    enum CompletionKey : ULONG_PTR
+    {
+        kReadCompleted,
+        kReadFailed,
+        kFileOpened,
+        kSearchCompleted,
+        kNoMoreFiles,
+        kWakeUp,
+    };
+
+    void FileOpenThread();
+    void FileReadThread();
+    void QueueFileReads();
+    void ProcessReadCompletion(uint16_t slot, uint32_t bytesRead, bool succeeded);
+    void ContentsSearchThread();
+    void AbandonFileReads(FileReadStateData& file, uint32_t fileIndex);
+    void OnFileReadsFinished(FileReadStateData& file);
+    void CancelOutstandingReads();
+
+    inline void PostCompletion(CompletionKey key, uint32_t value = 0, OVERLAPPED* overlapped = nullptr)
+    {
+        auto postResult = PostQueuedCompletionStatus(m_CompletionPort, value, key, overlapped);
+        Assert(postResult != FALSE);
+    }
+
+private:
+    ReadThrottle& m_ReadThrottle;
+    ThreadedWorkQueue<CompletionPortReader, FileOpenData> m_FileOpenWorkQueue;
+    ThreadedWorkQueue<CompletionPortReader, SlotSearchData> m_SearchWorkQueue;
+    ReadChunkPolicy m_ReadChunkPolicy;
+    DeviceReadLimiter m_DeviceReadLimiter;
+    bool m_OrderReadsByDiskLocation;
+    DiskLocation m_DiskSweepPosition;
+    std::multimap<DiskLocation, CompletionPortFileReadData> m_FilesToRead; // By disk location, so files at the same one keep the order they were opened in
+
+    HandleHolder<nullptr> m_CompletionPort;
+    ThreadHandleHolder m_FileReadThread;
+    bool m_CancelledOutstandingReads;
+    bool m_IsReadThrottled; // Reads are left to issue once the read budget has room for them
+
+    bool m_SlotReadServedFromCache[kMaxFileReadSlotCount]; // The read completed right away, which only the cache can do
+    int64_t m_SlotIssueTimes[kMaxFileReadSlotCount];
+    OVERLAPPED m_SlotOverlapped[kMaxFileReadSlotCount];
+};
\ No newline at end of file
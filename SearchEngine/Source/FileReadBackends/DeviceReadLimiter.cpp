@@ -0,0 +1,211 @@
+#include "PrecompiledHeader.h"
+#include "DeviceReadLimiter.h"
+
+constexpr uint32_t kTuningIntervalMilliseconds = 250;
+constexpr uint32_t kMinReadsPerTuning = 16; // Fewer than this over an interval is too little to go by
+constexpr double kSignificantChange = 0.1;
+
+static void RaiseTo(std::atomic<uint32_t>& value, uint32_t newValue)
+{
+	for (auto current = value.load(); current < newValue && !value.compare_exchange_weak(current, newValue);)
+	{
+	}
+}
+
+static int64_t GetTuningIntervalTicks()
+{
+	static const int64_t s_TuningIntervalTicks = []()
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart * kTuningIntervalMilliseconds / 1000;
+	}();
+
+	return s_TuningIntervalTicks;
+}
+
+DeviceReadQueue::DeviceReadQueue(StorageDeviceClass deviceClass, uint32_t queueDepthOverride) :
+	m_DeviceClass(deviceClass),
+	m_MaxLimit(ReadChunkPolicy::GetMaxQueueDepth(deviceClass)),
+	m_IsTunable(queueDepthOverride == 0),
+	m_ReadsInFlight(0),
+	m_Limit(queueDepthOverride != 0 ? queueDepthOverride : ReadChunkPolicy::GetInitialQueueDepth(deviceClass)),
+	m_PeakReadsInFlight(0),
+	m_MaxReadsInFlight(0),
+	m_IsTuning(false),
+	m_WindowStart(GetTimestamp()),
+	m_WindowBytes(0),
+	m_WindowLatency(0),
+	m_WindowReads(0),
+	m_LastThroughput(0),
+	m_LastLatency(0),
+	m_TuningDirection(1)
+{
+}
+
+void DeviceReadQueue::AcquireRead()
+{
+	auto readsInFlight = m_ReadsInFlight.load();
+
+	for (;;)
+	{
+		if (readsInFlight < m_Limit)
+		{
+			if (m_ReadsInFlight.compare_exchange_weak(readsInFlight, readsInFlight + 1))
+				break;
+
+			continue;
+		}
+
+		// Every read in flight completes or gets cancelled by the thread that holds it, so this always wakes up
+		m_ReadsInFlight.wait(readsInFlight);
+		readsInFlight = m_ReadsInFlight.load();
+	}
+
+	RaiseTo(m_PeakReadsInFlight, readsInFlight + 1);
+	RaiseTo(m_MaxReadsInFlight, readsInFlight + 1);
+}
+
+bool DeviceReadQueue::TryAcquireRead()
+{
+	auto readsInFlight = m_ReadsInFlight.load();
+
+	do
+	{
+		if (readsInFlight >= m_Limit)
+			return false;
+	}
+	while (!m_ReadsInFlight.compare_exchange_weak(readsInFlight, readsInFlight + 1));
+
+	RaiseTo(m_PeakReadsInFlight, readsInFlight + 1);
+	RaiseTo(m_MaxReadsInFlight, readsInFlight + 1);
+
+	return true;
+}
+
+void DeviceReadQueue::OnReadCompleted(uint32_t bytesRead, int64_t issueTime)
+{
+	if (!m_IsTunable)
+	{
+		ReleaseRead(false);
+		return;
+	}
+
+	const auto now = GetTimestamp();
+	m_WindowBytes += bytesRead;
+	m_WindowLatency += static_cast<uint64_t>(std::max<int64_t>(now - issueTime, 0));
+	m_WindowReads++;
+
+	bool limitWasRaised = false;
+	if (now - m_WindowStart >= GetTuningIntervalTicks() && !m_IsTuning.exchange(true))
+	{
+		limitWasRaised = TuneLimit(now);
+		m_IsTuning = false;
+	}
+
+	ReleaseRead(limitWasRaised);
+}
+
+void DeviceReadQueue::OnReadCancelled()
+{
+	ReleaseRead(false);
+}
+
+void DeviceReadQueue::ReleaseRead(bool limitWasRaised)
+{
+	m_ReadsInFlight--;
+
+	if (limitWasRaised)
+		m_ReadsInFlight.notify_all();
+	else
+		m_ReadsInFlight.notify_one();
+}
+
+// Only ever called by one thread at a time. Returns whether the limit went up
+bool DeviceReadQueue::TuneLimit(int64_t now)
+{
+	const auto reads = m_WindowReads.load();
+	if (reads < kMinReadsPerTuning)
+		return false;
+
+	const auto elapsed = now - m_WindowStart;
+	const auto throughput = static_cast<double>(m_WindowBytes.exchange(0)) / elapsed;
+	const auto latency = static_cast<double>(m_WindowLatency.exchange(0)) / reads;
+	m_WindowReads -= reads;
+	m_WindowStart = now;
+
+	// Nothing was waiting on the limit, so moving it wouldn't have changed anything
+	const auto limit = m_Limit.load();
+	if (m_PeakReadsInFlight.exchange(0) < limit && m_TuningDirection > 0)
+	{
+		m_LastThroughput = throughput;
+		m_LastLatency = latency;
+		return false;
+	}
+
+	if (m_LastThroughput > 0)
+	{
+		if (throughput < m_LastThroughput * (1 - kSignificantChange))
+			m_TuningDirection = -m_TuningDirection;
+		else if (throughput <= m_LastThroughput * (1 + kSignificantChange) && latency > m_LastLatency * (1 + kSignificantChange))
+			m_TuningDirection = -1; // The same bytes, just waiting longer in the queue
+	}
+
+	m_LastThroughput = throughput;
+	m_LastLatency = latency;
+
+	const auto step = std::max(limit / 4, 1u);
+	const auto newLimit = m_TuningDirection > 0 ? std::min(limit + step, m_MaxLimit) : std::max(limit - std::min(step, limit), 1u);
+
+	// Bouncing off either end turns around, so the next interval tries the other way
+	if (newLimit == limit)
+		m_TuningDirection = -m_TuningDirection;
+
+	m_Limit = newLimit;
+	return newLimit > limit;
+}
+
+DeviceReadLimiter::DeviceReadLimiter() :
+	m_QueueDepthOverride(0)
+{
+}
+
+void DeviceReadLimiter::Initialize(const ReadChunkPolicy& readChunkPolicy)
+{
+	m_QueueDepthOverride = readChunkPolicy.GetQueueDepthOverride();
+}
+
+DeviceReadQueue& DeviceReadLimiter::GetDevice(HANDLE fileHandle, const std::wstring& filePath)
+{
+	// File systems that can't tell us the volume all share one queue
+	FILE_ID_INFO fileIdInfo;
+	const uint64_t volumeSerialNumber = GetFileInformationByHandleEx(fileHandle, FileIdInfo, &fileIdInfo, sizeof(fileIdInfo)) ? fileIdInfo.VolumeSerialNumber : 0;
+
+	{
+		ReaderWriterLock::ReaderLock lock(m_DevicesLock);
+		auto device = m_Devices.find(volumeSerialNumber);
+		if (device != m_Devices.end())
+			return *device->second;
+	}
+
+	// Asking the device can take a while, and doesn't need the lock
+	const auto deviceClass = volumeSerialNumber != 0 ? ReadChunkPolicy::QueryDeviceClass(filePath) : StorageDeviceClass::kUnknown;
+
+	ReaderWriterLock::WriterLock lock(m_DevicesLock);
+	auto& device = m_Devices[volumeSerialNumber];
+	if (device == nullptr)
+		device = std::make_unique<DeviceReadQueue>(deviceClass, m_QueueDepthOverride);
+
+	return *device;
+}
+
+uint32_t DeviceReadLimiter::GetMaxReadsInFlight()
+{
+	ReaderWriterLock::ReaderLock lock(m_DevicesLock);
+
+	uint32_t maxReadsInFlight = 0;
+	for (const auto& device : m_Devices)
+		maxReadsInFlight = std::max(maxReadsInFlight, device.second->GetMaxReadsInFlight());
+
+	return maxReadsInFlight;
+}
\ No newline at end of file
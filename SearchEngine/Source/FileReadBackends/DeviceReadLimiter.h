@@ -0,0 +1,89 @@
+#pragma once
+
+#include "FileReadBackends/ReadChunkPolicy.h"
+#include "NonCopyable.h"
+#include "ReaderWriterLock.h"
+
+// Reads in flight against one device. The limit starts out at what suits the kind of device, and unless it was overridden, it's then
+// tuned by hill climbing: every so often the bytes read per second are compared with the last time, and the limit keeps moving the
+// same way while that improves, turns around when it gets worse, and comes down when only the latency went up
+class DeviceReadQueue : NonCopyable
+{
+public:
+	DeviceReadQueue(StorageDeviceClass deviceClass, uint32_t queueDepthOverride);
+
+	// Waits for room under the limit. Only for a thread without reads in flight on any device, since one that holds some could be waiting on itself
+	void AcquireRead();
+
+	// For reads on top of ones the thread already has in flight
+	bool TryAcquireRead();
+
+	// issueTime is the timestamp from just before the read was issued
+	void OnReadCompleted(uint32_t bytesRead, int64_t issueTime);
+	void OnReadCancelled();
+
+	inline StorageDeviceClass GetDeviceClass() const
+	{
+		return m_DeviceClass;
+	}
+
+	inline uint32_t GetLimit() const
+	{
+		return m_Limit;
+	}
+
+	// Over the whole search, where the peak that tuning goes by starts over every interval
+	inline uint32_t GetMaxReadsInFlight() const
+	{
+		return m_MaxReadsInFlight;
+	}
+
+	static inline int64_t GetTimestamp()
+	{
+		LARGE_INTEGER timestamp;
+		QueryPerformanceCounter(&timestamp);
+		return timestamp.QuadPart;
+	}
+
+private:
+	void ReleaseRead(bool limitWasRaised);
+	bool TuneLimit(int64_t now);
+
+private:
+	const StorageDeviceClass m_DeviceClass;
+	const uint32_t m_MaxLimit;
+	const bool m_IsTunable;
+	std::atomic<uint32_t> m_ReadsInFlight;
+	std::atomic<uint32_t> m_Limit;
+	std::atomic<uint32_t> m_PeakReadsInFlight; // Since the last tuning. A limit that was never reached says nothing about the device
+	std::atomic<uint32_t> m_MaxReadsInFlight;
+
+	std::atomic<bool> m_IsTuning;
+	std::atomic<int64_t> m_WindowStart;
+	std::atomic<uint64_t> m_WindowBytes;
+	std::atomic<uint64_t> m_WindowLatency;
+	std::atomic<uint32_t> m_WindowReads;
+	double m_LastThroughput;
+	double m_LastLatency;
+	int32_t m_TuningDirection;
+};
+
+// Hands out the read queue of the device behind each file a reader opens. Devices are told apart by volume, so volumes mounted anywhere
+// in the searched tree get queues of their own, while partitions of the same disk are treated as separate devices
+class DeviceReadLimiter
+{
+public:
+	DeviceReadLimiter();
+
+	void Initialize(const ReadChunkPolicy& readChunkPolicy);
+
+	DeviceReadQueue& GetDevice(HANDLE fileHandle, const std::wstring& filePath);
+
+	// Of any one device, once its reads are done
+	uint32_t GetMaxReadsInFlight();
+
+private:
+	uint32_t m_QueueDepthOverride;
+	ReaderWriterLock m_DevicesLock;
+	std::map<uint64_t, std::unique_ptr<DeviceReadQueue>> m_Devices; // By volume serial number
+};
\ No newline at end of file
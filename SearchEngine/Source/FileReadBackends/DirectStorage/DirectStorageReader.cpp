@@ -1,22 +1,15 @@
 #include "PrecompiledHeader.h"
 #include "DirectStorageReader.h"
 #include "DirectXContext.h"
-#include "SearchInstructions.h"
-#include "SearchResultReporter.h"
-#include "StringSearch/StringSearcher.h"
-#include "Utilities/ScopedStackAllocator.h"
-
-DirectStorageReader::DirectStorageReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter) :
-    m_SearchResultReporter(searchResultReporter),
-    m_StringSearcher(stringSearcher),
-    m_ReadBufferSize(0),
+
+DirectStorageReader::DirectStorageReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter, ReadThrottle& readThrottle) :
+    MyPipelineBase(stringSearcher, searchInstructions, searchResultReporter),
+    m_ReadThrottle(readThrottle),
     m_FenceEvent(false),
     m_FenceValue(0),
-    m_IsTerminating(false),
-    m_FreeReadSlotCount(ARRAYSIZE(m_FileReadSlots))
+    m_CancelledOutstandingReads(false),
+    m_IsReadThrottled(false)
 {
-    if (searchInstructions.SearchInFileContents())
-        m_ReadBufferSize = kFileReadBufferBaseSize + std::max(searchInstructions.utf8SearchString.length(), searchInstructions.searchString.length() * sizeof(wchar_t));
 }
 
 DirectStorageReader::~DirectStorageReader()
@@ -30,11 +23,9 @@ DirectStorageReader::~DirectStorageReader()
 
 void DirectStorageReader::Initialize()
 {
-    m_FileReadBuffers.reset(new uint8_t[m_ReadBufferSize * kFileReadSlotCount]);
+    InitializeReadSlots();
     m_WaitableTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
 
-    memset(m_FreeReadSlots, 0xFF, sizeof(m_FreeReadSlots));
-
     DSTORAGE_QUEUE_DESC queueDesc = {};
     queueDesc.SourceType = DSTORAGE_REQUEST_SOURCE_FILE;
     queueDesc.Capacity = DSTORAGE_MAX_QUEUE_CAPACITY;
@@ -91,7 +82,7 @@ void DirectStorageReader::FileOpenThread()
 
     m_FileOpenWorkQueue.DoWork([this](FileOpenData& searchData)
     {
-        if (m_IsTerminating)
+        if (m_IsTerminating || m_SearchResultReporter.HasReachedResultLimit())
             return;
 
         DirectStorageFileReadData readData(std::move(searchData));
@@ -124,10 +115,11 @@ void DirectStorageReader::FileReadThread()
         if (!fileContentSearchCompleted)
             waitHandles[handleCount++] = MySearchResultBase::GetWorkSemaphore();
 
-        if (!m_CurrentBatch.slots.empty())
+        if (!m_CurrentBatch.slots.empty() || m_IsReadThrottled)
         {
+            // 1 ms for a batch, or until the read budget has room again
             LARGE_INTEGER timer;
-            timer.QuadPart = -10000; // 1 ms
+            timer.QuadPart = -10000LL * (m_CurrentBatch.slots.empty() ? m_ReadThrottle.GetRetryDelay() : 1);
             auto result = SetWaitableTimer(m_WaitableTimer, &timer, 0, nullptr, nullptr, FALSE);
             Assert(result);
 
@@ -146,9 +138,23 @@ void DirectStorageReader::FileReadThread()
         if (waitResult < WAIT_OBJECT_0 || waitResult >= WAIT_OBJECT_0 + handleCount)
             break;
 
+        // The buffers go away with the reader, so nothing submitted can be left landing in them. Cancelled requests still complete,
+        // so that only takes as long as the requests in flight take to fail
         if (m_IsTerminating)
         {
+            m_DStorageQueue->CancelRequestsWithTag(kReadRequestCancellationTag, kReadRequestCancellationTag);
+
+            if (!m_CurrentBatch.slots.empty())
+                SubmitReadRequests();
+
+            while (m_Fence->GetCompletedValue() < m_FenceValue)
+            {
+                m_Fence->SetEventOnCompletion(m_FenceValue, m_FenceEvent);
+                WaitForSingleObject(m_FenceEvent, INFINITE);
+            }
+
             DrainWorkQueue();
+            m_FileReadsCompletedEvent.Set();
             break;
         }
 
@@ -167,7 +173,7 @@ void DirectStorageReader::FileReadThread()
             {
                 readSubmissionCompleted = true;
 
-                if (m_CurrentBatch.slots.empty() && m_FreeReadSlotCount == ARRAYSIZE(m_FileReadSlots))
+                if (m_CurrentBatch.slots.empty() && m_FreeReadSlotCount == m_FileReadSlotCount && !m_IsReadThrottled)
                 {
                     fileContentSearchCompleted = true;
                     m_FileReadsCompletedEvent.Set();
@@ -187,76 +193,68 @@ void DirectStorageReader::FileReadThread()
                 fileContentSearchCompleted = true;
             }
 
-            if (readSubmissionCompleted && m_CurrentBatch.slots.empty() && m_FreeReadSlotCount == ARRAYSIZE(m_FileReadSlots))
+            if (readSubmissionCompleted && m_CurrentBatch.slots.empty() && m_FreeReadSlotCount == m_FileReadSlotCount && !m_IsReadThrottled)
                 m_FileReadsCompletedEvent.Set();
         }
         else if (signaledHandle == m_WaitableTimer)
         {
             // No requests for 1 ms, submit outstanding work
             SubmitReadRequests();
+
+            if (m_IsReadThrottled)
+            {
+                QueueFileReads();
+
+                if (readSubmissionCompleted && m_CurrentBatch.slots.empty() && m_FreeReadSlotCount == m_FileReadSlotCount && !m_IsReadThrottled)
+                    m_FileReadsCompletedEvent.Set();
+            }
         }
         else
         {
             ProcessReadCompletion();
+
+            // Chunks of files that got decided in the meantime are freed without a trip through the search threads
+            if (readSubmissionCompleted && m_CurrentBatch.slots.empty() && m_FreeReadSlotCount == m_FileReadSlotCount && !m_IsReadThrottled)
+                m_FileReadsCompletedEvent.Set();
         }
     }
 }
 
-static uint32_t GetChunkCount(const DirectStorageFileReadStateData& file)
-{
-    const auto fileSize = file.fileSize;
-    auto chunkCount = fileSize / DirectStorageReader::kFileReadBufferBaseSize;
-    if (fileSize % DirectStorageReader::kFileReadBufferBaseSize)
-        chunkCount++;
-
-    Assert(chunkCount < std::numeric_limits<uint32_t>::max());
-    return static_cast<uint32_t>(chunkCount);
-}
-
 void DirectStorageReader::QueueFileReads()
 {
-    while (true)
-    {
-        uint16_t slot = std::numeric_limits<uint16_t>::max();
+    m_IsReadThrottled = false;
 
-        // TO DO: use a trie if this is too slow
-        for (uint16_t i = 0; i < ARRAYSIZE(m_FreeReadSlots); i++)
-        {
-            DWORD index;
-            if (_BitScanForward64(&index, m_FreeReadSlots[i]))
-            {
-                slot = 64 * i + static_cast<uint16_t>(index);
-                break;
-            }
-        }
+    while (!m_IsTerminating && !m_SearchResultReporter.HasReachedResultLimit())
+    {
+        const auto slot = FindFreeReadSlot();
+        if (slot == m_FileReadSlotCount)
+            return;
 
-        if (slot == std::numeric_limits<uint16_t>::max())
+        const bool needsNextFile = m_FilesWithReadProgress.IsEmpty() || m_FilesWithReadProgress.Back().chunksRead == GetChunkCount(m_FilesWithReadProgress.Back());
+        if (needsNextFile && m_FilesToRead.empty())
             return;
 
-        uint32_t fileIndex;
-        if (m_FilesWithReadProgress.IsEmpty() || m_FilesWithReadProgress.Back().chunksRead == GetChunkCount(m_FilesWithReadProgress.Back()))
+        // The read has to fit in the budget before it takes a slot, or a new file gets moved out of m_FilesToRead for it
+        const auto& nextReadFile = needsNextFile ? m_FilesToRead.back() : m_FilesWithReadProgress.Back();
+        const auto nextReadOffset = static_cast<uint64_t>(nextReadFile.chunksRead) * m_ReadChunkSize;
+        if (!m_ReadThrottle.TryAcquireRead(static_cast<uint32_t>(std::min<uint64_t>(nextReadFile.fileSize - nextReadOffset, m_ReadChunkSize))))
         {
-            if (m_FilesToRead.empty())
-                return;
-
-            fileIndex = m_FilesWithReadProgress.PushBack(std::move(m_FilesToRead.back()));
-            m_FilesToRead.pop_back();
+            m_IsReadThrottled = true;
+            return;
         }
-        else
+
+        if (needsNextFile)
         {
-            fileIndex = m_FilesWithReadProgress.BackIndex();
+            m_FilesWithReadProgress.PushBack(std::move(m_FilesToRead.back()));
+            m_FilesToRead.pop_back();
+
+            m_FilesWithReadProgress.Back().awaitingClassification = m_SearchInstructions.SkipBinaryFiles();
         }
 
         auto& file = m_FilesWithReadProgress.Back();
-        file.readsInProgress++;
-
-        Assert(slot < kFileReadSlotCount);
-        m_FileReadSlots[slot] = fileIndex;
-        m_FreeReadSlots[slot / 64] &= ~(1ULL << (slot % 64));
-        m_FreeReadSlotCount--;
-
-        const auto fileOffset = (file.chunksRead++) * kFileReadBufferBaseSize;
-        uint32_t bytesToRead = static_cast<uint32_t>(std::min(file.fileSize - fileOffset, m_ReadBufferSize));
+        const auto fileIndex = m_FilesWithReadProgress.BackIndex();
+        const auto fileOffset = AssignReadSlot(slot);
+        const auto bytesToRead = m_SlotSearchData[slot].size;
 
         DSTORAGE_REQUEST request = {};
         request.Options.SourceType = DSTORAGE_REQUEST_SOURCE_FILE;
@@ -264,14 +262,15 @@ void DirectStorageReader::QueueFileReads()
         request.Source.File.Source = file.file.Get();
         request.Source.File.Offset = fileOffset;
         request.Source.File.Size = bytesToRead;
-        request.Destination.Memory.Buffer = m_FileReadBuffers.get() + slot * m_ReadBufferSize;
+        request.Destination.Memory.Buffer = GetReadBuffer(slot);
         request.Destination.Memory.Size = bytesToRead;
         request.UncompressedSize = bytesToRead;
+        request.CancellationTag = GetReadRequestCancellationTag(fileIndex);
 
         m_DStorageQueue->EnqueueRequest(&request);
-        m_CurrentBatch.slots.emplace_back(slot, bytesToRead);
+        m_CurrentBatch.slots.push_back(m_SlotSearchData[slot]);
 
-        if (m_CurrentBatch.slots.size() >= ARRAYSIZE(m_FileReadSlots) / 2)
+        if (m_CurrentBatch.slots.size() >= m_FileReadSlotCount / 2u)
             SubmitReadRequests();
     }
 }
@@ -298,8 +297,11 @@ void DirectStorageReader::ProcessReadCompletion()
     {
         auto& batch = m_SubmittedBatches[batchIndex];
 
-        for (auto slot : batch.slots)
-            m_SearchWorkQueue.PushWorkItem(slot);
+        for (const auto& searchData : batch.slots)
+        {
+            m_SlotReadInFlight[searchData.slot] = false;
+            DispatchReadChunks(m_FilesWithReadProgress[m_FileReadSlots[searchData.slot]]);
+        }
 
         batch.slots.clear();
         m_BatchPool.PoolObject(std::move(batch));
@@ -308,6 +310,11 @@ void DirectStorageReader::ProcessReadCompletion()
     m_SubmittedBatches.erase(m_SubmittedBatches.begin(), m_SubmittedBatches.begin() + batchIndex);
     if (!m_SubmittedBatches.empty())
         m_Fence->SetEventOnCompletion(m_SubmittedBatches.front().fenceValue, m_FenceEvent);
+
+    // Only now that the completed batches are gone can new reads be submitted, as that adds batches of its own
+    PopFinishedFiles();
+    CancelOutstandingReadsIfResultLimitReached();
+    QueueFileReads();
 }
 
 void DirectStorageReader::ContentsSearchThread()
@@ -317,59 +324,46 @@ void DirectStorageReader::ContentsSearchThread()
 
     m_SearchWorkQueue.DoWork([this, &allocator](SlotSearchData& searchData)
     {
-        searchData.found = m_StringSearcher.PerformFileContentSearch(m_FileReadBuffers.get() + searchData.slot * m_ReadBufferSize, searchData.size, allocator);
+        SearchChunk(searchData, allocator);
         MySearchResultBase::PushWorkItem(searchData);
     });
 }
 
 void DirectStorageReader::ProcessSearchCompletion(SlotSearchData searchData)
 {
-    auto& fileIndex = m_FileReadSlots[searchData.slot];
-    auto& file = m_FilesWithReadProgress[fileIndex];
+    RecordSearchResult(searchData);
+    PopFinishedFiles();
+    CancelOutstandingReadsIfResultLimitReached();
+    QueueFileReads();
+}
 
-    Assert(file.readsInProgress > 0);
-    file.readsInProgress--;
-    m_FreeReadSlots[searchData.slot / 64] |= 1ULL << (searchData.slot % 64);
-    m_FreeReadSlotCount++;
+void DirectStorageReader::AbandonFileReads(FileReadStateData& file, uint32_t fileIndex)
+{
+    file.chunksRead = GetChunkCount(file);
 
-    if (!file.dispatchedToResults)
-    {
-        if (searchData.found)
-        {
-            m_SearchResultReporter.AddToScannedFileCount();
-            m_SearchResultReporter.AddToScannedFileSize(file.fileSize - file.totalScannedSize);
-            m_SearchResultReporter.DispatchSearchResult(file.fileFindData, std::move(file.filePath));
+    if (file.readsInProgress > 0)
+        m_DStorageQueue->CancelRequestsWithTag(std::numeric_limits<uint64_t>::max(), GetReadRequestCancellationTag(fileIndex));
 
-            file.totalScannedSize = file.fileSize;
-            file.chunksRead = GetChunkCount(file);
-            file.dispatchedToResults = true;
-        }
-        else if (file.readsInProgress == 0 && file.chunksRead == GetChunkCount(file))
-        {
-            m_SearchResultReporter.AddToScannedFileCount();
-            m_SearchResultReporter.AddToScannedFileSize(file.fileSize - file.totalScannedSize);
-            file.totalScannedSize = file.fileSize;
-        }
-        else
-        {
-            m_SearchResultReporter.AddToScannedFileSize(kFileReadBufferBaseSize);
-            file.totalScannedSize += kFileReadBufferBaseSize;
-        }
-    }
+    // Chunks held back for their successors won't be searched anymore
+    DispatchReadChunks(file);
+}
 
-    while (!m_FilesWithReadProgress.IsEmpty())
-    {
-        auto& firstFile = m_FilesWithReadProgress.Front();
+void DirectStorageReader::OnFileReadsFinished(FileReadStateData& file)
+{
+    // No requests for it are left on the queue
+    file.file = nullptr;
+}
 
-        if (firstFile.chunksRead == GetChunkCount(firstFile) && firstFile.readsInProgress == 0)
-        {
-            m_FilesWithReadProgress.PopFront();
-        }
-        else
-        {
-            break;
-        }
-    }
+void DirectStorageReader::CancelOutstandingReadsIfResultLimitReached()
+{
+    if (m_CancelledOutstandingReads || !m_SearchResultReporter.HasReachedResultLimit())
+        return;
 
-    QueueFileReads();
+    // Cancelled requests still complete, so the fences keep getting signaled and the slots get freed as usual
+    m_DStorageQueue->CancelRequestsWithTag(kReadRequestCancellationTag, kReadRequestCancellationTag);
+    m_CancelledOutstandingReads = true;
+
+    // The last chunk issued may be waiting for one that now never will be
+    if (!m_FilesWithReadProgress.IsEmpty())
+        DispatchReadChunks(m_FilesWithReadProgress.Back());
 }
@@ -3,20 +3,17 @@
 #include "DirectStorageFileReadData.h"
 #include "Event.h"
 #include "FileContentSearchData.h"
+#include "FileReadBackends/ReadThrottle.h"
+#include "FileReadBackends/SlotSearchPipeline.h"
 #include "HandleHolder.h"
 #include "ReadBatch.h"
-#include "Utilities/IndexStableRingBuffer.h"
 #include "Utilities/ObjectPool.h"
 #include "Utilities/WorkQueue.h"
 
-struct SearchInstructions;
-class SearchResultReporter;
-class StringSearcher;
-
-class DirectStorageReader : WorkQueue<DirectStorageFileReadData>, ThreadedWorkQueue<DirectStorageReader, SlotSearchData>
+class DirectStorageReader : SlotSearchPipeline<DirectStorageReader, DirectStorageFileReadData, 512 * 1024 * 1024, 128 * 1024>, WorkQueue<DirectStorageFileReadData>, ThreadedWorkQueue<DirectStorageReader, SlotSearchData>
 {
 public:
-    DirectStorageReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter);
+    DirectStorageReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter, ReadThrottle& readThrottle);
     ~DirectStorageReader();
 
     void Initialize();
@@ -28,15 +25,21 @@ public:
         m_FileOpenWorkQueue.PushWorkItem(std::move(fileOpenData));
     }
 
-    static constexpr size_t kTargetTotalBufferSize = 512 * 1024 * 1024; // 512 MB total
-    static constexpr size_t kFileReadBufferBaseSize = 128 * 1024;
-    static constexpr uint16_t kFileReadSlotCount = kTargetTotalBufferSize / kFileReadBufferBaseSize;
+    static constexpr uint64_t kReadRequestCancellationTag = 1;
+
+    // Every request carries kReadRequestCancellationTag so all of them can be cancelled at once, and its file index so a single file's reads can be
+    static constexpr uint64_t GetReadRequestCancellationTag(uint32_t fileIndex)
+    {
+        return (static_cast<uint64_t>(fileIndex) << 1) | kReadRequestCancellationTag;
+    }
 
 private:
     typedef WorkQueue<DirectStorageFileReadData> MyFileReadBase;
     typedef ThreadedWorkQueue<DirectStorageReader, SlotSearchData> MySearchResultBase;
+    typedef SlotSearchPipeline<DirectStorageReader, DirectStorageFileReadData, 512 * 1024 * 1024, 128 * 1024> MyPipelineBase;
     friend class MyFileReadBase;
     friend class MySearchResultBase;
+    friend class MyPipelineBase;
 
 private:
     void FileOpenThread();
@@ -46,15 +49,15 @@ private:
     void ProcessReadCompletion();
     void ContentsSearchThread();
     void ProcessSearchCompletion(SlotSearchData searchData);
+    void AbandonFileReads(FileReadStateData& file, uint32_t fileIndex);
+    void OnFileReadsFinished(FileReadStateData& file);
+    void CancelOutstandingReadsIfResultLimitReached();
 
 private:
-    SearchResultReporter& m_SearchResultReporter;
-    const StringSearcher& m_StringSearcher;
+    ReadThrottle& m_ReadThrottle;
     ThreadedWorkQueue<DirectStorageReader, FileOpenData> m_FileOpenWorkQueue;
     ThreadedWorkQueue<DirectStorageReader, SlotSearchData> m_SearchWorkQueue;
-    size_t m_ReadBufferSize;
-    std::vector<DirectStorageFileReadStateData> m_FilesToRead;
-    IndexStableRingBuffer<DirectStorageFileReadStateData, uint32_t> m_FilesWithReadProgress;
+    std::vector<FileReadStateData> m_FilesToRead;
     std::vector<ReadBatch> m_SubmittedBatches;
     ObjectPool<ReadBatch> m_BatchPool;
     ReadBatch m_CurrentBatch;
@@ -66,10 +69,6 @@ private:
     uint64_t m_FenceValue;
 
     TimerHandleHolder m_WaitableTimer;
-    uint16_t m_FreeReadSlotCount;
-    std::atomic<bool> m_IsTerminating;
-
-    std::unique_ptr<uint8_t[]> m_FileReadBuffers;
-    uint64_t m_FreeReadSlots[kFileReadSlotCount / 64];
-    uint32_t m_FileReadSlots[kFileReadSlotCount];
+    bool m_CancelledOutstandingReads;
+    bool m_IsReadThrottled; // Reads are left to issue once the read budget has room for them
 };
\ No newline at end of file
@@ -1,55 +1,475 @@
 #include "PrecompiledHeader.h"
 #include "Event.h"
 #include "OverlappedIOReader.h"
+#include "ReaderWriterLock.h"
 #include "SearchInstructions.h"
 #include "SearchResultReporter.h"
 #include "StringSearch/StringSearcher.h"
+#include "Utilities/ArchiveDirectory.h"
+#include "Utilities/BinaryFileDetection.h"
+#include "Utilities/GzipDecoder.h"
 #include "Utilities/ScopedStackAllocator.h"
 
-const size_t kFileReadBufferSize = 5 * 1024 * 1024; // 5 MB
+#include <winioctl.h>
 
-OverlappedIOReader::OverlappedIOReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter) :
+const size_t kMappedViewChunkSize = 5 * 1024 * 1024; // 5 MB
+const DWORD kFileSharingFlags = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE; // We really don't want to step on anyones toes
+const uint32_t kUnbufferedReadAlignment = 4096;
+const uint32_t kMaxSmallFileSize = 64 * 1024; // Files up to this size are read whole, a batch of them at a time
+const uint32_t kSmallFileBatchSize = 32;
+const uint32_t kMaxReadsInFlightPerFile = 8;
+const size_t kMaxReadBufferRingSize = 32 * 1024 * 1024; // Per thread and chunk size, so a deep queue of large chunks can't take over memory
+const uint64_t kSplitFileRangeSize = 64 * 1024 * 1024; // 64 MB
+const uint64_t kMinSplitFileSize = 4 * kSplitFileRangeSize; // Files at least this big are searched by several threads at once
+const uint32_t kMaxDataExtentsPerQuery = 64;
+
+// What a thread has seen of the cache so far, and what it makes of it.
+// Mapping a file only pays off when its pages are already cached: otherwise they fault in a few at a time, while reads stream whole chunks.
+// Overlapped reads that the cache can satisfy complete synchronously, so the first read of every file we do read tells us how warm the tree is.
+// Cache neutral searches can only tell whether a file is cached by reading its first page through the cache, which brings that page in when
+// it isn't. Once most of the files they probe turn out not to be, they only probe one in so many, and read the rest around the cache right away.
+// Cached files among those just get read from disk, which leaves the cache as it was all the same
+struct CachePolicy
+{
+	static constexpr uint64_t kMinMappedFileSize = 256 * 1024; // Below this, creating and tearing down a view costs more than one copy
+	static constexpr uint32_t kProbeInterval = 16; // One in this many files that could be mapped is read anyway, to keep watching the cache
+	static constexpr uint32_t kMaxCacheHitScore = 256;
+	static constexpr uint32_t kMinCacheHitScoreForMapping = 192;
+	static constexpr uint32_t kMinCacheHitScoreForProbing = 32;
+
+	uint32_t cacheHitScore = 0;
+	uint32_t filesSinceLastProbe = 0;
+	uint32_t probedCacheHitScore = kMaxCacheHitScore; // Every file gets probed until the tree turns out to be cold
+	uint32_t filesSinceLastCacheProbe = 0;
+
+	bool ShouldMapFile(uint64_t fileSize)
+	{
+		if (fileSize < kMinMappedFileSize || cacheHitScore < kMinCacheHitScoreForMapping)
+			return false;
+
+		if (++filesSinceLastProbe < kProbeInterval)
+			return true;
+
+		filesSinceLastProbe = 0;
+		return false;
+	}
+
+	void OnFileRead(bool servedFromCache)
+	{
+		// Moving average over roughly the last 8 files
+		cacheHitScore = cacheHitScore - cacheHitScore / 8 + (servedFromCache ? kMaxCacheHitScore / 8 : 0);
+	}
+
+	bool ShouldProbeCache(uint64_t fileSize)
+	{
+		// Reading a file this small around the cache costs no more than probing it
+		if (fileSize <= kUnbufferedReadAlignment)
+			return false;
+
+		if (probedCacheHitScore >= kMinCacheHitScoreForProbing)
+			return true;
+
+		if (++filesSinceLastCacheProbe < kProbeInterval)
+			return false;
+
+		filesSinceLastCacheProbe = 0;
+		return true;
+	}
+
+	void OnCacheProbed(bool isCached)
+	{
+		probedCacheHitScore = probedCacheHitScore - probedCacheHitScore / 8 + (isCached ? kMaxCacheHitScore / 8 : 0);
+	}
+};
+
+struct MappedViewDeleter
+{
+	void operator()(uint8_t* view) const
+	{
+		UnmapViewOfFile(view);
+	}
+};
+
+struct VirtualMemoryDeleter
+{
+	void operator()(uint8_t* memory) const
+	{
+		VirtualFree(memory, 0, MEM_RELEASE);
+	}
+};
+
+// Every buffer has room right in front of it for the bytes carried over from the previous chunk. All of them start on a page boundary,
+// so they can take unbuffered reads, and they're reused for every file this thread reads in chunks of this size. Each buffer has a read
+// of its own, so the reads of the chunks after the one being searched can all be in flight at once, as far as the device has room for them.
+// The hole area after the buffers is where the bytes in front of a hole in a sparse file get searched along with the zeros that follow them
+struct ReadBufferRing
+{
+	uint32_t chunkSize;
+	uint32_t bufferCount;
+	std::unique_ptr<uint8_t, VirtualMemoryDeleter> allocation;
+	uint8_t* buffers[kMaxReadsInFlightPerFile + 1];
+	uint8_t* holeArea;
+	OVERLAPPED overlapped[kMaxReadsInFlightPerFile + 1];
+	Event<EventType::AutoReset> readEvents[kMaxReadsInFlightPerFile + 1];
+	int64_t issueTimes[kMaxReadsInFlightPerFile + 1];
+	bool servedFromCache[kMaxReadsInFlightPerFile + 1];
+
+	ReadBufferRing(uint32_t chunkSize, uint32_t bufferCount, size_t seamAreaSize) :
+		chunkSize(chunkSize),
+		bufferCount(bufferCount)
+	{
+		Assert(bufferCount >= 2 && bufferCount <= ARRAYSIZE(buffers));
+
+		const size_t bufferAllocationSize = seamAreaSize + chunkSize;
+		allocation.reset(static_cast<uint8_t*>(VirtualAlloc(nullptr, bufferCount * bufferAllocationSize + 2 * seamAreaSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)));
+		Assert(allocation != nullptr);
+
+		for (uint32_t i = 0; i < bufferCount; i++)
+			buffers[i] = allocation.get() + i * bufferAllocationSize + seamAreaSize;
+
+		holeArea = allocation.get() + bufferCount * bufferAllocationSize;
+	}
+};
+
+// Where a sparse file has data. Everything else reads as zeros
+struct DataExtent
+{
+	uint64_t begin;
+	uint64_t end;
+};
+
+// A file that's split into ranges, each of which is a work item of its own. The thread that reads its first chunk splits it and searches the
+// first range, and whichever thread finishes the last range reports what can only be known once all of the file has been searched
+struct SplitFileSearch : NonCopyable
+{
+	std::wstring filePath;
+	uint64_t fileSize;
+	FileFindData fileFindData;
+	DeviceReadQueue& device;
+	bool isReadUnbuffered; // Every range reads the way the first one did, so cache neutral searches decide once per file
+	std::vector<DataExtent> dataExtents;
+	std::atomic<uint32_t> pendingRanges;
+	std::atomic<bool> isDecided; // A range found a match, so the rest of them can stop
+	std::atomic<bool> isIncomplete; // A range didn't get to see all of its bytes
+	ReaderWriterLock dictionaryMatchesLock;
+	std::vector<uint32_t> dictionaryMatches;
+
+	SplitFileSearch(const FileOpenData& searchData, DeviceReadQueue& device, bool isReadUnbuffered, std::vector<DataExtent>&& dataExtents, uint32_t rangeCount) :
+		filePath(searchData.filePath),
+		fileSize(searchData.fileSize),
+		fileFindData(searchData.fileFindData),
+		device(device),
+		isReadUnbuffered(isReadUnbuffered),
+		dataExtents(std::move(dataExtents)),
+		pendingRanges(rangeCount),
+		isDecided(false),
+		isIncomplete(false)
+	{
+	}
+};
+
+// Only matches starting before rangeEnd belong to the range, but reads go on past it by the longest match, so those are seen whole
+struct FileRange
+{
+	HANDLE fileHandle;
+	uint32_t readAlignment;
+	uint64_t rangeBegin;
+	uint64_t rangeEnd;
+	uint64_t readEnd;
+	const std::atomic<bool>* isFileDecided; // Set once another range of the same file finds a match
+	DeviceReadQueue* device;
+	std::span<const DataExtent> dataExtents; // Empty unless the file has holes
+};
+
+OverlappedIOReader::OverlappedIOReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter, ReadThrottle& readThrottle) :
 	m_SearchResultReporter(searchResultReporter),
 	m_StringSearcher(stringSearcher),
-	m_MaxSearchStringLength(std::max(searchInstructions.utf8SearchString.length(), searchInstructions.searchString.length() * sizeof(wchar_t)))
+	m_SearchInstructions(searchInstructions),
+	m_ReadThrottle(readThrottle),
+	m_MaxSearchStringLength(stringSearcher.GetMaxMatchLengthInBytes()),
+	m_SeamAreaSize((m_MaxSearchStringLength + kUnbufferedReadAlignment - 1) & ~static_cast<size_t>(kUnbufferedReadAlignment - 1)),
+	m_ReadsInFlightPerFile(1),
+	m_PendingWorkItemCount(0)
 {
 }
 
 void OverlappedIOReader::Initialize()
 {
+	if (m_SearchInstructions.SearchInFileContents() || m_SearchInstructions.SearchInArchives())
+	{
+		m_ReadChunkPolicy.Initialize(m_SearchInstructions.searchPath);
+		m_DeviceReadLimiter.Initialize(m_ReadChunkPolicy);
+	}
+
 	SYSTEM_INFO systemInfo;
 	GetNativeSystemInfo(&systemInfo);
 
+	// Every thread searches one file at a time, so the queue depth is spread over the files they're on. Each device then caps the reads in flight
+	// against it, however many threads are reading from it
+	const auto queueDepth = m_ReadChunkPolicy.GetQueueDepth();
+	m_ReadsInFlightPerFile = std::clamp<uint32_t>((queueDepth + systemInfo.dwNumberOfProcessors - 1) / systemInfo.dwNumberOfProcessors, 1, kMaxReadsInFlightPerFile);
+
 	MyBase::Initialize<&OverlappedIOReader::ContentsSearchThread>(this, systemInfo.dwNumberOfProcessors);
 }
 
 void OverlappedIOReader::DrainWorkQueue()
 {
 	m_IsFinished = true;
+	m_CancelEvent.Set();
 	MyBase::DrainWorkQueue();
+	m_WorkItemsDoneEvent.Set();
+}
+
+void OverlappedIOReader::CompleteAllWork()
+{
+	// Telling the threads to finish once the queue is empty would let them go while a split file still has ranges left to queue
+	while (m_PendingWorkItemCount != 0 && !m_IsFinished)
+	{
+		auto waitResult = WaitForSingleObject(m_WorkItemsDoneEvent, INFINITE);
+		Assert(waitResult == WAIT_OBJECT_0);
+	}
+
+	MyBase::CompleteAllWork();
+	m_SearchResultReporter.OnMaxDeviceReadsInFlightThreadUnsafe(m_DeviceReadLimiter.GetMaxReadsInFlight());
+}
+
+bool OverlappedIOReader::ShouldStopSearching() const
+{
+	return m_IsFinished || m_SearchResultReporter.HasReachedResultLimit();
 }
 
 void OverlappedIOReader::ContentsSearchThread()
 {
 	SetThreadDescription(GetCurrentThread(), L"FSS Overlapped I/O Reader Thread");
 
+	// One ring of buffers per chunk size, allocated the first time this thread reads a file in chunks of that size. Threads that only
+	// come across small files never commit memory for large chunks
+	std::vector<ReadBufferRing> readBufferRings;
+
+	// Small files each get a whole slot of this, so the reads of a batch can all be in flight at once
+	std::unique_ptr<uint8_t, VirtualMemoryDeleter> smallFileReadBuffers;
+	std::vector<const FileOpenData*> smallFiles;
+
 	ScopedStackAllocator stackAllocator;
-	std::unique_ptr<uint8_t[]> fileReadBuffers[2] =
+	FileContentSearchState searchState;
+	CachePolicy cachePolicy;
+
+	auto getReadBuffers = [this, &readBufferRings](uint64_t fileSize) -> ReadBufferRing&
+	{
+		const auto chunkSize = m_ReadChunkPolicy.GetChunkSize(fileSize);
+		auto readBuffers = std::find_if(readBufferRings.begin(), readBufferRings.end(), [chunkSize](const ReadBufferRing& ring) { return ring.chunkSize == chunkSize; });
+		if (readBuffers == readBufferRings.end())
+		{
+			const auto readsInFlight = std::min(m_ReadsInFlightPerFile, static_cast<uint32_t>(std::max<size_t>(kMaxReadBufferRingSize / chunkSize, 2) - 1));
+			readBuffers = readBufferRings.emplace(readBufferRings.end(), chunkSize, readsInFlight + 1, m_SeamAreaSize);
+		}
+
+		return *readBuffers;
+	};
+
+	auto searchFile = [this, &getReadBuffers, &stackAllocator, &searchState, &cachePolicy](const FileOpenData& searchData)
 	{
-		std::unique_ptr<uint8_t[]>(new uint8_t[kFileReadBufferSize]),
-		std::unique_ptr<uint8_t[]>(new uint8_t[kFileReadBufferSize]),
+		if (ShouldStopSearching())
+			return;
+
+		// Pages faulted in through a view would get past the read budget, and stay in the cache. Searches that lower case the text in place
+		// would turn every page they touch into a private copy, which costs more than reading it
+		if (m_SearchInstructions.UseFileMapping() && !m_SearchInstructions.CacheNeutralReads() && !m_ReadThrottle.IsLimited() && !m_StringSearcher.ModifiesSearchedBytes() &&
+			cachePolicy.ShouldMapFile(searchData.fileSize))
+		{
+			auto result = SearchMappedFileContents(searchData, stackAllocator, searchState);
+			if (result == MappedFileSearchResult::kScanned)
+				m_SearchResultReporter.AddToScannedFileCount();
+
+			if (result != MappedFileSearchResult::kNotMapped)
+				return;
+		}
+
+		if (SearchFileContents(searchData, getReadBuffers(searchData.fileSize), stackAllocator, searchState, cachePolicy))
+			m_SearchResultReporter.AddToScannedFileCount();
 	};
 
-	Event<EventType::AutoReset> overlappedEvent;
+	auto isSmallFile = [](const OverlappedIOWorkItem& workItem)
+	{
+		return workItem.splitFile == nullptr && !workItem.isArchive && workItem.fileOpenData.fileSize <= kMaxSmallFileSize;
+	};
 
-	DoWork([this, &fileReadBuffers, &stackAllocator, &overlappedEvent](const FileOpenData& searchData)
+	DoBatchedWork(kSmallFileBatchSize, isSmallFile, [this, &isSmallFile, &smallFiles, &smallFileReadBuffers, &getReadBuffers, &stackAllocator, &searchState, &cachePolicy, &searchFile](std::span<OverlappedIOWorkItem* const> batch)
 	{
-		SearchFileContents(searchData, fileReadBuffers[0].get(), fileReadBuffers[1].get(), stackAllocator, overlappedEvent);
-		m_SearchResultReporter.AddToScannedFileCount();
+		smallFiles.clear();
+
+		for (auto workItem : batch)
+		{
+			if (isSmallFile(*workItem))
+				smallFiles.push_back(&workItem->fileOpenData);
+		}
+
+		if (!smallFiles.empty())
+		{
+			if (smallFileReadBuffers == nullptr)
+			{
+				smallFileReadBuffers.reset(static_cast<uint8_t*>(VirtualAlloc(nullptr, kSmallFileBatchSize * kMaxSmallFileSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE)));
+				Assert(smallFileReadBuffers != nullptr);
+			}
+
+			SearchSmallFiles(smallFiles, smallFileReadBuffers.get(), stackAllocator, searchState, cachePolicy);
+		}
+
+		for (auto workItem : batch)
+		{
+			if (workItem->splitFile != nullptr)
+			{
+				SearchSplitFileRange(*workItem->splitFile, workItem->rangeIndex, getReadBuffers(workItem->splitFile->fileSize), stackAllocator, searchState);
+			}
+			else if (workItem->isArchive)
+			{
+				if (!ShouldStopSearching() && SearchArchive(workItem->fileOpenData, workItem->isArchiveReported, getReadBuffers(workItem->fileOpenData.fileSize), stackAllocator, searchState, cachePolicy))
+					m_SearchResultReporter.AddToScannedFileCount();
+			}
+			else if (!isSmallFile(*workItem))
+			{
+				searchFile(workItem->fileOpenData);
+			}
+		}
+
+		if (m_PendingWorkItemCount.fetch_sub(static_cast<uint32_t>(batch.size())) == batch.size())
+			m_WorkItemsDoneEvent.Set();
 	});
 }
 
-static inline bool InitiateFileRead(HANDLE fileHandle, uint64_t fileOffset, uint64_t fileSize, uint8_t*& primaryBuffer, uint8_t*& secondaryBuffer, OVERLAPPED& overlapped, HANDLE overlappedEvent)
+// Unbuffered reads have to start on, and cover whole, sectors of the device, and land in sector aligned memory. Reads here always start
+// on a chunk boundary and go to page aligned buffers, and the last one is rounded up, so that holds for any sector up to a page
+static bool CanReadUnbuffered(HANDLE fileHandle)
+{
+	FILE_STORAGE_INFO storageInfo;
+	if (!GetFileInformationByHandleEx(fileHandle, FileStorageInfo, &storageInfo, sizeof(storageInfo)))
+		return false;
+
+	return std::max(storageInfo.LogicalBytesPerSector, storageInfo.PhysicalBytesPerSectorForPerformance) <= kUnbufferedReadAlignment;
+}
+
+static FileHandleHolder OpenFileForReading(const std::wstring& filePath, bool unbuffered, uint32_t& readAlignment)
+{
+	const DWORD kFileFlags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED;
+	readAlignment = 1;
+
+	if (unbuffered)
+	{
+		FileHandleHolder fileHandle = CreateFileW(filePath.c_str(), GENERIC_READ, kFileSharingFlags, nullptr, OPEN_EXISTING, kFileFlags | FILE_FLAG_NO_BUFFERING, nullptr);
+		if (fileHandle != INVALID_HANDLE_VALUE && CanReadUnbuffered(fileHandle))
+		{
+			readAlignment = kUnbufferedReadAlignment;
+			return fileHandle;
+		}
+	}
+
+	return CreateFileW(filePath.c_str(), GENERIC_READ, kFileSharingFlags, nullptr, OPEN_EXISTING, kFileFlags, nullptr);
+}
+
+// A buffered read completes synchronously when the cache has all of it. When it doesn't, the page gets read from disk, and without
+// read-ahead that's about all of the file that ends up in the cache. A file that has shrunk to nothing has nothing to bring in
+static bool IsFirstPageCached(HANDLE fileHandle)
+{
+	uint8_t page[kUnbufferedReadAlignment];
+	OVERLAPPED overlapped = {};
+
+	if (ReadFile(fileHandle, page, sizeof(page), nullptr, &overlapped) || GetLastError() == ERROR_HANDLE_EOF)
+		return true;
+
+	// The read lands on our stack, so it has to be waited out
+	if (GetLastError() == ERROR_IO_PENDING)
+	{
+		DWORD bytesRead;
+		GetOverlappedResult(fileHandle, &overlapped, &bytesRead, TRUE);
+	}
+
+	return false;
+}
+
+// Cache neutral searches only read a file through the cache if it has the file already, and otherwise read around it, so a search leaves
+// the cache the way it found it
+FileHandleHolder OverlappedIOReader::OpenFileForChunkedReading(const std::wstring& filePath, uint64_t fileSize, CachePolicy& cachePolicy, uint32_t& readAlignment) const
+{
+	if (!m_SearchInstructions.CacheNeutralReads())
+		return OpenFileForReading(filePath, m_SearchInstructions.UseUnbufferedIO(), readAlignment);
+
+	if (!cachePolicy.ShouldProbeCache(fileSize))
+		return OpenFileForReading(filePath, true, readAlignment);
+
+	readAlignment = 1;
+	FileHandleHolder fileHandle = CreateFileW(filePath.c_str(), GENERIC_READ, kFileSharingFlags, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return fileHandle;
+
+	const bool isCached = IsFirstPageCached(fileHandle);
+	cachePolicy.OnCacheProbed(isCached);
+
+	if (isCached)
+		return fileHandle;
+
+	// Reopening the handle we have skips looking the path up again. Devices that can't take our unbuffered reads keep the handle they were probed with
+	FileHandleHolder unbufferedHandle = ReOpenFile(fileHandle, GENERIC_READ, kFileSharingFlags, FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING);
+	if (unbufferedHandle == INVALID_HANDLE_VALUE || !CanReadUnbuffered(unbufferedHandle))
+		return fileHandle;
+
+	readAlignment = kUnbufferedReadAlignment;
+	return unbufferedHandle;
+}
+
+// Empty unless the file has holes worth skipping. A file system that can't tell us has the whole file read
+static std::vector<DataExtent> QueryDataExtents(HANDLE fileHandle, uint64_t fileSize)
+{
+	std::vector<DataExtent> dataExtents;
+	FILE_ALLOCATED_RANGE_BUFFER queryRange;
+	queryRange.FileOffset.QuadPart = 0;
+	queryRange.Length.QuadPart = static_cast<LONGLONG>(fileSize);
+
+	for (;;)
+	{
+		FILE_ALLOCATED_RANGE_BUFFER allocatedRanges[kMaxDataExtentsPerQuery];
+		OVERLAPPED overlapped = {};
+
+		// Nothing else is in flight on the handle yet, so it's what gets signaled when the query completes
+		BOOL succeeded = DeviceIoControl(fileHandle, FSCTL_QUERY_ALLOCATED_RANGES, &queryRange, sizeof(queryRange), allocatedRanges, sizeof(allocatedRanges), nullptr, &overlapped);
+		if (!succeeded && GetLastError() == ERROR_IO_PENDING)
+		{
+			DWORD bytesReturned;
+			succeeded = GetOverlappedResult(fileHandle, &overlapped, &bytesReturned, TRUE);
+		}
+
+		// Running out of room still returns as many ranges as fit
+		const bool hasMoreData = !succeeded && GetLastError() == ERROR_MORE_DATA;
+		if (!succeeded && !hasMoreData)
+			return {};
+
+		const auto rangeCount = overlapped.InternalHigh / sizeof(FILE_ALLOCATED_RANGE_BUFFER);
+		for (size_t i = 0; i < rangeCount; i++)
+		{
+			const uint64_t begin = allocatedRanges[i].FileOffset.QuadPart;
+			dataExtents.push_back({ begin, std::min(fileSize, begin + allocatedRanges[i].Length.QuadPart) });
+		}
+
+		if (!hasMoreData || rangeCount == 0)
+			break;
+
+		const auto queryEnd = queryRange.FileOffset.QuadPart + queryRange.Length.QuadPart;
+		queryRange.FileOffset.QuadPart = static_cast<LONGLONG>(dataExtents.back().end);
+		queryRange.Length.QuadPart = queryEnd - queryRange.FileOffset.QuadPart;
+	}
+
+	// Allocated all the way through, after all
+	if (dataExtents.size() == 1 && dataExtents[0].begin == 0 && dataExtents[0].end == fileSize)
+		dataExtents.clear();
+
+	return dataExtents;
+}
+
+static inline uint32_t GetReadSize(uint64_t fileOffset, uint64_t fileSize, uint32_t chunkSize)
+{
+	return static_cast<uint32_t>(std::min<uint64_t>(fileSize - fileOffset, chunkSize));
+}
+
+static inline bool InitiateFileRead(HANDLE fileHandle, uint64_t fileOffset, uint64_t fileSize, uint32_t chunkSize, uint32_t readAlignment, uint8_t* buffer, OVERLAPPED& overlapped, HANDLE overlappedEvent, bool* completedSynchronously = nullptr)
 {
 	ZeroMemory(&overlapped, sizeof(overlapped));
 
@@ -57,87 +477,1133 @@ static inline bool InitiateFileRead(HANDLE fileHandle, uint64_t fileOffset, uint
 	overlapped.Offset = static_cast<uint32_t>(fileOffset & 0xFFFFFFFF);
 	overlapped.OffsetHigh = static_cast<uint32_t>(fileOffset >> 32);
 
-	uint32_t bytesToRead = static_cast<uint32_t>(std::min(fileSize - fileOffset, kFileReadBufferSize));
+	// Chunks are a whole number of pages, so rounding the last read up never runs past the end of the buffer
+	const uint32_t bytesToRead = (GetReadSize(fileOffset, fileSize, chunkSize) + readAlignment - 1) & ~(readAlignment - 1);
 
-	auto readResult = ReadFile(fileHandle, primaryBuffer, bytesToRead, nullptr, &overlapped);
+	auto readResult = ReadFile(fileHandle, buffer, bytesToRead, nullptr, &overlapped);
 	Assert(readResult != FALSE || GetLastError() == ERROR_IO_PENDING);
 
-	std::swap(primaryBuffer, secondaryBuffer);
+	if (completedSynchronously != nullptr)
+		*completedSynchronously = readResult != FALSE;
+
 	return readResult != FALSE || GetLastError() == ERROR_IO_PENDING;
 }
 
-void OverlappedIOReader::SearchFileContents(const FileOpenData& searchData, uint8_t* primaryBuffer, uint8_t* secondaryBuffer, ScopedStackAllocator& stackAllocator, HANDLE overlappedEvent)
+// A rounded up read can pick up bytes appended since the file was enumerated. We stick to the size we were given
+static inline uint32_t GetBytesRead(const OVERLAPPED& overlapped, uint64_t fileOffset, uint64_t fileSize, uint32_t chunkSize)
 {
-	const DWORD kFileSharingFlags = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE; // We really don't want to step on anyones toes
-	uint64_t fileOffset = 0;
+	return static_cast<uint32_t>(std::min<uint64_t>(overlapped.InternalHigh, GetReadSize(fileOffset, fileSize, chunkSize)));
+}
 
-	FileHandleHolder fileHandle = CreateFileW(searchData.filePath.c_str(), GENERIC_READ, kFileSharingFlags, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, nullptr);
+// A search being cancelled doesn't wait for the read to finish on its own: the read gets cancelled, and completes short
+static void WaitForRead(HANDLE fileHandle, OVERLAPPED& overlapped, HANDLE readEvent, HANDLE cancelEvent)
+{
+	const HANDLE waitHandles[] = { readEvent, cancelEvent };
+	auto waitResult = WaitForMultipleObjects(ARRAYSIZE(waitHandles), waitHandles, FALSE, INFINITE);
+	Assert(waitResult == WAIT_OBJECT_0 || waitResult == WAIT_OBJECT_0 + 1);
 
-	if (fileHandle == INVALID_HANDLE_VALUE)
+	if (waitResult == WAIT_OBJECT_0 + 1)
 	{
-		m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize);
-		return;
+		CancelIoEx(fileHandle, &overlapped);
+		waitResult = WaitForSingleObject(readEvent, INFINITE);
+		Assert(waitResult == WAIT_OBJECT_0);
 	}
+}
+
+static inline FileRange GetSplitFileRange(const SplitFileSearch& splitFile, uint32_t rangeIndex, HANDLE fileHandle, uint32_t readAlignment, size_t maxMatchLength)
+{
+	const uint64_t rangeBegin = rangeIndex * kSplitFileRangeSize;
+	const uint64_t rangeEnd = std::min(splitFile.fileSize, rangeBegin + kSplitFileRangeSize);
+	return { fileHandle, readAlignment, rangeBegin, rangeEnd, std::min<uint64_t>(splitFile.fileSize, rangeEnd + maxMatchLength), &splitFile.isDecided, &splitFile.device, splitFile.dataExtents };
+}
+
+// Hands compressed data to its decoder a chunk at a time, either a whole file or a member of an archive. The first two buffers of the ring take
+// turns: the next chunk gets read into one while the decoder works through the other, so reading and decompressing overlap. Files that were
+// read whole already go in one piece
+struct CompressedFileInput : NonCopyable
+{
+	ReadThrottle& readThrottle;
+	SearchResultReporter& searchResultReporter;
+	HANDLE fileHandle; // nullptr for files that were read whole already
+	HANDLE cancelEvent;
+	DeviceReadQueue* device;
+	ReadBufferRing* readBuffers;
+	uint64_t readEnd;
+	uint32_t readAlignment;
+	uint64_t nextReadOffset;
+	uint64_t readInFlightOffset;
+	uint32_t nextReadBuffer;
+	bool isReadInFlight;
+	std::span<const uint8_t> readBytes; // Read, but not handed over yet
+	uint64_t bytesHandedOver;
 
-	OVERLAPPED overlapped;
-	if (!InitiateFileRead(fileHandle, fileOffset, searchData.fileSize, primaryBuffer, secondaryBuffer, overlapped, overlappedEvent))
+	CompressedFileInput(ReadThrottle& readThrottle, SearchResultReporter& searchResultReporter, std::span<const uint8_t> fileContents) :
+		readThrottle(readThrottle),
+		searchResultReporter(searchResultReporter),
+		fileHandle(nullptr),
+		cancelEvent(nullptr),
+		device(nullptr),
+		readBuffers(nullptr),
+		readEnd(fileContents.size()),
+		readAlignment(1),
+		nextReadOffset(fileContents.size()),
+		readInFlightOffset(0),
+		nextReadBuffer(0),
+		isReadInFlight(false),
+		readBytes(fileContents),
+		bytesHandedOver(0)
 	{
-		m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize);
-		return;
 	}
 
-	auto waitResult = WaitForSingleObject(overlappedEvent, INFINITE);
-	Assert(waitResult == WAIT_OBJECT_0);
+	// The first chunk, the one at readBegin, is in the first buffer already
+	CompressedFileInput(ReadThrottle& readThrottle, SearchResultReporter& searchResultReporter, HANDLE fileHandle, HANDLE cancelEvent, DeviceReadQueue& device, ReadBufferRing& readBuffers, uint32_t readAlignment, uint64_t readBegin, uint64_t readEnd, uint32_t bytesRead) :
+		readThrottle(readThrottle),
+		searchResultReporter(searchResultReporter),
+		fileHandle(fileHandle),
+		cancelEvent(cancelEvent),
+		device(&device),
+		readBuffers(&readBuffers),
+		readEnd(readEnd),
+		readAlignment(readAlignment),
+		nextReadOffset(bytesRead < GetReadSize(readBegin, readEnd, readBuffers.chunkSize) ? readEnd : readBegin + bytesRead),
+		readInFlightOffset(0),
+		nextReadBuffer(1),
+		isReadInFlight(false),
+		readBytes(readBuffers.buffers[0], bytesRead),
+		bytesHandedOver(0)
+	{
+	}
+
+	~CompressedFileInput()
+	{
+		CancelRead();
+	}
 
-	uint32_t bytesRead = static_cast<uint32_t>(overlapped.InternalHigh);
-	fileOffset += bytesRead;
-	Assert(static_cast<int64_t>(fileOffset) >= 0);
-	if (fileOffset != searchData.fileSize)
+	static std::span<const uint8_t> ReadInput(void* context)
 	{
-		Assert(fileOffset >= m_MaxSearchStringLength);
-		fileOffset -= m_MaxSearchStringLength;
+		return static_cast<CompressedFileInput*>(context)->ReadNextChunk();
 	}
 
-	while (!m_IsFinished && searchData.fileSize - fileOffset > 0)
+	// The decoder is done with the chunk it had, so its buffer can take the read after the one that gets handed over now
+	std::span<const uint8_t> ReadNextChunk()
 	{
-		if (!InitiateFileRead(fileHandle, fileOffset, searchData.fileSize, primaryBuffer, secondaryBuffer, overlapped, overlappedEvent))
+		auto chunk = readBytes;
+		readBytes = {};
+
+		if (chunk.empty() && isReadInFlight)
 		{
-			m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize - fileOffset);
-			return;
+			const auto buffer = nextReadBuffer ^ 1;
+			WaitForRead(fileHandle, readBuffers->overlapped[buffer], readBuffers->readEvents[buffer], cancelEvent);
+
+			const auto bytesRead = GetBytesRead(readBuffers->overlapped[buffer], readInFlightOffset, readEnd, readBuffers->chunkSize);
+			device->OnReadCompleted(bytesRead, readBuffers->issueTimes[buffer]);
+			searchResultReporter.OnFileBytesRead(bytesRead, readBuffers->servedFromCache[buffer] && readAlignment == 1);
+			isReadInFlight = false;
+
+			// The file shrank since it was enumerated
+			if (bytesRead < GetReadSize(readInFlightOffset, readEnd, readBuffers->chunkSize))
+				nextReadOffset = readEnd;
+
+			chunk = std::span<const uint8_t>(readBuffers->buffers[buffer], bytesRead);
 		}
 
-		if (m_StringSearcher.PerformFileContentSearch(primaryBuffer, bytesRead, stackAllocator))
+		if (!chunk.empty())
+			IssueRead();
+
+		bytesHandedOver += chunk.size();
+		return chunk;
+	}
+
+	// Nothing else is in flight for this thread, so the read can wait for its turn in the read budget and room on the device
+	void IssueRead()
+	{
+		if (fileHandle == nullptr || nextReadOffset >= readEnd)
+			return;
+
+		const auto readSize = GetReadSize(nextReadOffset, readEnd, readBuffers->chunkSize);
+		readThrottle.AcquireRead(readSize);
+		device->AcquireRead();
+		readBuffers->issueTimes[nextReadBuffer] = DeviceReadQueue::GetTimestamp();
+
+		if (!InitiateFileRead(fileHandle, nextReadOffset, readEnd, readBuffers->chunkSize, readAlignment, readBuffers->buffers[nextReadBuffer], readBuffers->overlapped[nextReadBuffer], readBuffers->readEvents[nextReadBuffer], &readBuffers->servedFromCache[nextReadBuffer]))
 		{
-			m_SearchResultReporter.AddToScannedFileSize(bytesRead + searchData.fileSize - fileOffset);
-			m_SearchResultReporter.DispatchSearchResult(searchData.fileFindData, searchData.filePath.c_str());
+			// The decoder sees the file end here, and reports it as cut short
+			device->OnReadCancelled();
+			nextReadOffset = readEnd;
+			return;
+		}
 
-			CancelIoEx(fileHandle, &overlapped);
-			waitResult = WaitForSingleObject(overlappedEvent, INFINITE);
-			Assert(waitResult == WAIT_OBJECT_0);
+		readInFlightOffset = nextReadOffset;
+		nextReadOffset += readSize;
+		nextReadBuffer ^= 1;
+		isReadInFlight = true;
+	}
 
+	// The buffers get reused for the next file, so nothing can be left landing in them
+	void CancelRead()
+	{
+		if (!isReadInFlight)
 			return;
+
+		const auto buffer = nextReadBuffer ^ 1;
+		CancelIoEx(fileHandle, &readBuffers->overlapped[buffer]);
+
+		auto waitResult = WaitForSingleObject(readBuffers->readEvents[buffer], INFINITE);
+		Assert(waitResult == WAIT_OBJECT_0);
+		device->OnReadCancelled();
+		isReadInFlight = false;
+	}
+};
+
+// Reads the directory of an archive, and the local headers in front of zip members: a few scattered reads, waited for one at a time. They still
+// take their turn in the read budget and on the device. Nothing else is in flight on the handle then, so it's what gets signaled
+struct ArchiveReadContext
+{
+	HANDLE fileHandle;
+	HANDLE cancelEvent;
+	DeviceReadQueue& device;
+	ReadThrottle& readThrottle;
+	SearchResultReporter& searchResultReporter;
+
+	static uint32_t ReadAt(void* context, uint64_t offset, uint8_t* buffer, uint32_t length)
+	{
+		auto& readContext = *static_cast<ArchiveReadContext*>(context);
+		readContext.readThrottle.AcquireRead(length);
+		readContext.device.AcquireRead();
+		const auto issueTime = DeviceReadQueue::GetTimestamp();
+
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<uint32_t>(offset & 0xFFFFFFFF);
+		overlapped.OffsetHigh = static_cast<uint32_t>(offset >> 32);
+
+		BOOL succeeded = ReadFile(readContext.fileHandle, buffer, length, nullptr, &overlapped);
+		const bool servedFromCache = succeeded != FALSE;
+
+		if (!succeeded && GetLastError() == ERROR_IO_PENDING)
+		{
+			DWORD bytesTransferred;
+			WaitForRead(readContext.fileHandle, overlapped, readContext.fileHandle, readContext.cancelEvent);
+			succeeded = GetOverlappedResult(readContext.fileHandle, &overlapped, &bytesTransferred, FALSE);
 		}
-		else
+
+		if (!succeeded)
 		{
-			m_SearchResultReporter.AddToScannedFileSize(bytesRead);
+			readContext.device.OnReadCancelled();
+			return 0;
 		}
 
-		waitResult = WaitForSingleObject(overlappedEvent, INFINITE);
-		Assert(waitResult == WAIT_OBJECT_0);
+		const auto bytesRead = static_cast<uint32_t>(overlapped.InternalHigh);
+		readContext.device.OnReadCompleted(bytesRead, issueTime);
+		readContext.searchResultReporter.OnFileBytesRead(bytesRead, servedFromCache);
+		return bytesRead;
+	}
+};
+
+// searchedLength is where the next chunk starts: anything starting past it is left for that chunk
+bool OverlappedIOReader::SearchChunk(uint8_t* buffer, uint32_t bufferLength, uint64_t chunkOffset, uint32_t searchedLength, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState) const
+{
+	// Dictionary searches report every entry found in the file, so no single chunk can end them early. Unless any entry at all rules the file out
+	if (m_StringSearcher.IsDictionarySearch())
+	{
+		m_StringSearcher.FindDictionaryMatches(buffer, bufferLength, searchState.dictionaryMatches);
+		return m_SearchInstructions.InvertContentMatch() && !searchState.dictionaryMatches.empty();
+	}
+
+	// Chunks are searched in order, so the proximity window simply carries over from one to the next
+	if (m_StringSearcher.IsProximitySearch())
+		return m_StringSearcher.FindProximityMatch(buffer, bufferLength, searchedLength, chunkOffset, searchState.proximityWindow);
+
+	return m_StringSearcher.PerformFileContentSearch(buffer, bufferLength, stackAllocator);
+}
+
+bool OverlappedIOReader::SearchFileContents(const FileOpenData& searchData, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState, CachePolicy& cachePolicy)
+{
+	const uint64_t fileSize = searchData.fileSize;
+	const uint32_t chunkSize = readBuffers.chunkSize;
+	searchState.Reset();
+
+	uint32_t readAlignment;
+	FileHandleHolder fileHandle = OpenFileForChunkedReading(searchData.filePath, fileSize, cachePolicy, readAlignment);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		m_SearchResultReporter.AddToScannedFileSize(fileSize);
+		return true;
+	}
+
+	// This thread has nothing else in flight, so it can wait for its turn in the read budget and room on the device
+	auto& device = m_DeviceReadLimiter.GetDevice(fileHandle, searchData.filePath);
+	m_ReadThrottle.AcquireRead(GetReadSize(0, fileSize, chunkSize));
+	device.AcquireRead();
+	readBuffers.issueTimes[0] = DeviceReadQueue::GetTimestamp();
+
+	bool servedFromCache;
+	if (!InitiateFileRead(fileHandle, 0, fileSize, chunkSize, readAlignment, readBuffers.buffers[0], readBuffers.overlapped[0], readBuffers.readEvents[0], &servedFromCache))
+	{
+		device.OnReadCancelled();
+		m_SearchResultReporter.AddToScannedFileSize(fileSize);
+		return true;
+	}
+
+	cachePolicy.OnFileRead(servedFromCache);
+
+	WaitForRead(fileHandle, readBuffers.overlapped[0], readBuffers.readEvents[0], m_CancelEvent);
+
+	const uint32_t bytesRead = GetBytesRead(readBuffers.overlapped[0], 0, fileSize, chunkSize);
+	device.OnReadCompleted(bytesRead, readBuffers.issueTimes[0]);
+	m_SearchResultReporter.OnFileBytesRead(bytesRead, servedFromCache && readAlignment == 1);
+
+	// A compressed file is one stream, so it can't be split into ranges, and it's what it decompresses to that gets checked for being binary
+	if (m_SearchInstructions.SearchCompressedFiles() && GzipDecoder::IsGzip(readBuffers.buffers[0], bytesRead))
+	{
+		CompressedFileInput input(m_ReadThrottle, m_SearchResultReporter, fileHandle, m_CancelEvent, device, readBuffers, readAlignment, 0, fileSize, bytesRead);
+		return SearchCompressedFile(searchData, input, stackAllocator, searchState);
+	}
+
+	// Decide based on the first chunk alone, before we issue any more reads for this file
+	if (m_SearchInstructions.SkipBinaryFiles() && BinaryFileDetection::IsBinary(readBuffers.buffers[0], bytesRead))
+	{
+		m_SearchResultReporter.OnBinaryFileSkipped(fileSize);
+		return false;
+	}
+
+	// Reading a hole only ever gets us zeros, so the rest of a sparse file is read an extent at a time
+	std::vector<DataExtent> dataExtents;
+	if ((searchData.fileFindData.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) != 0 && fileSize > chunkSize)
+		dataExtents = QueryDataExtents(fileHandle, fileSize);
+
+	// Past the first chunk, a big enough file is split into ranges for other threads to search alongside this one. Proximity searches carry
+	// their window over from one chunk to the next, so they can't start in the middle of a file
+	if (fileSize >= kMinSplitFileSize && !m_StringSearcher.IsProximitySearch())
+	{
+		const auto rangeCount = static_cast<uint32_t>((fileSize + kSplitFileRangeSize - 1) / kSplitFileRangeSize);
+		auto splitFile = std::make_shared<SplitFileSearch>(searchData, device, readAlignment != 1, std::move(dataExtents), rangeCount);
 
-		bytesRead = static_cast<uint32_t>(overlapped.InternalHigh);
-		fileOffset += bytesRead;
-		Assert(static_cast<int64_t>(fileOffset) >= 0);
-		if (fileOffset != searchData.fileSize)
+		for (uint32_t i = 1; i < rangeCount; i++)
 		{
-			Assert(fileOffset >= m_MaxSearchStringLength);
-			fileOffset -= m_MaxSearchStringLength;
+			m_PendingWorkItemCount++;
+			PushWorkItem(splitFile, i);
 		}
+
+		auto result = SearchFileRange(GetSplitFileRange(*splitFile, 0, fileHandle, readAlignment, m_MaxSearchStringLength), readBuffers, bytesRead, stackAllocator, searchState);
+		FinishSplitFileRange(*splitFile, result, searchState);
+		return false; // Counted by whichever range finishes last
 	}
 
-	if (m_StringSearcher.PerformFileContentSearch(secondaryBuffer, bytesRead, stackAllocator))
-		m_SearchResultReporter.DispatchSearchResult(searchData.fileFindData, searchData.filePath.c_str());
+	const FileRange wholeFile = { fileHandle, readAlignment, 0, fileSize, fileSize, nullptr, &device, dataExtents };
+	auto result = SearchFileRange(wholeFile, readBuffers, bytesRead, stackAllocator, searchState);
+	ReportFileResult(searchData.fileFindData, searchData.filePath, result, searchState);
+	return true;
+}
 
-	m_SearchResultReporter.AddToScannedFileSize(bytesRead);
+void OverlappedIOReader::ReportFileResult(const FileFindData& fileFindData, const std::wstring& filePath, RangeSearchResult result, FileContentSearchState& searchState)
+{
+	// A match decides the file either way: it's a result, or with an inverted match it can't be one
+	if (result == RangeSearchResult::kFound)
+	{
+		if (!m_SearchInstructions.InvertContentMatch())
+			m_SearchResultReporter.DispatchSearchResult(fileFindData, std::wstring(filePath));
+	}
+	else if (result == RangeSearchResult::kStopped)
+	{
+		// Someone else satisfied the search while we were busy with this file
+	}
+	else if (m_SearchInstructions.InvertContentMatch())
+	{
+		// Only a file we've seen all of can be reported as not containing the search string
+		if (result == RangeSearchResult::kSearchedAll)
+			m_SearchResultReporter.DispatchSearchResult(fileFindData, std::wstring(filePath));
+	}
+	else if (!searchState.dictionaryMatches.empty())
+	{
+		m_SearchResultReporter.DispatchDictionarySearchResult(fileFindData, std::wstring(filePath), std::move(searchState.dictionaryMatches));
+		searchState.dictionaryMatches.clear();
+	}
 }
 
+// Searches a range of an open file, starting with its first chunk, which the caller has already read into the first buffer. Reads never overlap,
+// so they stay on chunk boundaries. Instead, the last bytes of each chunk are copied in front of the next one, and the search of a chunk covers both.
+// Holes in a sparse file aren't read at all: the bytes in front of one get searched along with as many of its zeros as a match could take up, and
+// the chunk after it gets zeros in front of it, so a hole can only be part of a match where the search string has zeros
+OverlappedIOReader::RangeSearchResult OverlappedIOReader::SearchFileRange(const FileRange& range, ReadBufferRing& readBuffers, uint32_t bytesRead, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	const uint32_t chunkSize = readBuffers.chunkSize;
+	const uint32_t bufferCount = readBuffers.bufferCount;
+	const uint64_t alignmentMask = ~static_cast<uint64_t>(range.readAlignment - 1);
+
+	// The first extent that ends past fileOffset
+	auto findDataExtent = [&](uint64_t fileOffset)
+	{
+		return std::upper_bound(range.dataExtents.begin(), range.dataExtents.end(), fileOffset, [](uint64_t offset, const DataExtent& extent) { return offset < extent.end; });
+	};
+
+	// Where the chunk after one that ends at fileOffset gets read from
+	auto skipHole = [&](uint64_t fileOffset) -> uint64_t
+	{
+		if (range.dataExtents.empty())
+			return fileOffset;
+
+		auto extent = findDataExtent(fileOffset);
+		if (extent == range.dataExtents.end())
+			return range.readEnd;
+
+		return std::min(std::max(fileOffset, extent->begin & alignmentMask), range.readEnd);
+	};
+
+	// Reads stop at the end of the extent they start in, so the next one can skip the hole after it
+	auto getChunkReadSize = [&](uint64_t fileOffset)
+	{
+		auto readSize = GetReadSize(fileOffset, range.readEnd, chunkSize);
+		auto extent = findDataExtent(fileOffset);
+
+		if (extent != range.dataExtents.end())
+			readSize = static_cast<uint32_t>(std::min<uint64_t>(readSize, ((extent->end + range.readAlignment - 1) & alignmentMask) - fileOffset));
+
+		return readSize;
+	};
+
+	uint32_t currentBuffer = 0;
+	uint32_t readsInFlight = 0; // Into the buffers right after the current one
+	uint32_t readSize = GetReadSize(range.rangeBegin, range.readEnd, chunkSize); // Of the chunk in the current buffer
+	uint64_t readOffset = range.rangeBegin;
+	uint64_t nextReadOffset = skipHole(range.rangeBegin + readSize);
+	uint64_t chunkOffset = range.rangeBegin;
+	uint64_t scannedOffset = range.rangeBegin; // Bytes read past the end of the range are scanned by the next one
+	uint32_t seamLength = 0;
+
+	// Every buffer but the one being searched can take a read. The read of the next chunk waits for its turn in the read budget and room on
+	// the device, since this thread has nothing else in flight then, and the ones after it only go out while there are both
+	auto issueReads = [&]()
+	{
+		while (readsInFlight < bufferCount - 1 && nextReadOffset < range.readEnd)
+		{
+			const auto nextReadSize = getChunkReadSize(nextReadOffset);
+
+			if (readsInFlight == 0)
+			{
+				m_ReadThrottle.AcquireRead(nextReadSize);
+				range.device->AcquireRead();
+			}
+			else if (!range.device->TryAcquireRead())
+			{
+				break;
+			}
+			else if (!m_ReadThrottle.TryAcquireRead(nextReadSize))
+			{
+				range.device->OnReadCancelled();
+				break;
+			}
+
+			const auto buffer = (currentBuffer + readsInFlight + 1) % bufferCount;
+			readBuffers.issueTimes[buffer] = DeviceReadQueue::GetTimestamp();
+
+			if (!InitiateFileRead(range.fileHandle, nextReadOffset, nextReadOffset + nextReadSize, chunkSize, range.readAlignment, readBuffers.buffers[buffer], readBuffers.overlapped[buffer], readBuffers.readEvents[buffer], &readBuffers.servedFromCache[buffer]))
+			{
+				range.device->OnReadCancelled();
+				return false;
+			}
+
+			nextReadOffset = skipHole(nextReadOffset + nextReadSize);
+			readsInFlight++;
+		}
+
+		return true;
+	};
+
+	// The buffers get reused for the next file, so nothing can be left landing in them
+	auto cancelReads = [&]()
+	{
+		if (readsInFlight == 0)
+			return;
+
+		CancelIoEx(range.fileHandle, nullptr);
+
+		for (uint32_t i = 1; i <= readsInFlight; i++)
+		{
+			auto waitResult = WaitForSingleObject(readBuffers.readEvents[(currentBuffer + i) % bufferCount], INFINITE);
+			Assert(waitResult == WAIT_OBJECT_0);
+			range.device->OnReadCancelled();
+		}
+
+		readsInFlight = 0;
+	};
+
+	for (;;)
+	{
+		auto chunk = readBuffers.buffers[currentBuffer] - seamLength;
+		const uint32_t chunkLength = seamLength + bytesRead;
+		const bool readWasShort = bytesRead < readSize; // The file shrank since it was enumerated
+		readOffset += bytesRead;
+
+		const uint64_t holeEnd = readWasShort ? readOffset : skipHole(readOffset);
+		const uint64_t holeLength = holeEnd - readOffset;
+		const bool isLastChunk = holeEnd == range.readEnd || readWasShort;
+		const auto nextSeamLength = isLastChunk && holeLength == 0 ? 0 : static_cast<uint32_t>(std::min<size_t>(m_MaxSearchStringLength, chunkLength));
+		const auto nextBuffer = (currentBuffer + 1) % bufferCount;
+
+		if (!isLastChunk && !issueReads())
+		{
+			cancelReads();
+			m_SearchResultReporter.AddToScannedFileSize(range.rangeEnd - scannedOffset);
+			return RangeSearchResult::kSearchedPart;
+		}
+
+		// Reads only fill the buffers themselves, so the area in front of the next one is free. Copy before the search gets to lower case anything
+		memcpy(holeLength != 0 ? readBuffers.holeArea : readBuffers.buffers[nextBuffer] - nextSeamLength, chunk + chunkLength - nextSeamLength, nextSeamLength);
+
+		bool found = SearchChunk(chunk, chunkLength, chunkOffset, chunkLength - nextSeamLength, stackAllocator, searchState);
+		auto nextChunkSeamLength = nextSeamLength;
+
+		if (holeLength != 0)
+		{
+			const auto holeAreaLength = nextSeamLength + static_cast<uint32_t>(std::min<uint64_t>(m_MaxSearchStringLength, holeLength));
+			nextChunkSeamLength = isLastChunk ? 0 : std::min<uint32_t>(static_cast<uint32_t>(m_MaxSearchStringLength), holeAreaLength);
+
+			memset(readBuffers.holeArea + nextSeamLength, 0, holeAreaLength - nextSeamLength);
+			memcpy(readBuffers.buffers[nextBuffer] - nextChunkSeamLength, readBuffers.holeArea + holeAreaLength - nextChunkSeamLength, nextChunkSeamLength);
+
+			if (!found)
+				found = SearchChunk(readBuffers.holeArea, holeAreaLength, readOffset - nextSeamLength, holeAreaLength - nextChunkSeamLength, stackAllocator, searchState);
+		}
+
+		const bool isFileDecided = range.isFileDecided != nullptr && *range.isFileDecided;
+		const auto scannedEnd = std::min(holeEnd, range.rangeEnd);
+
+		const bool isStopping = !isLastChunk && (isFileDecided || ShouldStopSearching());
+
+		// A short last chunk can leave reads of chunks past the end of the file in flight
+		if (found || isStopping || isLastChunk)
+			cancelReads();
+
+		if (found || isStopping)
+		{
+			// Once the file is decided, the rest of the range counts as scanned
+			if (found || isFileDecided)
+			{
+				m_SearchResultReporter.AddToScannedFileSize(range.rangeEnd - scannedOffset);
+				return found ? RangeSearchResult::kFound : RangeSearchResult::kStopped;
+			}
+
+			m_SearchResultReporter.AddToScannedFileSize(scannedEnd - scannedOffset);
+			return RangeSearchResult::kStopped;
+		}
+
+		m_SearchResultReporter.AddToScannedFileSize(scannedEnd - scannedOffset);
+		scannedOffset = scannedEnd;
+
+		if (isLastChunk)
+			return readWasShort ? RangeSearchResult::kSearchedPart : RangeSearchResult::kSearchedAll;
+
+		WaitForRead(range.fileHandle, readBuffers.overlapped[nextBuffer], readBuffers.readEvents[nextBuffer], m_CancelEvent);
+
+		readOffset = holeEnd;
+		readSize = getChunkReadSize(readOffset);
+		bytesRead = GetBytesRead(readBuffers.overlapped[nextBuffer], readOffset, readOffset + readSize, chunkSize);
+		range.device->OnReadCompleted(bytesRead, readBuffers.issueTimes[nextBuffer]);
+		m_SearchResultReporter.OnFileBytesRead(bytesRead, readBuffers.servedFromCache[nextBuffer] && range.readAlignment == 1);
+		chunkOffset = readOffset - nextChunkSeamLength;
+		seamLength = nextChunkSeamLength;
+		currentBuffer = nextBuffer;
+		readsInFlight--;
+	}
+}
+
+void OverlappedIOReader::SearchSplitFileRange(SplitFileSearch& splitFile, uint32_t rangeIndex, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	auto result = RangeSearchResult::kStopped;
+	searchState.Reset();
+
+	if (splitFile.isDecided)
+	{
+		const auto range = GetSplitFileRange(splitFile, rangeIndex, nullptr, 1, m_MaxSearchStringLength);
+		m_SearchResultReporter.AddToScannedFileSize(range.rangeEnd - range.rangeBegin);
+	}
+	else if (!ShouldStopSearching())
+	{
+		uint32_t readAlignment;
+		FileHandleHolder fileHandle = OpenFileForReading(splitFile.filePath, splitFile.isReadUnbuffered, readAlignment);
+		const auto range = GetSplitFileRange(splitFile, rangeIndex, fileHandle, readAlignment, m_MaxSearchStringLength);
+
+		uint32_t bytesRead;
+		if (fileHandle != INVALID_HANDLE_VALUE && ReadFirstChunk(fileHandle, readAlignment, splitFile.device, range.rangeBegin, range.readEnd, readBuffers, bytesRead))
+		{
+			result = SearchFileRange(range, readBuffers, bytesRead, stackAllocator, searchState);
+		}
+		else
+		{
+			m_SearchResultReporter.AddToScannedFileSize(range.rangeEnd - range.rangeBegin);
+			result = RangeSearchResult::kSearchedPart;
+		}
+	}
+
+	FinishSplitFileRange(splitFile, result, searchState);
+}
+
+// Nothing in a range can be searched before its first chunk is in, so this thread has nothing else in flight, and the read waits for its turn
+// in the read budget and room on the device
+bool OverlappedIOReader::ReadFirstChunk(HANDLE fileHandle, uint32_t readAlignment, DeviceReadQueue& device, uint64_t rangeBegin, uint64_t readEnd, ReadBufferRing& readBuffers, uint32_t& bytesRead)
+{
+	m_ReadThrottle.AcquireRead(GetReadSize(rangeBegin, readEnd, readBuffers.chunkSize));
+	device.AcquireRead();
+	readBuffers.issueTimes[0] = DeviceReadQueue::GetTimestamp();
+
+	if (!InitiateFileRead(fileHandle, rangeBegin, readEnd, readBuffers.chunkSize, readAlignment, readBuffers.buffers[0], readBuffers.overlapped[0], readBuffers.readEvents[0], &readBuffers.servedFromCache[0]))
+	{
+		device.OnReadCancelled();
+		return false;
+	}
+
+	WaitForRead(fileHandle, readBuffers.overlapped[0], readBuffers.readEvents[0], m_CancelEvent);
+
+	bytesRead = GetBytesRead(readBuffers.overlapped[0], rangeBegin, readEnd, readBuffers.chunkSize);
+	device.OnReadCompleted(bytesRead, readBuffers.issueTimes[0]);
+	m_SearchResultReporter.OnFileBytesRead(bytesRead, readBuffers.servedFromCache[0] && readAlignment == 1);
+	return true;
+}
+
+void OverlappedIOReader::FinishSplitFileRange(SplitFileSearch& splitFile, RangeSearchResult result, FileContentSearchState& searchState)
+{
+	if (result == RangeSearchResult::kFound)
+	{
+		// Only the first match reports the file, and the other ranges stop at the end of their current chunk
+		if (!splitFile.isDecided.exchange(true) && !m_SearchInstructions.InvertContentMatch())
+			m_SearchResultReporter.DispatchSearchResult(splitFile.fileFindData, splitFile.filePath.c_str());
+	}
+	else if (result != RangeSearchResult::kSearchedAll)
+	{
+		splitFile.isIncomplete = true;
+	}
+
+	if (!searchState.dictionaryMatches.empty())
+	{
+		ReaderWriterLock::WriterLock lock(splitFile.dictionaryMatchesLock);
+		splitFile.dictionaryMatches.insert(splitFile.dictionaryMatches.end(), searchState.dictionaryMatches.begin(), searchState.dictionaryMatches.end());
+		searchState.dictionaryMatches.clear();
+	}
+
+	if (--splitFile.pendingRanges != 0)
+		return;
+
+	m_SearchResultReporter.AddToScannedFileCount();
+
+	if (splitFile.isDecided || ShouldStopSearching())
+		return;
+
+	if (m_SearchInstructions.InvertContentMatch())
+	{
+		if (!splitFile.isIncomplete)
+			m_SearchResultReporter.DispatchSearchResult(splitFile.fileFindData, std::move(splitFile.filePath));
+	}
+	else if (!splitFile.dictionaryMatches.empty())
+	{
+		m_SearchResultReporter.DispatchDictionarySearchResult(splitFile.fileFindData, std::move(splitFile.filePath), std::move(splitFile.dictionaryMatches));
+	}
+}
+
+// Opening a small file and waiting for its one read takes longer than searching it. Opening can't be overlapped, but reading can, so the batch
+// gets opened and read before any of it is searched, and the reads keep each other company in the device queue rather than taking turns.
+// Reads go out in waves: the first of a wave waits for its turn in the read budget and room on its device, and the rest only go out while
+// there are both
+void OverlappedIOReader::SearchSmallFiles(std::span<const FileOpenData* const> files, uint8_t* fileReadBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState, CachePolicy& cachePolicy)
+{
+	enum class SmallFileState
+	{
+		kNotOpened,
+		kSkipped,
+		kUnreadable,
+		kOpened, // Left for the next wave when its device had no room, or its turn hadn't come up
+		kReading,
+	};
+
+	Assert(files.size() <= kSmallFileBatchSize);
+
+	SmallFileState fileStates[kSmallFileBatchSize] = {};
+	FileHandleHolder fileHandles[kSmallFileBatchSize];
+	uint32_t readAlignments[kSmallFileBatchSize];
+	DeviceReadQueue* devices[kSmallFileBatchSize];
+	int64_t issueTimes[kSmallFileBatchSize];
+	bool servedFromCache[kSmallFileBatchSize];
+	OVERLAPPED overlapped[kSmallFileBatchSize];
+
+	for (size_t waveBegin = 0; waveBegin < files.size();)
+	{
+		size_t waveEnd = waveBegin;
+		uint32_t readsInFlight = 0;
+
+		for (; waveEnd < files.size(); waveEnd++)
+		{
+			const auto i = waveEnd;
+			const auto& searchData = *files[i];
+
+			if (fileStates[i] == SmallFileState::kNotOpened)
+			{
+				if (ShouldStopSearching())
+				{
+					fileStates[i] = SmallFileState::kSkipped;
+					continue;
+				}
+
+				// The size comes from enumeration, so there's nothing to ask the file system before reading all of it. Cache neutral searches
+				// read small files around the cache without asking whether it has them, since that would cost as much as reading them
+				fileHandles[i] = OpenFileForReading(searchData.filePath, m_SearchInstructions.UseUnbufferedIO() || m_SearchInstructions.CacheNeutralReads(), readAlignments[i]);
+				if (fileHandles[i] == INVALID_HANDLE_VALUE)
+				{
+					fileStates[i] = SmallFileState::kUnreadable;
+					continue;
+				}
+
+				devices[i] = &m_DeviceReadLimiter.GetDevice(fileHandles[i], searchData.filePath);
+				fileStates[i] = SmallFileState::kOpened;
+			}
+
+			const auto readSize = static_cast<uint32_t>(searchData.fileSize);
+
+			if (readsInFlight == 0)
+			{
+				m_ReadThrottle.AcquireRead(readSize);
+				devices[i]->AcquireRead();
+			}
+			else if (!devices[i]->TryAcquireRead())
+			{
+				break;
+			}
+			else if (!m_ReadThrottle.TryAcquireRead(readSize))
+			{
+				devices[i]->OnReadCancelled();
+				break;
+			}
+
+			issueTimes[i] = DeviceReadQueue::GetTimestamp();
+
+			// Without an event, the handle itself gets signaled when its only read completes
+			if (InitiateFileRead(fileHandles[i], 0, searchData.fileSize, kMaxSmallFileSize, readAlignments[i], fileReadBuffers + i * kMaxSmallFileSize, overlapped[i], nullptr, &servedFromCache[i]))
+			{
+				fileStates[i] = SmallFileState::kReading;
+				cachePolicy.OnFileRead(servedFromCache[i]);
+				readsInFlight++;
+			}
+			else
+			{
+				devices[i]->OnReadCancelled();
+				fileStates[i] = SmallFileState::kUnreadable;
+				fileHandles[i] = INVALID_HANDLE_VALUE;
+			}
+		}
+
+		for (size_t i = waveBegin; i < waveEnd; i++)
+		{
+			const auto& searchData = *files[i];
+
+			if (fileStates[i] == SmallFileState::kSkipped)
+				continue;
+
+			if (fileStates[i] == SmallFileState::kUnreadable)
+			{
+				m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize);
+				m_SearchResultReporter.AddToScannedFileCount();
+				continue;
+			}
+
+			DWORD bytesTransferred;
+			WaitForRead(fileHandles[i], overlapped[i], fileHandles[i], m_CancelEvent);
+
+			if (GetOverlappedResult(fileHandles[i], &overlapped[i], &bytesTransferred, FALSE))
+			{
+				devices[i]->OnReadCompleted(bytesTransferred, issueTimes[i]);
+				m_SearchResultReporter.OnFileBytesRead(std::min<uint64_t>(bytesTransferred, searchData.fileSize), servedFromCache[i] && readAlignments[i] == 1);
+			}
+			else
+			{
+				devices[i]->OnReadCancelled();
+				bytesTransferred = 0;
+			}
+
+			fileHandles[i] = INVALID_HANDLE_VALUE;
+
+			// Every read has to be waited for regardless, since they all land in our buffers
+			if (ShouldStopSearching())
+				continue;
+
+			const auto bytesRead = static_cast<uint32_t>(std::min<uint64_t>(bytesTransferred, searchData.fileSize));
+			if (SearchWholeFile(searchData, fileReadBuffers + i * kMaxSmallFileSize, bytesRead, stackAllocator, searchState))
+				m_SearchResultReporter.AddToScannedFileCount();
+		}
+
+		waveBegin = waveEnd;
+	}
+}
+
+bool OverlappedIOReader::SearchWholeFile(const FileOpenData& searchData, uint8_t* fileContents, uint32_t bytesRead, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	searchState.Reset();
+
+	if (m_SearchInstructions.SearchCompressedFiles() && GzipDecoder::IsGzip(fileContents, bytesRead))
+	{
+		CompressedFileInput input(m_ReadThrottle, m_SearchResultReporter, std::span<const uint8_t>(fileContents, bytesRead));
+		return SearchCompressedFile(searchData, input, stackAllocator, searchState);
+	}
+
+	if (m_SearchInstructions.SkipBinaryFiles() && BinaryFileDetection::IsBinary(fileContents, bytesRead))
+	{
+		m_SearchResultReporter.OnBinaryFileSkipped(searchData.fileSize);
+		return false;
+	}
+
+	const bool found = SearchChunk(fileContents, bytesRead, 0, bytesRead, stackAllocator, searchState);
+	m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize);
+
+	if (found)
+	{
+		if (!m_SearchInstructions.InvertContentMatch())
+			m_SearchResultReporter.DispatchSearchResult(searchData.fileFindData, searchData.filePath.c_str());
+	}
+	else if (m_SearchInstructions.InvertContentMatch())
+	{
+		// Only a file we've seen all of can be reported as not containing the search string
+		if (bytesRead == searchData.fileSize)
+			m_SearchResultReporter.DispatchSearchResult(searchData.fileFindData, searchData.filePath.c_str());
+	}
+	else if (!searchState.dictionaryMatches.empty())
+	{
+		m_SearchResultReporter.DispatchDictionarySearchResult(searchData.fileFindData, std::wstring(searchData.filePath), std::move(searchState.dictionaryMatches));
+		searchState.dictionaryMatches.clear();
+	}
+
+	return true;
+}
+
+bool OverlappedIOReader::SearchCompressedFile(const FileOpenData& searchData, CompressedFileInput& input, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	GzipDecoder decoder(GzipDecoder::Format::kGzip, &CompressedFileInput::ReadInput, &input, m_MaxSearchStringLength);
+	auto result = SearchCompressedData(decoder, input, searchData.fileSize, stackAllocator, searchState);
+
+	if (result == RangeSearchResult::kSkippedAsBinary)
+	{
+		m_SearchResultReporter.OnBinaryFileSkipped(searchData.fileSize);
+		return false;
+	}
+
+	ReportFileResult(searchData.fileFindData, searchData.filePath, result, searchState);
+	return true;
+}
+
+// Compressed data is searched for what it decompresses to, a block at a time. The decoder keeps the end of the previous block in front of
+// each one, which is where the seam comes from. Blocks get copied out before they're searched, since the search can lower case them in place
+// and the decoder still needs them for back references. What counts as scanned is the compressed bytes handed to the decoder so far, and
+// all compressedSize of them once the search is over, unless it turned out to be binary
+OverlappedIOReader::RangeSearchResult OverlappedIOReader::SearchCompressedData(GzipDecoder& decoder, CompressedFileInput& input, uint64_t compressedSize, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	auto searchBuffer = stackAllocator.Allocate(m_SeamAreaSize + GzipDecoder::kOutputBlockSize);
+	const auto blockBuffer = static_cast<uint8_t*>(searchBuffer) + m_SeamAreaSize;
+
+	std::span<const uint8_t> output;
+	auto status = decoder.Decode(output);
+	uint64_t decompressedSize = 0;
+	uint64_t scannedSize = 0;
+	bool found = false;
+	bool isStopped = false;
+
+	while (status == GzipDecoder::Status::kHasOutput)
+	{
+		const auto seamLength = static_cast<uint32_t>(std::min<uint64_t>(m_MaxSearchStringLength, decompressedSize));
+		const auto chunk = blockBuffer - seamLength;
+		const auto chunkLength = seamLength + static_cast<uint32_t>(output.size());
+		memcpy(chunk, output.data() - seamLength, chunkLength);
+
+		if (decompressedSize == 0 && m_SearchInstructions.SkipBinaryFiles() && BinaryFileDetection::IsBinary(blockBuffer, output.size()))
+			return RangeSearchResult::kSkippedAsBinary;
+
+		const auto chunkOffset = decompressedSize - seamLength;
+		decompressedSize += output.size();
+
+		// Only the next block tells us whether this one is the last
+		status = decoder.Decode(output);
+		const bool isLastChunk = status != GzipDecoder::Status::kHasOutput;
+		const auto nextSeamLength = isLastChunk ? 0 : static_cast<uint32_t>(std::min<uint64_t>(m_MaxSearchStringLength, decompressedSize));
+
+		found = SearchChunk(chunk, chunkLength, chunkOffset, chunkLength - nextSeamLength, stackAllocator, searchState);
+
+		m_SearchResultReporter.AddToScannedFileSize(input.bytesHandedOver - scannedSize);
+		scannedSize = input.bytesHandedOver;
+
+		if (found)
+			break;
+
+		if (!isLastChunk && ShouldStopSearching())
+		{
+			isStopped = true;
+			break;
+		}
+	}
+
+	input.CancelRead();
+	m_SearchResultReporter.AddToScannedFileSize(compressedSize - scannedSize);
+	m_SearchResultReporter.OnCompressedFileSearched(input.bytesHandedOver, decompressedSize);
+
+	if (found)
+		return RangeSearchResult::kFound;
+
+	if (isStopped)
+		return RangeSearchResult::kStopped;
+
+	// Data that's cut short or corrupt wasn't seen all of
+	return status == GzipDecoder::Status::kFinished ? RangeSearchResult::kSearchedAll : RangeSearchResult::kSearchedPart;
+}
+
+// Archives are read through the cache, since their members start anywhere in the file, and unbuffered reads can't. The directory comes first,
+// and then the members get searched one after another, in the order their data is in the archive. A member is reported as the path of the
+// archive and its own path in it, separated by '!'
+bool OverlappedIOReader::SearchArchive(const FileOpenData& archiveData, bool isArchiveReported, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState, CachePolicy& cachePolicy)
+{
+	const bool searchContents = m_SearchInstructions.SearchInFileContents();
+
+	uint32_t readAlignment;
+	FileHandleHolder fileHandle = OpenFileForReading(archiveData.filePath, false, readAlignment);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		if (searchContents)
+			m_SearchResultReporter.AddToScannedFileSize(archiveData.fileSize);
+
+		return searchContents;
+	}
+
+	auto& device = m_DeviceReadLimiter.GetDevice(fileHandle, archiveData.filePath);
+	ArchiveReadContext readContext = { fileHandle, m_CancelEvent, device, m_ReadThrottle, m_SearchResultReporter };
+	ArchiveDirectory::ArchiveFormat format;
+	std::vector<ArchiveDirectory::Member> members;
+
+	if (!ArchiveDirectory::GetArchiveFormat(archiveData.filePath, format) || !ArchiveDirectory::ListMembers(format, &ArchiveReadContext::ReadAt, &readContext, archiveData.fileSize, members))
+	{
+		// Just a file with an archive's extension, so its contents get searched like any other file's, unless its name matched already
+		if (!searchContents)
+			return false;
+
+		// A cancelled search cuts the directory read short too
+		if (isArchiveReported || ShouldStopSearching())
+		{
+			m_SearchResultReporter.AddToScannedFileSize(archiveData.fileSize);
+			return true;
+		}
+
+		return SearchFileContents(archiveData, readBuffers, stackAllocator, searchState, cachePolicy);
+	}
+
+	// Whatever isn't member data, the headers and the directory, counts as scanned up front
+	if (searchContents)
+	{
+		uint64_t memberDataSize = 0;
+		for (const auto& member : members)
+			memberDataSize += member.compressedSize;
+
+		m_SearchResultReporter.AddToScannedFileSize(archiveData.fileSize - std::min(memberDataSize, archiveData.fileSize));
+	}
+
+	for (auto& member : members)
+	{
+		if (ShouldStopSearching())
+			break;
+
+		auto memberPath = archiveData.filePath + L'!' + member.path;
+		FileFindData memberFindData = archiveData.fileFindData;
+		memberFindData.ftLastWriteTime = member.lastWriteTime;
+		memberFindData.nFileSizeHigh = static_cast<DWORD>(member.size >> 32);
+		memberFindData.nFileSizeLow = static_cast<DWORD>(member.size);
+
+		// Same as a file: one that's too big is left out, and one whose name matches doesn't need its contents searched
+		bool isMemberDecided = member.size > m_SearchInstructions.ignoreFilesLargerThan;
+		if (!isMemberDecided && SearchArchiveMemberName(memberPath, stackAllocator))
+		{
+			m_SearchResultReporter.DispatchSearchResult(memberFindData, std::move(memberPath));
+			isMemberDecided = true;
+		}
+
+		if (!searchContents)
+			continue;
+
+		if (isMemberDecided || (format == ArchiveDirectory::ArchiveFormat::kZip && !ArchiveDirectory::GetZipMemberDataOffset(&ArchiveReadContext::ReadAt, &readContext, member)))
+		{
+			m_SearchResultReporter.AddToScannedFileSize(member.compressedSize);
+			continue;
+		}
+
+		if (member.size == 0)
+		{
+			// There's nothing in an empty member, so it doesn't contain the search string either
+			if (m_SearchInstructions.InvertContentMatch())
+				m_SearchResultReporter.DispatchSearchResult(memberFindData, std::move(memberPath));
+
+			m_SearchResultReporter.AddToScannedFileSize(member.compressedSize);
+			continue;
+		}
+
+		searchState.Reset();
+		auto result = SearchArchiveMemberContents(member, fileHandle, device, readBuffers, stackAllocator, searchState);
+
+		if (result == RangeSearchResult::kSkippedAsBinary)
+		{
+			m_SearchResultReporter.OnBinaryFileSkipped(member.compressedSize);
+		}
+		else
+		{
+			ReportFileResult(memberFindData, memberPath, result, searchState);
+		}
+	}
+
+	return searchContents;
+}
+
+// Members are matched the way files are, where the name is the last part of the member's path, and the path starts with the archive's
+bool OverlappedIOReader::SearchArchiveMemberName(const std::wstring& memberPath, ScopedStackAllocator& stackAllocator) const
+{
+	if (m_SearchInstructions.SearchInFilePath())
+		return m_StringSearcher.SearchForString(memberPath, stackAllocator);
+
+	if (m_SearchInstructions.SearchInFileName())
+		return m_StringSearcher.SearchForString(std::wstring_view(memberPath).substr(memberPath.find_last_of(L"\\!") + 1), stackAllocator);
+
+	return false;
+}
+
+// Only the member's own data gets read. Stored members are searched like a range of the archive, and deflated ones through the decoder
+OverlappedIOReader::RangeSearchResult OverlappedIOReader::SearchArchiveMemberContents(const ArchiveDirectory::Member& member, HANDLE archiveHandle, DeviceReadQueue& device, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	const uint64_t dataEnd = member.dataOffset + member.compressedSize;
+	uint32_t bytesRead;
+
+	if (member.compressionMethod == ArchiveDirectory::CompressionMethod::kUnsupported || member.compressedSize == 0 || !ReadFirstChunk(archiveHandle, 1, device, member.dataOffset, dataEnd, readBuffers, bytesRead))
+	{
+		m_SearchResultReporter.AddToScannedFileSize(member.compressedSize);
+		return RangeSearchResult::kSearchedPart;
+	}
+
+	if (member.compressionMethod == ArchiveDirectory::CompressionMethod::kDeflated)
+	{
+		CompressedFileInput input(m_ReadThrottle, m_SearchResultReporter, archiveHandle, m_CancelEvent, device, readBuffers, 1, member.dataOffset, dataEnd, bytesRead);
+		GzipDecoder decoder(GzipDecoder::Format::kDeflate, &CompressedFileInput::ReadInput, &input, m_MaxSearchStringLength);
+		return SearchCompressedData(decoder, input, member.compressedSize, stackAllocator, searchState);
+	}
+
+	if (m_SearchInstructions.SkipBinaryFiles() && BinaryFileDetection::IsBinary(readBuffers.buffers[0], bytesRead))
+		return RangeSearchResult::kSkippedAsBinary;
+
+	const FileRange memberRange = { archiveHandle, 1, member.dataOffset, dataEnd, dataEnd, nullptr, &device, {} };
+	return SearchFileRange(memberRange, readBuffers, bytesRead, stackAllocator, searchState);
+}
+
+// Reading a page of a view can fail, say when the file lives on a network share that goes away, and that raises EXCEPTION_IN_PAGE_ERROR
+// instead of returning an error. The searchers have objects to unwind, which an SEH exception would skip, so the pages are faulted in here,
+// where there's nothing to unwind, and only searched once they're all in. The chunk is searched right after, so it's still in the working set
+static bool TryFaultInMappedBytes(const uint8_t* bytes, size_t length)
+{
+	__try
+	{
+		for (size_t offset = 0; offset < length; offset += kUnbufferedReadAlignment)
+			static_cast<void>(*static_cast<const volatile uint8_t*>(bytes + offset));
+
+		static_cast<void>(*static_cast<const volatile uint8_t*>(bytes + length - 1));
+		return true;
+	}
+	__except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		return false;
+	}
+}
+
+OverlappedIOReader::MappedFileSearchResult OverlappedIOReader::SearchMappedFileContents(const FileOpenData& searchData, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState)
+{
+	searchState.Reset();
+
+	FileHandleHolder fileHandle = CreateFileW(searchData.filePath.c_str(), GENERIC_READ, kFileSharingFlags, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return MappedFileSearchResult::kNotMapped;
+
+	// Like reads, the search goes no further than the file was when it was enumerated, and scanned bytes are counted against that size,
+	// so they add up to the total
+	LARGE_INTEGER currentSize;
+	if (!GetFileSizeEx(fileHandle, &currentSize) || currentSize.QuadPart == 0)
+		return MappedFileSearchResult::kNotMapped;
+
+	// The mapping and the view get an explicit size, since a file mapped at whatever size it has can shrink and grow back before
+	// that size is looked up. The file can't shrink below the size of a mapping while the mapping exists, and if it did before
+	// the mapping was created, creating it fails rather than extend a read only file
+	const auto fileSize = std::min<uint64_t>(currentSize.QuadPart, searchData.fileSize);
+	const bool isFileCutShort = fileSize < searchData.fileSize; // It shrank since it was enumerated
+
+	HandleHolder<nullptr> fileMapping = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, static_cast<DWORD>(fileSize >> 32), static_cast<DWORD>(fileSize), nullptr);
+	if (!fileMapping)
+		return MappedFileSearchResult::kNotMapped;
+
+	std::unique_ptr<uint8_t, MappedViewDeleter> view(static_cast<uint8_t*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(fileSize))));
+	if (view == nullptr)
+		return MappedFileSearchResult::kNotMapped;
+
+	// The view is searched in chunks, since the searchers expect bounded buffers. Chunks overlap by the
+	// longest match, but that's just pointer arithmetic now rather than bytes read twice
+	uint64_t chunkOffset = 0;
+	bool found = false;
+	bool searchedWholeFile = false;
+
+	while (!found && !searchedWholeFile)
+	{
+		if (chunkOffset != 0 && ShouldStopSearching())
+		{
+			m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize - chunkOffset);
+			return MappedFileSearchResult::kScanned;
+		}
+
+		const auto chunk = view.get() + chunkOffset;
+		const auto chunkLength = static_cast<uint32_t>(std::min<uint64_t>(fileSize - chunkOffset, kMappedViewChunkSize));
+		searchedWholeFile = chunkOffset + chunkLength == fileSize;
+
+		const auto nextChunkOffset = searchedWholeFile ? fileSize : chunkOffset + chunkLength - m_MaxSearchStringLength;
+		const auto searchedLength = static_cast<uint32_t>(nextChunkOffset - chunkOffset);
+
+		// Faults the whole chunk in at once rather than a page at a time
+		WIN32_MEMORY_RANGE_ENTRY chunkRange = { chunk, chunkLength };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &chunkRange, 0);
+
+		if (!TryFaultInMappedBytes(chunk, chunkLength))
+		{
+			m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize - chunkOffset);
+			return MappedFileSearchResult::kScanned;
+		}
+
+		// Decompressing goes through reads, which overlap with it
+		if (chunkOffset == 0 && m_SearchInstructions.SearchCompressedFiles() && GzipDecoder::IsGzip(chunk, chunkLength))
+			return MappedFileSearchResult::kNotMapped;
+
+		if (chunkOffset == 0 && m_SearchInstructions.SkipBinaryFiles() && BinaryFileDetection::IsBinary(chunk, chunkLength))
+		{
+			m_SearchResultReporter.OnBinaryFileSkipped(searchData.fileSize);
+			return MappedFileSearchResult::kSkippedAsBinary;
+		}
+
+		found = SearchChunk(chunk, chunkLength, chunkOffset, searchedLength, stackAllocator, searchState);
+
+		// A match decides the file either way, so the rest of it counts as scanned
+		m_SearchResultReporter.AddToScannedFileSize((found ? searchData.fileSize : nextChunkOffset) - chunkOffset);
+		chunkOffset = nextChunkOffset;
+	}
+
+	if (!found && isFileCutShort)
+		m_SearchResultReporter.AddToScannedFileSize(searchData.fileSize - fileSize);
+
+	if (m_SearchInstructions.InvertContentMatch())
+	{
+		// Only a file we've seen all of can be reported as not containing the search string
+		if (!found && !isFileCutShort)
+			m_SearchResultReporter.DispatchSearchResult(searchData.fileFindData, searchData.filePath.c_str());
+	}
+	else if (found)
+	{
+		m_SearchResultReporter.DispatchSearchResult(searchData.fileFindData, searchData.filePath.c_str());
+	}
+	else if (!searchState.dictionaryMatches.empty())
+	{
+		m_SearchResultReporter.DispatchDictionarySearchResult(searchData.fileFindData, std::wstring(searchData.filePath), std::move(searchState.dictionaryMatches));
+		searchState.dictionaryMatches.clear();
+	}
+
+	return MappedFileSearchResult::kScanned;
+}
\ No newline at end of file
@@ -1,41 +1,136 @@
 #pragma once
 
+#include "Event.h"
 #include "FileContentSearchData.h"
+#include "FileReadBackends/DeviceReadLimiter.h"
+#include "FileReadBackends/ReadChunkPolicy.h"
+#include "FileReadBackends/ReadThrottle.h"
 #include "Utilities/WorkQueue.h"
 
 struct SearchInstructions;
 class SearchResultReporter;
 class ScopedStackAllocator;
 class StringSearcher;
+struct FileContentSearchState;
+struct CachePolicy;
+struct ReadBufferRing;
+struct FileRange;
+struct SplitFileSearch;
+struct CompressedFileInput;
+class GzipDecoder;
 
-class OverlappedIOReader : ThreadedWorkQueue<OverlappedIOReader, FileOpenData>
+namespace ArchiveDirectory
+{
+    struct Member;
+}
+
+// Either a whole file, one range of a file big enough to be searched by several threads at once, or an archive whose members get searched
+struct OverlappedIOWorkItem
+{
+    FileOpenData fileOpenData;
+    std::shared_ptr<SplitFileSearch> splitFile;
+    uint32_t rangeIndex;
+    bool isArchive;
+    bool isArchiveReported; // Its name matched, so it's been reported already
+
+    OverlappedIOWorkItem(FileOpenData&& fileOpenData) :
+        fileOpenData(std::move(fileOpenData)),
+        rangeIndex(0),
+        isArchive(false),
+        isArchiveReported(false)
+    {
+    }
+
+    OverlappedIOWorkItem(FileOpenData&& fileOpenData, bool isArchiveReported) :
+        fileOpenData(std::move(fileOpenData)),
+        rangeIndex(0),
+        isArchive(true),
+        isArchiveReported(isArchiveReported)
+    {
+    }
+
+    OverlappedIOWorkItem(const std::shared_ptr<SplitFileSearch>& splitFile, uint32_t rangeIndex) :
+        splitFile(splitFile),
+        rangeIndex(rangeIndex),
+        isArchive(false),
+        isArchiveReported(false)
+    {
+    }
+};
+
+class OverlappedIOReader : ThreadedWorkQueue<OverlappedIOReader, OverlappedIOWorkItem>
 {
 public:
-    OverlappedIOReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter);
+    OverlappedIOReader(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter, ReadThrottle& readThrottle);
 
     void Initialize();
     void DrainWorkQueue();
+    void CompleteAllWork();
 
-    inline void CompleteAllWork()
+    inline void ScanFile(FileOpenData fileOpenData)
     {
-        MyBase::CompleteAllWork();
+        m_PendingWorkItemCount++;
+        PushWorkItem(std::move(fileOpenData));
     }
 
-    inline void ScanFile(FileOpenData fileOpenData)
+    // Searches the names of the archive's members, and their contents if the search is for file contents
+    inline void ScanArchive(FileOpenData fileOpenData, bool isArchiveReported)
     {
-        PushWorkItem(std::move(fileOpenData));
+        m_PendingWorkItemCount++;
+        PushWorkItem(std::move(fileOpenData), isArchiveReported);
     }
 
 private:
-    typedef ThreadedWorkQueue<OverlappedIOReader, FileOpenData> MyBase;
+    typedef ThreadedWorkQueue<OverlappedIOReader, OverlappedIOWorkItem> MyBase;
+
+    enum class MappedFileSearchResult
+    {
+        kNotMapped, // Nothing was reported, so the file can still be read instead
+        kScanned,
+        kSkippedAsBinary,
+    };
+
+    enum class RangeSearchResult
+    {
+        kFound,
+        kSearchedAll,
+        kSearchedPart, // A read failed, or the file shrank since it was enumerated
+        kStopped,
+        kSkippedAsBinary, // Compressed data that turned out to decompress to binary
+    };
 
 private:
     void ContentsSearchThread();
-    void SearchFileContents(const FileOpenData& searchData, uint8_t* primaryBuffer, uint8_t* secondaryBuffer, ScopedStackAllocator& stackAllocator, HANDLE overlappedEvent);
+    bool SearchFileContents(const FileOpenData& searchData, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState, CachePolicy& cachePolicy);
+    RangeSearchResult SearchFileRange(const FileRange& range, ReadBufferRing& readBuffers, uint32_t bytesRead, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    void SearchSplitFileRange(SplitFileSearch& splitFile, uint32_t rangeIndex, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    void FinishSplitFileRange(SplitFileSearch& splitFile, RangeSearchResult result, FileContentSearchState& searchState);
+    void SearchSmallFiles(std::span<const FileOpenData* const> files, uint8_t* fileReadBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState, CachePolicy& cachePolicy);
+    bool SearchWholeFile(const FileOpenData& searchData, uint8_t* fileContents, uint32_t bytesRead, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    bool SearchCompressedFile(const FileOpenData& searchData, CompressedFileInput& input, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    RangeSearchResult SearchCompressedData(GzipDecoder& decoder, CompressedFileInput& input, uint64_t compressedSize, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    bool SearchArchive(const FileOpenData& archiveData, bool isArchiveReported, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState, CachePolicy& cachePolicy);
+    bool SearchArchiveMemberName(const std::wstring& memberPath, ScopedStackAllocator& stackAllocator) const;
+    RangeSearchResult SearchArchiveMemberContents(const ArchiveDirectory::Member& member, HANDLE archiveHandle, DeviceReadQueue& device, ReadBufferRing& readBuffers, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    void ReportFileResult(const FileFindData& fileFindData, const std::wstring& filePath, RangeSearchResult result, FileContentSearchState& searchState);
+    MappedFileSearchResult SearchMappedFileContents(const FileOpenData& searchData, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState);
+    bool SearchChunk(uint8_t* buffer, uint32_t bufferLength, uint64_t chunkOffset, uint32_t searchedLength, ScopedStackAllocator& stackAllocator, FileContentSearchState& searchState) const;
+    bool ReadFirstChunk(HANDLE fileHandle, uint32_t readAlignment, DeviceReadQueue& device, uint64_t rangeBegin, uint64_t readEnd, ReadBufferRing& readBuffers, uint32_t& bytesRead);
+    FileHandleHolder OpenFileForChunkedReading(const std::wstring& filePath, uint64_t fileSize, CachePolicy& cachePolicy, uint32_t& readAlignment) const;
+    bool ShouldStopSearching() const;
 
 private:
     SearchResultReporter& m_SearchResultReporter;
     const StringSearcher& m_StringSearcher;
+    const SearchInstructions& m_SearchInstructions;
+    ReadThrottle& m_ReadThrottle;
     const size_t m_MaxSearchStringLength;
+    const size_t m_SeamAreaSize; // Room in front of every read buffer for the end of the previous chunk, rounded up to keep the buffers aligned
+    ReadChunkPolicy m_ReadChunkPolicy;
+    DeviceReadLimiter m_DeviceReadLimiter;
+    uint32_t m_ReadsInFlightPerFile;
     std::atomic<bool> m_IsFinished;
+    std::atomic<uint32_t> m_PendingWorkItemCount; // Queued or being worked on. Splitting a file queues more work from the worker threads
+    Event<EventType::AutoReset> m_WorkItemsDoneEvent;
+    Event<EventType::ManualReset> m_CancelEvent; // Cuts short the reads the threads are waiting for
 };
\ No newline at end of file
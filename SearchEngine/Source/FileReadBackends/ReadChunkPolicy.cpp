@@ -0,0 +1,142 @@
+#include "PrecompiledHeader.h"
+#include "HandleHolder.h"
+#include "ReadChunkPolicy.h"
+
+#include <winioctl.h>
+
+// Files at least this large are read in large chunks from devices that keep up with them
+constexpr uint64_t kLargeFileSize = 16 * 1024 * 1024;
+
+constexpr uint32_t kChunkSizeAlignment = 4096;
+constexpr uint32_t kMaxChunkSizeOverride = 64 * 1024 * 1024;
+constexpr uint32_t kMaxQueueDepthOverride = 1024;
+
+static std::atomic<uint32_t> s_ChunkSizeOverride;
+static std::atomic<uint32_t> s_QueueDepthOverride;
+
+StorageDeviceClass ReadChunkPolicy::QueryDeviceClass(const std::wstring& path)
+{
+	wchar_t volumePath[MAX_PATH];
+	wchar_t volumeName[MAX_PATH];
+	if (!GetVolumePathNameW(path.c_str(), volumePath, ARRAYSIZE(volumePath)) || !GetVolumeNameForVolumeMountPointW(volumePath, volumeName, ARRAYSIZE(volumeName)))
+		return StorageDeviceClass::kUnknown;
+
+	// The volume device itself is named without the trailing backslash, and asking about it needs no access rights
+	volumeName[wcslen(volumeName) - 1] = L'\0';
+
+	FileHandleHolder volume = CreateFileW(volumeName, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (volume == INVALID_HANDLE_VALUE)
+		return StorageDeviceClass::kUnknown;
+
+	STORAGE_PROPERTY_QUERY query = {};
+	query.PropertyId = StorageDeviceProperty;
+	query.QueryType = PropertyStandardQuery;
+
+	STORAGE_DEVICE_DESCRIPTOR deviceDescriptor = {};
+	DWORD bytesReturned;
+	if (DeviceIoControl(volume, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &deviceDescriptor, sizeof(deviceDescriptor), &bytesReturned, nullptr) &&
+		bytesReturned >= offsetof(STORAGE_DEVICE_DESCRIPTOR, BusType) + sizeof(deviceDescriptor.BusType) && deviceDescriptor.BusType == BusTypeNvme)
+	{
+		return StorageDeviceClass::kNvme;
+	}
+
+	query.PropertyId = StorageDeviceSeekPenaltyProperty;
+
+	DEVICE_SEEK_PENALTY_DESCRIPTOR seekPenaltyDescriptor = {};
+	if (!DeviceIoControl(volume, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &seekPenaltyDescriptor, sizeof(seekPenaltyDescriptor), &bytesReturned, nullptr) ||
+		bytesReturned < sizeof(seekPenaltyDescriptor))
+	{
+		return StorageDeviceClass::kUnknown;
+	}
+
+	return seekPenaltyDescriptor.IncursSeekPenalty ? StorageDeviceClass::kRotational : StorageDeviceClass::kSolidState;
+}
+
+ReadChunkPolicy::ReadChunkPolicy() :
+	m_DeviceClass(StorageDeviceClass::kUnknown),
+	m_ChunkSizeOverride(0),
+	m_QueueDepthOverride(0)
+{
+}
+
+void ReadChunkPolicy::Initialize(const std::wstring& searchPath)
+{
+	m_DeviceClass = QueryDeviceClass(searchPath);
+	m_ChunkSizeOverride = s_ChunkSizeOverride;
+	m_QueueDepthOverride = s_QueueDepthOverride;
+}
+
+uint32_t ReadChunkPolicy::GetChunkSize(uint64_t fileSize) const
+{
+	if (m_ChunkSizeOverride != 0)
+		return m_ChunkSizeOverride;
+
+	if (fileSize <= kSmallChunkSize)
+		return kSmallChunkSize;
+
+	switch (m_DeviceClass)
+	{
+	case StorageDeviceClass::kRotational:
+		// Any read past the first can cost a seek once other threads' reads get in between
+		return kLargeChunkSize;
+
+	case StorageDeviceClass::kSolidState:
+		// SATA tops out well before a handful of megabyte reads in flight do
+		return kMediumChunkSize;
+
+	default:
+		// NVMe drives only reach their bandwidth with large reads, and every read over a network share is a round trip
+		return fileSize >= kLargeFileSize ? kLargeChunkSize : kMediumChunkSize;
+	}
+}
+
+uint32_t ReadChunkPolicy::GetInitialQueueDepth(StorageDeviceClass deviceClass)
+{
+	switch (deviceClass)
+	{
+	case StorageDeviceClass::kRotational:
+		// Enough for the drive to reorder by, but every read past that is just another seek competing with the rest
+		return 4;
+
+	case StorageDeviceClass::kSolidState:
+		// AHCI has a single queue of 32 commands
+		return 32;
+
+	case StorageDeviceClass::kNvme:
+		return 64;
+
+	default:
+		return 16;
+	}
+}
+
+uint32_t ReadChunkPolicy::GetMaxQueueDepth(StorageDeviceClass deviceClass)
+{
+	switch (deviceClass)
+	{
+	case StorageDeviceClass::kRotational:
+		return 32;
+
+	case StorageDeviceClass::kSolidState:
+		return 64;
+
+	case StorageDeviceClass::kNvme:
+		return 256;
+
+	default:
+		return 128;
+	}
+}
+
+void ReadChunkPolicy::SetChunkSizeOverride(uint32_t chunkSize)
+{
+	if (chunkSize != 0)
+		chunkSize = (std::min(chunkSize, kMaxChunkSizeOverride) + kChunkSizeAlignment - 1) & ~(kChunkSizeAlignment - 1);
+
+	s_ChunkSizeOverride = chunkSize;
+}
+
+void ReadChunkPolicy::SetQueueDepthOverride(uint32_t queueDepth)
+{
+	s_QueueDepthOverride = std::min(queueDepth, kMaxQueueDepthOverride);
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+enum class StorageDeviceClass : uint8_t
+{
+	kUnknown, // Network shares, virtual disks, or anything that wouldn't tell us
+	kRotational,
+	kSolidState,
+	kNvme,
+};
+
+// Picks how much of a file to read at once from the size of the file and the kind of device it's on. Reads only come in a few sizes,
+// so readers can keep a set of buffers per size rather than sizing every buffer for the largest read
+class ReadChunkPolicy
+{
+public:
+	static constexpr uint32_t kSmallChunkSize = 256 * 1024;
+	static constexpr uint32_t kMediumChunkSize = 1024 * 1024;
+	static constexpr uint32_t kLargeChunkSize = 8 * 1024 * 1024;
+
+	ReadChunkPolicy();
+
+	// Looks at the device behind the search path. Volumes mounted further down the tree get the same sizes
+	void Initialize(const std::wstring& searchPath);
+
+	uint32_t GetChunkSize(uint64_t fileSize) const;
+
+	// How many reads to keep in flight against the device, across all of a reader's threads
+	inline uint32_t GetQueueDepth() const
+	{
+		return m_QueueDepthOverride != 0 ? m_QueueDepthOverride : GetInitialQueueDepth(m_DeviceClass);
+	}
+
+	inline uint32_t GetQueueDepthOverride() const
+	{
+		return m_QueueDepthOverride;
+	}
+
+	inline StorageDeviceClass GetDeviceClass() const
+	{
+		return m_DeviceClass;
+	}
+
+	// Where a device of this class starts out before its queue depth is tuned, and how far tuning may take it
+	static uint32_t GetInitialQueueDepth(StorageDeviceClass deviceClass);
+	static uint32_t GetMaxQueueDepth(StorageDeviceClass deviceClass);
+
+	// Asks the device behind the volume a path is on. Mount points along the path are followed
+	static StorageDeviceClass QueryDeviceClass(const std::wstring& path);
+
+	// Reads every file in chunks of this size, rounded up to whole pages, in searches initialized after the call. 0 goes back to picking sizes.
+	// Only meant for measuring the defaults
+	static void SetChunkSizeOverride(uint32_t chunkSize);
+
+	// Keeps this many reads in flight against each device, without tuning, in searches initialized after the call. 0 goes back to tuning
+	static void SetQueueDepthOverride(uint32_t queueDepth);
+
+private:
+	StorageDeviceClass m_DeviceClass;
+	uint32_t m_ChunkSizeOverride;
+	uint32_t m_QueueDepthOverride;
+};
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "PrecompiledHeader.h"
+#include "ReadThrottle.h"
+
+constexpr int64_t kBurstMilliseconds = 100;
+constexpr DWORD kMaxSleepMilliseconds = 50; // Waits are cut into pieces no longer than this, to notice new limits. Stop ends them right away
+
+static inline int64_t GetTimestamp()
+{
+	LARGE_INTEGER timestamp;
+	QueryPerformanceCounter(&timestamp);
+	return timestamp.QuadPart;
+}
+
+ReadThrottle::ReadThrottle() :
+	m_IsLimited(false),
+	m_IsStopped(false),
+	m_MaxBytesPerSecond(0),
+	m_MaxReadsPerSecond(0),
+	m_LimitsVersion(0),
+	m_NextTurn(0)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	m_TicksPerSecond = frequency.QuadPart;
+	m_BurstTicks = m_TicksPerSecond * kBurstMilliseconds / 1000;
+}
+
+void ReadThrottle::SetLimits(uint64_t maxBytesPerSecond, uint32_t maxReadsPerSecond)
+{
+	m_MaxBytesPerSecond = maxBytesPerSecond;
+	m_MaxReadsPerSecond = maxReadsPerSecond;
+
+	// Turns handed out under the old limits don't carry over
+	m_NextTurn = GetTimestamp();
+	m_LimitsVersion++;
+	m_IsLimited = maxBytesPerSecond != 0 || maxReadsPerSecond != 0;
+}
+
+int64_t ReadThrottle::GetReadCost(uint32_t bytes) const
+{
+	const auto maxBytesPerSecond = m_MaxBytesPerSecond.load();
+	const auto maxReadsPerSecond = m_MaxReadsPerSecond.load();
+	int64_t cost = 0;
+
+	if (maxBytesPerSecond != 0)
+		cost = static_cast<int64_t>(static_cast<double>(bytes) * m_TicksPerSecond / maxBytesPerSecond);
+
+	if (maxReadsPerSecond != 0)
+		cost = std::max(cost, m_TicksPerSecond / maxReadsPerSecond);
+
+	return cost;
+}
+
+bool ReadThrottle::TryTakeTurn(uint32_t bytes, int64_t now, bool mayWait, int64_t& turn)
+{
+	const auto cost = GetReadCost(bytes);
+	auto nextTurn = m_NextTurn.load();
+
+	do
+	{
+		turn = std::max(nextTurn, now - m_BurstTicks);
+		if (!mayWait && turn > now)
+			return false;
+	}
+	while (!m_NextTurn.compare_exchange_weak(nextTurn, turn + cost));
+
+	return true;
+}
+
+void ReadThrottle::AcquireRead(uint32_t bytes)
+{
+	while (IsLimited() && !m_IsStopped)
+	{
+		const auto limitsVersion = m_LimitsVersion.load();
+		auto now = GetTimestamp();
+
+		int64_t turn;
+		TryTakeTurn(bytes, now, true, turn);
+
+		while (turn > now && !m_IsStopped && limitsVersion == m_LimitsVersion)
+		{
+			const auto milliseconds = static_cast<DWORD>(std::min<int64_t>((turn - now) * 1000 / m_TicksPerSecond + 1, kMaxSleepMilliseconds));
+			WaitForSingleObject(m_StopEvent, milliseconds);
+			now = GetTimestamp();
+		}
+
+		if (turn <= now)
+			return;
+	}
+}
+
+bool ReadThrottle::TryAcquireRead(uint32_t bytes)
+{
+	if (!IsLimited() || m_IsStopped)
+		return true;
+
+	int64_t turn;
+	return TryTakeTurn(bytes, GetTimestamp(), false, turn);
+}
+
+DWORD ReadThrottle::GetRetryDelay() const
+{
+	const auto ticks = m_NextTurn - m_BurstTicks - GetTimestamp();
+	return static_cast<DWORD>(std::clamp<int64_t>(ticks * 1000 / m_TicksPerSecond + 1, 1, kMaxSleepMilliseconds));
+}
+
+void ReadThrottle::Stop()
+{
+	m_IsStopped = true;
+	m_StopEvent.Set();
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Event.h"
+#include "NonCopyable.h"
+
+// Keeps a search's reads within a budget of bytes and reads per second. Every read takes a turn on a schedule that advances by whichever
+// of its bytes or its being one more read costs more of the budget, and can go as soon as its turn comes up. Turns don't wait for earlier
+// reads to complete, so the device queue stays as full as the budget allows. A schedule that falls behind builds up a little credit,
+// so reads after a pause can go out in a burst
+class ReadThrottle : NonCopyable
+{
+public:
+	ReadThrottle();
+
+	// 0 leaves that side of the budget unlimited. Can be changed while the search runs: reads waiting for their turn take new ones
+	void SetLimits(uint64_t maxBytesPerSecond, uint32_t maxReadsPerSecond);
+
+	inline bool IsLimited() const
+	{
+		return m_IsLimited.load(std::memory_order_relaxed);
+	}
+
+	// Waits for the read's turn
+	void AcquireRead(uint32_t bytes);
+
+	// Takes the read's turn only if it has come up already
+	bool TryAcquireRead(uint32_t bytes);
+
+	// How long until a read that TryAcquireRead turned down could go, in milliseconds
+	DWORD GetRetryDelay() const;
+
+	// Lets every read go from now on, waiting or not, without waiting out the sleep it's in. For searches being torn down
+	void Stop();
+
+private:
+	int64_t GetReadCost(uint32_t bytes) const;
+	bool TryTakeTurn(uint32_t bytes, int64_t now, bool mayWait, int64_t& turn);
+
+private:
+	int64_t m_TicksPerSecond;
+	int64_t m_BurstTicks;
+	std::atomic<bool> m_IsLimited;
+	std::atomic<bool> m_IsStopped;
+	Event<EventType::ManualReset> m_StopEvent;
+	std::atomic<uint64_t> m_MaxBytesPerSecond;
+	std::atomic<uint32_t> m_MaxReadsPerSecond;
+	std::atomic<uint32_t> m_LimitsVersion;
+	std::atomic<int64_t> m_NextTurn; // In performance counter ticks
+};
\ No newline at end of file
@@ -0,0 +1,377 @@
+#pragma once
+
+#include "FileContentSearchData.h"
+#include "SearchInstructions.h"
+#include "SearchResultReporter.h"
+#include "StringSearch/StringSearcher.h"
+#include "Utilities/BinaryFileDetection.h"
+#include "Utilities/IndexStableRingBuffer.h"
+#include "Utilities/ScopedStackAllocator.h"
+
+template <typename FileReadData>
+struct SlotFileReadStateData : FileReadData
+{
+    uint32_t chunksRead;
+    uint16_t readsInProgress;
+    bool hasFinalDecision;
+    bool skippedAsBinary;
+    bool awaitingClassification;
+    bool foundBeforeClassification;
+    uint64_t totalScannedSize;
+    std::vector<uint32_t> dictionaryMatches;
+    std::deque<uint16_t> pendingSlots; // Slots of the chunks not yet handed to the search threads, in file order
+
+    SlotFileReadStateData() :
+        chunksRead(0),
+        readsInProgress(0),
+        hasFinalDecision(false),
+        skippedAsBinary(false),
+        awaitingClassification(false),
+        foundBeforeClassification(false),
+        totalScannedSize(0)
+    {
+    }
+
+    SlotFileReadStateData(FileReadData&& other) :
+        FileReadData(std::move(other)),
+        chunksRead(0),
+        readsInProgress(0),
+        hasFinalDecision(false),
+        skippedAsBinary(false),
+        awaitingClassification(false),
+        foundBeforeClassification(false),
+        totalScannedSize(0)
+    {
+    }
+
+    SlotFileReadStateData(SlotFileReadStateData&& other) :
+        FileReadData(std::move(other)),
+        chunksRead(other.chunksRead),
+        readsInProgress(other.readsInProgress),
+        hasFinalDecision(other.hasFinalDecision),
+        skippedAsBinary(other.skippedAsBinary),
+        awaitingClassification(other.awaitingClassification),
+        foundBeforeClassification(other.foundBeforeClassification),
+        totalScannedSize(other.totalScannedSize),
+        dictionaryMatches(std::move(other.dictionaryMatches)),
+        pendingSlots(std::move(other.pendingSlots))
+    {
+    }
+
+    SlotFileReadStateData& operator=(SlotFileReadStateData&& other)
+    {
+        static_cast<FileReadData&>(*this) = std::move(other);
+        chunksRead = other.chunksRead;
+        readsInProgress = other.readsInProgress;
+        hasFinalDecision = other.hasFinalDecision;
+        skippedAsBinary = other.skippedAsBinary;
+        awaitingClassification = other.awaitingClassification;
+        foundBeforeClassification = other.foundBeforeClassification;
+        totalScannedSize = other.totalScannedSize;
+        dictionaryMatches = std::move(other.dictionaryMatches);
+        pendingSlots = std::move(other.pendingSlots);
+        return *this;
+    }
+};
+
+// The part of the slot readers that doesn't care where the bytes come from. Files are read in chunks of one size into a set of slots
+// allocated up front, each chunk is searched on its own, and the per-chunk results are folded into a decision about the file.
+// Chunks are kFileReadBufferBaseSize unless the reader asks for larger ones, which then get fewer slots, so the buffers take about as much memory.
+// The reader issues the reads and runs the threads. It has to provide:
+//   ThreadedWorkQueue<Reader, SlotSearchData> m_SearchWorkQueue, which DispatchReadChunks hands chunks to
+//   void AbandonFileReads(FileReadStateData& file, uint32_t fileIndex), for once a file is decided and its remaining reads aren't needed
+//   void OnFileReadsFinished(FileReadStateData& file), for once a file has no chunks left to read or search
+// Everything but SearchChunk runs on the reader's read thread
+template <typename Reader, typename FileReadData, size_t TargetTotalBufferSize, size_t FileReadBufferBaseSize>
+class SlotSearchPipeline
+{
+public:
+    static constexpr size_t kTargetTotalBufferSize = TargetTotalBufferSize;
+    static constexpr size_t kFileReadBufferBaseSize = FileReadBufferBaseSize;
+    static constexpr uint16_t kMaxFileReadSlotCount = kTargetTotalBufferSize / kFileReadBufferBaseSize;
+
+protected:
+    typedef SlotFileReadStateData<FileReadData> FileReadStateData;
+
+    SlotSearchPipeline(const StringSearcher& stringSearcher, const SearchInstructions& searchInstructions, SearchResultReporter& searchResultReporter) :
+        m_SearchResultReporter(searchResultReporter),
+        m_StringSearcher(stringSearcher),
+        m_SearchInstructions(searchInstructions),
+        m_ReadChunkSize(0),
+        m_ReadBufferSize(0),
+        m_FileReadSlotCount(0),
+        m_FreeReadSlotCount(0),
+        m_IsTerminating(false)
+    {
+    }
+
+    void InitializeReadSlots(uint32_t readChunkSize = kFileReadBufferBaseSize)
+    {
+        // A chunk is only searched once the read of the one after it completes, so it takes at least two slots to get anywhere
+        m_ReadChunkSize = readChunkSize;
+        m_ReadBufferSize = m_ReadChunkSize + m_StringSearcher.GetMaxMatchLengthInBytes() + m_StringSearcher.GetMaxProximityDistance();
+        m_FileReadSlotCount = static_cast<uint16_t>(std::clamp<size_t>(kTargetTotalBufferSize / m_ReadChunkSize, 2, kMaxFileReadSlotCount));
+        m_FreeReadSlotCount = m_FileReadSlotCount;
+
+        // Allocated once and reused for every read, so no buffer is ever allocated or freed while reads are in flight
+        m_FileReadBuffers.reset(new uint8_t[m_ReadBufferSize * m_FileReadSlotCount]);
+
+        if (m_StringSearcher.IsDictionarySearch())
+            m_SlotDictionaryMatches.reset(new std::vector<uint32_t>[m_FileReadSlotCount]);
+
+        m_SlotSearchData.reserve(m_FileReadSlotCount);
+        for (uint16_t slot = 0; slot < m_FileReadSlotCount; slot++)
+            m_SlotSearchData.emplace_back(slot, 0, false);
+
+        memset(m_FreeReadSlots, 0, sizeof(m_FreeReadSlots));
+        for (uint16_t slot = 0; slot < m_FileReadSlotCount; slot++)
+            m_FreeReadSlots[slot / 64] |= 1ULL << (slot % 64);
+
+        memset(m_SlotReadInFlight, 0, sizeof(m_SlotReadInFlight));
+    }
+
+    uint32_t GetChunkCount(const FileReadStateData& file) const
+    {
+        const auto fileSize = file.fileSize;
+        auto chunkCount = fileSize / m_ReadChunkSize;
+        if (fileSize % m_ReadChunkSize)
+            chunkCount++;
+
+        Assert(chunkCount < std::numeric_limits<uint32_t>::max());
+        return static_cast<uint32_t>(chunkCount);
+    }
+
+    inline uint8_t* GetReadBuffer(uint16_t slot)
+    {
+        return m_FileReadBuffers.get() + slot * m_ReadBufferSize;
+    }
+
+    // Returns m_FileReadSlotCount if every slot is taken
+    uint16_t FindFreeReadSlot() const
+    {
+        // TO DO: use a trie if this is too slow
+        for (uint16_t i = 0; i < ARRAYSIZE(m_FreeReadSlots); i++)
+        {
+            DWORD index;
+            if (_BitScanForward64(&index, m_FreeReadSlots[i]))
+                return 64 * i + static_cast<uint16_t>(index);
+        }
+
+        return m_FileReadSlotCount;
+    }
+
+    // Gives the slot to the next chunk of the file at the back of m_FilesWithReadProgress. The reader reads m_SlotSearchData[slot].size bytes
+    // at the returned offset into the slot's buffer, and the read stays in flight until it clears m_SlotReadInFlight[slot]
+    uint64_t AssignReadSlot(uint16_t slot)
+    {
+        Assert(slot < m_FileReadSlotCount);
+
+        auto& file = m_FilesWithReadProgress.Back();
+        file.readsInProgress++;
+
+        m_FileReadSlots[slot] = m_FilesWithReadProgress.BackIndex();
+        m_FreeReadSlots[slot / 64] &= ~(1ULL << (slot % 64));
+        m_FreeReadSlotCount--;
+
+        const bool isFirstChunk = file.chunksRead == 0;
+        const auto fileOffset = static_cast<uint64_t>(file.chunksRead++) * m_ReadChunkSize;
+        const auto bytesToRead = static_cast<uint32_t>(std::min<uint64_t>(file.fileSize - fileOffset, m_ReadChunkSize));
+
+        m_SlotSearchData[slot] = SlotSearchData(slot, bytesToRead, isFirstChunk);
+        m_SlotReadInFlight[slot] = true;
+        file.pendingSlots.push_back(slot);
+        return fileOffset;
+    }
+
+    void DispatchReadChunks(FileReadStateData& file)
+    {
+        const auto seamSize = m_ReadBufferSize - m_ReadChunkSize;
+
+        // Chunks don't overlap on disk. Instead, each one gets the start of the next one copied after it before it's searched,
+        // so chunks go to the search threads in file order, each once the read after it has completed
+        while (!file.pendingSlots.empty() && !m_SlotReadInFlight[file.pendingSlots.front()])
+        {
+            const auto slot = file.pendingSlots.front();
+            auto& searchData = m_SlotSearchData[slot];
+            const bool shouldSearch = searchData.size > 0 && !file.hasFinalDecision && !file.skippedAsBinary && !m_IsTerminating && !m_SearchResultReporter.HasReachedResultLimit();
+
+            if (shouldSearch && file.pendingSlots.size() > 1)
+            {
+                const auto nextSlot = file.pendingSlots[1];
+                if (m_SlotReadInFlight[nextSlot])
+                    break;
+
+                // A short read means the file shrank, so whatever follows it isn't contiguous with it
+                if (searchData.size == m_ReadChunkSize)
+                {
+                    const auto seamBytes = std::min<size_t>(seamSize, m_SlotSearchData[nextSlot].size);
+                    memcpy(GetReadBuffer(slot) + searchData.size, GetReadBuffer(nextSlot), seamBytes);
+                    searchData.size += static_cast<uint32_t>(seamBytes);
+                }
+            }
+            else if (shouldSearch && file.chunksRead < GetChunkCount(file))
+            {
+                // The next chunk hasn't been issued yet
+                break;
+            }
+
+            file.pendingSlots.pop_front();
+
+            if (shouldSearch)
+            {
+                static_cast<Reader*>(this)->m_SearchWorkQueue.PushWorkItem(searchData);
+            }
+            else
+            {
+                RecordSearchResult(searchData);
+            }
+        }
+    }
+
+    // Runs on the search threads
+    void SearchChunk(SlotSearchData& searchData, ScopedStackAllocator& allocator)
+    {
+        // The read might have been cancelled, in which case the buffer contents are garbage
+        if (m_IsTerminating || m_SearchResultReporter.HasReachedResultLimit())
+            return;
+
+        auto buffer = GetReadBuffer(searchData.slot);
+
+        if (searchData.isFirstChunk && m_SearchInstructions.SkipBinaryFiles() && BinaryFileDetection::IsBinary(buffer, searchData.size))
+        {
+            searchData.isBinary = true;
+        }
+        else if (m_StringSearcher.IsDictionarySearch())
+        {
+            auto& dictionaryMatches = m_SlotDictionaryMatches[searchData.slot];
+            dictionaryMatches.clear();
+            m_StringSearcher.FindDictionaryMatches(buffer, searchData.size, dictionaryMatches);
+            searchData.found = m_SearchInstructions.InvertContentMatch() && !dictionaryMatches.empty();
+        }
+        else if (m_StringSearcher.IsProximitySearch())
+        {
+            // Chunks are searched out of order, but each one carries enough of the next to hold any pair starting in it
+            ProximityWindow window;
+            searchData.found = m_StringSearcher.FindProximityMatch(buffer, searchData.size, searchData.size, 0, window);
+        }
+        else
+        {
+            searchData.found = m_StringSearcher.PerformFileContentSearch(buffer, searchData.size, allocator);
+        }
+
+        searchData.searched = true;
+    }
+
+    // Frees the chunk's slot and folds its search result into the decision about its file
+    void RecordSearchResult(const SlotSearchData& searchData)
+    {
+        const auto fileIndex = m_FileReadSlots[searchData.slot];
+        auto& file = m_FilesWithReadProgress[fileIndex];
+
+        Assert(file.readsInProgress > 0);
+        file.readsInProgress--;
+        m_FreeReadSlots[searchData.slot / 64] |= 1ULL << (searchData.slot % 64);
+        m_FreeReadSlotCount++;
+
+        if (!file.hasFinalDecision && !file.skippedAsBinary && searchData.searched)
+        {
+            bool found = searchData.found;
+
+            if (searchData.isFirstChunk && file.awaitingClassification)
+            {
+                file.awaitingClassification = false;
+                found = found || file.foundBeforeClassification;
+            }
+            else if (found && file.awaitingClassification)
+            {
+                // Later chunks can finish before the first one does. Hold on to the match until we know the file isn't binary
+                file.foundBeforeClassification = true;
+                found = false;
+            }
+
+            if (m_SlotDictionaryMatches != nullptr)
+            {
+                const auto& slotDictionaryMatches = m_SlotDictionaryMatches[searchData.slot];
+                file.dictionaryMatches.insert(file.dictionaryMatches.end(), slotDictionaryMatches.begin(), slotDictionaryMatches.end());
+            }
+
+            if (searchData.isBinary)
+            {
+                m_SearchResultReporter.OnBinaryFileSkipped(file.fileSize - file.totalScannedSize);
+                file.totalScannedSize = file.fileSize;
+                file.skippedAsBinary = true;
+                file.dictionaryMatches.clear();
+                static_cast<Reader*>(this)->AbandonFileReads(file, fileIndex);
+            }
+            else if (found)
+            {
+                // A match decides the file either way: it's a result, or with an inverted match it can't be one
+                m_SearchResultReporter.AddToScannedFileCount();
+                m_SearchResultReporter.AddToScannedFileSize(file.fileSize - file.totalScannedSize);
+
+                if (!m_SearchInstructions.InvertContentMatch())
+                    m_SearchResultReporter.DispatchSearchResult(file.fileFindData, std::move(file.filePath));
+
+                file.totalScannedSize = file.fileSize;
+                file.hasFinalDecision = true;
+                static_cast<Reader*>(this)->AbandonFileReads(file, fileIndex);
+            }
+            else if (file.readsInProgress == 0 && file.chunksRead == GetChunkCount(file))
+            {
+                m_SearchResultReporter.AddToScannedFileCount();
+                m_SearchResultReporter.AddToScannedFileSize(file.fileSize - file.totalScannedSize);
+                file.totalScannedSize = file.fileSize;
+
+                // Inverted and dictionary searches only know what to report once every chunk of the file has been searched
+                if (m_SearchInstructions.InvertContentMatch())
+                    m_SearchResultReporter.DispatchSearchResult(file.fileFindData, std::move(file.filePath));
+                else if (!file.dictionaryMatches.empty())
+                    m_SearchResultReporter.DispatchDictionarySearchResult(file.fileFindData, std::move(file.filePath), std::move(file.dictionaryMatches));
+            }
+            else
+            {
+                m_SearchResultReporter.AddToScannedFileSize(m_ReadChunkSize);
+                file.totalScannedSize += m_ReadChunkSize;
+            }
+        }
+
+        // Files further back in the ring can finish before the front one does, so they get let go of now rather than when they get popped
+        if (file.readsInProgress == 0 && file.chunksRead == GetChunkCount(file))
+            static_cast<Reader*>(this)->OnFileReadsFinished(file);
+    }
+
+    void PopFinishedFiles()
+    {
+        while (!m_FilesWithReadProgress.IsEmpty())
+        {
+            auto& firstFile = m_FilesWithReadProgress.Front();
+
+            if (firstFile.chunksRead == GetChunkCount(firstFile) && firstFile.readsInProgress == 0)
+            {
+                m_FilesWithReadProgress.PopFront();
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+protected:
+    SearchResultReporter& m_SearchResultReporter;
+    const StringSearcher& m_StringSearcher;
+    const SearchInstructions& m_SearchInstructions;
+    uint32_t m_ReadChunkSize;
+    size_t m_ReadBufferSize;
+    IndexStableRingBuffer<FileReadStateData, uint32_t> m_FilesWithReadProgress;
+    uint16_t m_FileReadSlotCount;
+    uint16_t m_FreeReadSlotCount;
+    std::atomic<bool> m_IsTerminating;
+
+    std::unique_ptr<uint8_t[]> m_FileReadBuffers;
+    std::unique_ptr<std::vector<uint32_t>[]> m_SlotDictionaryMatches; // Filled by the search threads, drained by RecordSearchResult
+    std::vector<SlotSearchData> m_SlotSearchData; // Each slot's chunk, from when its read is issued until its result is recorded
+    uint64_t m_FreeReadSlots[kMaxFileReadSlotCount / 64];
+    uint32_t m_FileReadSlots[kMaxFileReadSlotCount];
+    bool m_SlotReadInFlight[kMaxFileReadSlotCount];
+};
\ No newline at end of file
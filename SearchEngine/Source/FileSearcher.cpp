@@ -1,7 +1,9 @@
 #include "PrecompiledHeader.h"
 #include "FileReadBackends/DirectStorage/DirectXContext.h"
+#include "FileReadBackends/ReadChunkPolicy.h"
 #include "FileSearcher.h"
 #include "StringUtils.h"
+#include "Utilities/ArchiveDirectory.h"
 #include "Utilities/AsynchronousPeriodicTimer.h"
 #include "Utilities/FileEnumerator.h"
 #include "Utilities/PathUtils.h"
@@ -10,40 +12,85 @@
 FileSearcher::FileSearcher(SearchInstructions&& searchInstructions) :
 	m_RefCount(1),
 	m_SearchInstructions(std::move(searchInstructions)),
+	m_ContentReader(ChooseContentReader(m_SearchInstructions)),
 	m_StringSearcher(m_SearchInstructions),
 	m_SearchResultReporter(m_SearchInstructions),
-	m_DirectStorageReader(m_StringSearcher, m_SearchInstructions, m_SearchResultReporter),
-	m_OverlappedIOReader(m_StringSearcher, m_SearchInstructions, m_SearchResultReporter),
+	m_DirectStorageReader(m_StringSearcher, m_SearchInstructions, m_SearchResultReporter, m_ReadThrottle),
+	m_CompletionPortReader(m_StringSearcher, m_SearchInstructions, m_SearchResultReporter, m_ReadThrottle),
+	m_OverlappedIOReader(m_StringSearcher, m_SearchInstructions, m_SearchResultReporter, m_ReadThrottle),
 	m_FinishedSearchingFileSystem(false),
 	m_IsFinished(false),
 	m_FailedInit(false)
 {
-	if (m_SearchInstructions.SearchInFileContents())
+	// Before any reader can issue a read
+	m_ReadThrottle.SetLimits(m_SearchInstructions.maxReadBytesPerSecond, m_SearchInstructions.maxReadsPerSecond);
+
+	if (m_StringSearcher.IsDictionarySearch())
+		m_SearchResultReporter.OnDictionaryBuilt(m_StringSearcher.GetDictionaryEntryCount(), m_StringSearcher.GetDictionaryMemoryUsage(), m_StringSearcher.GetDictionaryBuildTimeInSeconds());
+
+	switch (m_ContentReader)
 	{
-		if (m_SearchInstructions.UseDirectStorage())
+	case ContentReader::kDirectStorage:
+		if (DirectXContext::GetDStorageFactory() == nullptr)
 		{
-			if (DirectXContext::GetDStorageFactory() == nullptr)
-			{
-				m_SearchInstructions.onError(m_SearchInstructions.callbackContext, L"Failed to initialize DirectStorage!");
-				m_FailedInit = true;
-			}
-			else if (DirectXContext::GetD3D12Device() == nullptr)
-			{
-				m_SearchInstructions.onError(m_SearchInstructions.callbackContext, L"Failed to initialize DirectX 12!");
-				m_FailedInit = true;
-			}
-			else
-			{
-				m_DirectStorageReader.Initialize();
-			}
+			m_SearchInstructions.onError(m_SearchInstructions.callbackContext, L"Failed to initialize DirectStorage!");
+			m_FailedInit = true;
+		}
+		else if (DirectXContext::GetD3D12Device() == nullptr)
+		{
+			m_SearchInstructions.onError(m_SearchInstructions.callbackContext, L"Failed to initialize DirectX 12!");
+			m_FailedInit = true;
 		}
 		else
 		{
-			m_OverlappedIOReader.Initialize();
+			m_DirectStorageReader.Initialize();
 		}
+		break;
+
+	case ContentReader::kCompletionPort:
+		m_CompletionPortReader.Initialize();
+		break;
+
+	case ContentReader::kOverlappedIO:
+		m_OverlappedIOReader.Initialize();
+		break;
+
+	case ContentReader::kNone:
+		break;
 	}
 }
 
+// The completion port reader keeps many files' reads in flight from a single read thread and searches what they read on a pool of threads,
+// and on rotational disks it reads files in the order they're laid out in. So it reads file contents unless the search asks for another
+// reader, or for something only the overlapped I/O reader does
+FileSearcher::ContentReader FileSearcher::ChooseContentReader(const SearchInstructions& searchInstructions)
+{
+	if (!searchInstructions.SearchInFileContents())
+	{
+		// Archive members get their names searched either way
+		if (searchInstructions.SearchInArchives() && !searchInstructions.UseDirectStorage() && !searchInstructions.UseCompletionPort())
+			return ContentReader::kOverlappedIO;
+
+		return ContentReader::kNone;
+	}
+
+	if (searchInstructions.UseDirectStorage())
+		return ContentReader::kDirectStorage;
+
+	if (searchInstructions.UseCompletionPort())
+		return ContentReader::kCompletionPort;
+
+	if (searchInstructions.UseOverlappedIO() || searchInstructions.CacheNeutralReads() || searchInstructions.SearchCompressedFiles() || searchInstructions.SearchInArchives())
+		return ContentReader::kOverlappedIO;
+
+	// On a rotational disk nothing does as much for reading speed as not seeking, so files are read in disk order there, even if that means
+	// reading sparse files' holes and not batching small files. Mapped views and unbuffered reads give way to it too, as all they do is read faster
+	if (ReadChunkPolicy::QueryDeviceClass(searchInstructions.searchPath) == StorageDeviceClass::kRotational)
+		return ContentReader::kCompletionPort;
+
+	return ContentReader::kOverlappedIO;
+}
+
 void FileSearcher::AddRef()
 {
 	InterlockedIncrement(&m_RefCount);
@@ -70,16 +117,22 @@ void FileSearcher::Search()
 	SearchFileSystem();
 
 	// Wait for worker threads to finish
-	if (m_SearchInstructions.SearchInFileContents())
+	switch (m_ContentReader)
 	{
-		if (m_SearchInstructions.UseDirectStorage())
-		{
-			m_DirectStorageReader.CompleteAllWork();
-		}
-		else
-		{
-			m_OverlappedIOReader.CompleteAllWork();
-		}
+	case ContentReader::kDirectStorage:
+		m_DirectStorageReader.CompleteAllWork();
+		break;
+
+	case ContentReader::kCompletionPort:
+		m_CompletionPortReader.CompleteAllWork();
+		break;
+
+	case ContentReader::kOverlappedIO:
+		m_OverlappedIOReader.CompleteAllWork();
+		break;
+
+	case ContentReader::kNone:
+		break;
 	}
 
 	// Stop reporting progress
@@ -104,7 +157,7 @@ void FileSearcher::SearchFileSystem()
 		fileSystemEnumerationFlags |= FileSystemEnumerationFlags::kEnumerateDirectories;
 
 	// Do this iteratively rather than recursively. Much easier to profile it that way.
-	while (directoriesToSearch.size() > 0 && !m_IsFinished)
+	while (directoriesToSearch.size() > 0 && !ShouldStopSearching())
 	{
 		auto directory = std::move(directoriesToSearch[0]);
 		directoriesToSearch[0] = std::move(directoriesToSearch[directoriesToSearch.size() - 1]);
@@ -115,22 +168,27 @@ void FileSearcher::SearchFileSystem()
 		{
 			EnumerateFileSystem(directory, std::wstring_view(L"*", 1), FileSystemEnumerationFlags::kEnumerateDirectories, stackAllocator, [this, &directory, &directoriesToSearch](WIN32_FIND_DATAW& findData)
 			{
-				if (m_IsFinished)
-					return;
+				if (ShouldStopSearching())
+					return false;
 
                 if (m_SearchInstructions.IgnoreDotStart() && findData.cFileName[0] == '.')
-                    return;
+                    return true;
 
 				if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
 					directoriesToSearch.push_back(PathUtils::CombinePaths(directory, findData.cFileName));
+
+				return true;
 			});
 		}
 
 		// Second, enumerate directory using our filters
 		EnumerateFileSystem(directory, m_SearchInstructions.searchPattern, fileSystemEnumerationFlags, stackAllocator, [this, &directory, &directoriesToSearch, &stackAllocator](WIN32_FIND_DATAW& findData)
 		{
+			if (ShouldStopSearching())
+				return false;
+
             if (m_SearchInstructions.IgnoreDotStart() && findData.cFileName[0] == '.')
-                return;
+                return true;
 
 			m_SearchResultReporter.OnFileEnumeratedThreadUnsafe();
 
@@ -142,6 +200,8 @@ void FileSearcher::SearchFileSystem()
 			{
 				OnFileFound(directory, findData, stackAllocator);
 			}
+
+			return true;
 		});
 
 		m_SearchResultReporter.OnDirectoryEnumeratedThreadUnsafe();
@@ -160,36 +220,66 @@ void FileSearcher::OnDirectoryFound(const std::wstring& directory, const WIN32_F
 
 void FileSearcher::OnFileFound(const std::wstring& directory, const WIN32_FIND_DATAW& findData, ScopedStackAllocator& stackAllocator)
 {
-	if (!m_SearchInstructions.SearchForFiles() || m_IsFinished)
+	if (!m_SearchInstructions.SearchForFiles() || ShouldStopSearching())
 		return;
 
 	uint64_t fileSize = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) + findData.nFileSizeLow;
 	if (fileSize > m_SearchInstructions.ignoreFilesLargerThan)
 		return;
 
+	// An archive whose name matches still has its members searched
+	ArchiveDirectory::ArchiveFormat archiveFormat;
+	const bool isArchive = SearchesArchiveMembers() && fileSize != 0 && ArchiveDirectory::GetArchiveFormat(findData.cFileName, archiveFormat);
+	bool isNameMatched = false;
+
 	if (m_SearchInstructions.SearchInFilePath())
 	{
-		if (SearchInFileName(directory, findData, true, stackAllocator))
-			return;
+		isNameMatched = SearchInFileName(directory, findData, true, stackAllocator);
 	}
 	else if (m_SearchInstructions.SearchInFileName())
 	{
-		if (SearchInFileName(directory, findData, false, stackAllocator))
-			return;
+		isNameMatched = SearchInFileName(directory, findData, false, stackAllocator);
 	}
 
+	if (isNameMatched && !isArchive)
+		return;
+
 	m_SearchResultReporter.OnTotalFileSizeAddedThreadUnsafe(fileSize);
 
-	if (!m_SearchInstructions.SearchInFileContents() || fileSize == 0)
+	if (isArchive)
+	{
+		m_OverlappedIOReader.ScanArchive(FileOpenData(PathUtils::CombinePaths(directory, findData.cFileName), fileSize, findData), isNameMatched);
 		return;
+	}
 
-	if (m_SearchInstructions.UseDirectStorage())
+	if (!m_SearchInstructions.SearchInFileContents())
+		return;
+
+	if (fileSize == 0)
 	{
-		m_DirectStorageReader.ScanFile(FileOpenData(PathUtils::CombinePaths(directory, findData.cFileName), fileSize, findData));
+		// There's nothing in an empty file, so it doesn't contain the search string either
+		if (m_SearchInstructions.InvertContentMatch())
+			m_SearchResultReporter.DispatchSearchResult(findData, PathUtils::CombinePaths(directory, findData.cFileName));
+
+		return;
 	}
-	else
+
+	switch (m_ContentReader)
 	{
+	case ContentReader::kDirectStorage:
+		m_DirectStorageReader.ScanFile(FileOpenData(PathUtils::CombinePaths(directory, findData.cFileName), fileSize, findData));
+		break;
+
+	case ContentReader::kCompletionPort:
+		m_CompletionPortReader.ScanFile(FileOpenData(PathUtils::CombinePaths(directory, findData.cFileName), fileSize, findData));
+		break;
+
+	case ContentReader::kOverlappedIO:
 		m_OverlappedIOReader.ScanFile(FileOpenData(PathUtils::CombinePaths(directory, findData.cFileName), fileSize, findData));
+		break;
+
+	case ContentReader::kNone:
+		break;
 	}
 }
 
@@ -220,6 +310,50 @@ bool FileSearcher::SearchInFileName(const std::wstring& directory, const WIN32_F
 	return false;
 }
 
+static bool LoadDictionary(SearchInstructions& searchInstructions)
+{
+	FileHandleHolder fileHandle = CreateFileW(searchInstructions.dictionaryPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	auto& contents = searchInstructions.dictionaryContents;
+	LARGE_INTEGER fileSize;
+	DWORD bytesRead;
+
+	bool readSucceeded = fileHandle != INVALID_HANDLE_VALUE && GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart <= std::numeric_limits<int32_t>::max();
+	if (readSucceeded)
+	{
+		contents.resize(static_cast<size_t>(fileSize.QuadPart));
+		readSucceeded = ReadFile(fileHandle, contents.data(), static_cast<DWORD>(contents.size()), &bytesRead, nullptr) && bytesRead == contents.size();
+	}
+
+	if (!readSucceeded)
+	{
+		auto errorMessage = L"Failed to read dictionary file '" + searchInstructions.dictionaryPath + L"'.";
+		searchInstructions.onError(searchInstructions.callbackContext, errorMessage.c_str());
+		return false;
+	}
+
+	size_t entryCount = 0;
+	size_t longestEntryLength = 0;
+	StringSearcher::ForEachDictionaryEntry(contents, [&entryCount, &longestEntryLength](std::string_view entry, uint32_t)
+	{
+		entryCount++;
+		longestEntryLength = std::max(longestEntryLength, entry.length());
+	});
+
+	if (entryCount == 0)
+	{
+		searchInstructions.onError(searchInstructions.callbackContext, L"Dictionary file does not contain any entries.");
+		return false;
+	}
+
+	if (longestEntryLength > 1024)
+	{
+		searchInstructions.onError(searchInstructions.callbackContext, L"Dictionary entries cannot be longer than 1024 bytes.");
+		return false;
+	}
+
+	return true;
+}
+
 FileSearcher* FileSearcher::BeginSearch(SearchInstructions&& searchInstructions)
 {
 	if (searchInstructions.searchString.length() > 1024)
@@ -228,6 +362,24 @@ FileSearcher* FileSearcher::BeginSearch(SearchInstructions&& searchInstructions)
 		return nullptr;
 	}
 
+	if (searchInstructions.SearchForDictionaryEntries() && !LoadDictionary(searchInstructions))
+		return nullptr;
+
+	if (searchInstructions.SearchForProximity())
+	{
+		if (searchInstructions.searchString.empty() || searchInstructions.proximitySearchString.empty() || searchInstructions.proximitySearchString.length() > 1024)
+		{
+			searchInstructions.onError(searchInstructions.callbackContext, L"Both proximity search strings must be between 1 and 1024 characters long.");
+			return nullptr;
+		}
+
+		if (searchInstructions.maxProximityDistance > StringSearcher::kMaxProximityDistance)
+		{
+			searchInstructions.onError(searchInstructions.callbackContext, L"Proximity search distance cannot be larger than 65536 bytes.");
+			return nullptr;
+		}
+	}
+
 	FileSearcher* searcher = new FileSearcher(std::forward<SearchInstructions>(searchInstructions));
 	if (searcher->m_FailedInit)
 	{
@@ -250,22 +402,39 @@ FileSearcher* FileSearcher::BeginSearch(SearchInstructions&& searchInstructions)
 
 void FileSearcher::Cleanup()
 {
+	const DWORD kEnumerationCancelRetryMilliseconds = 10;
 	m_IsFinished = true;
+	m_ReadThrottle.Stop();
 
-	if (m_SearchInstructions.SearchInFileContents())
+	switch (m_ContentReader)
 	{
-		if (m_SearchInstructions.UseDirectStorage())
-		{
-			m_DirectStorageReader.DrainWorkQueue();
-		}
-		else
-		{
-			m_OverlappedIOReader.DrainWorkQueue();
-		}
+	case ContentReader::kDirectStorage:
+		m_DirectStorageReader.DrainWorkQueue();
+		break;
+
+	case ContentReader::kCompletionPort:
+		m_CompletionPortReader.DrainWorkQueue();
+		break;
+
+	case ContentReader::kOverlappedIO:
+		m_OverlappedIOReader.DrainWorkQueue();
+		break;
+
+	case ContentReader::kNone:
+		break;
 	}
 
 	m_SearchResultReporter.DrainWorkQueue();
 
+	// Listing a directory on a slow or remote file system can block for a long time. The enumeration thread sees the search is over the moment
+	// that gets cancelled, unless it was just about to start the next listing, so keep at it until it's done enumerating
+	while (!m_FinishedSearchingFileSystem)
+	{
+		CancelSynchronousIo(m_FileSystemSearchThread);
+		if (WaitForSingleObject(m_FileSystemSearchThread, kEnumerationCancelRetryMilliseconds) != WAIT_TIMEOUT)
+			break;
+	}
+
 	WaitForSingleObject(m_FileSystemSearchThread, INFINITE);
 
 	Release();
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "FileContentSearchData.h"
+#include "FileReadBackends/CompletionPort/CompletionPortReader.h"
 #include "FileReadBackends/DirectStorage/DirectStorageReader.h"
 #include "FileReadBackends/OverlappedIO/OverlappedIOReader.h"
+#include "FileReadBackends/ReadThrottle.h"
 #include "HandleHolder.h"
 #include "SearchResultReporter.h"
 #include "StringSearch/StringSearcher.h"
@@ -16,6 +18,11 @@ public:
 	static FileSearcher* BeginSearch(SearchInstructions&& searchInstructions);
 	void Cleanup();
 
+	inline void SetReadRateLimit(uint64_t maxBytesPerSecond, uint32_t maxReadsPerSecond)
+	{
+		m_ReadThrottle.SetLimits(maxBytesPerSecond, maxReadsPerSecond);
+	}
+
 private:
 	FileSearcher(SearchInstructions&& searchInstructions);
 
@@ -28,12 +35,36 @@ private:
 	void OnFileFound(const std::wstring& directory, const WIN32_FIND_DATAW& findData, ScopedStackAllocator& stackAllocator);
 	bool SearchInFileName(const std::wstring& directory, const WIN32_FIND_DATAW& findData, bool searchInPath, ScopedStackAllocator& stackAllocator);
 
+	enum class ContentReader
+	{
+		kNone,
+		kOverlappedIO,
+		kCompletionPort,
+		kDirectStorage,
+	};
+
+	static ContentReader ChooseContentReader(const SearchInstructions& searchInstructions);
+
+	inline bool ShouldStopSearching() const
+	{
+		return m_IsFinished || m_SearchResultReporter.HasReachedResultLimit();
+	}
+
+	// Archive members are only read by the overlapped I/O reader. It searches their names even when file contents aren't searched
+	inline bool SearchesArchiveMembers() const
+	{
+		return m_SearchInstructions.SearchInArchives() && m_ContentReader == ContentReader::kOverlappedIO;
+	}
+
 private:
 	const SearchInstructions m_SearchInstructions;
+	const ContentReader m_ContentReader;
 	StringSearcher m_StringSearcher;
 
 	SearchResultReporter m_SearchResultReporter;
+	ReadThrottle m_ReadThrottle;
 	DirectStorageReader m_DirectStorageReader;
+	CompletionPortReader m_CompletionPortReader;
 	OverlappedIOReader m_OverlappedIOReader;
 
 	ThreadHandleHolder m_FileSystemSearchThread;
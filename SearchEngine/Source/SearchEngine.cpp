@@ -1,6 +1,9 @@
 #include "PrecompiledHeader.h"
+#include "BufferSearcher.h"
+#include "FileReadBackends/ReadChunkPolicy.h"
 #include "FileSearcher.h"
 #include "SearchEngine.h"
+#include "StringSearch/StreamSearcher.h"
 
 extern "C" FileSearcher* Search(
 	FoundPathCallback foundPathCallback,
@@ -12,12 +15,129 @@ extern "C" FileSearcher* Search(
 	const wchar_t* searchString,
 	SearchFlags searchFlags,
 	uint64_t ignoreFilesLargerThan,
+	uint64_t maxResults,
+	uint64_t maxReadBytesPerSecond,
+	uint32_t maxReadsPerSecond,
 	void* callbackContext)
 {
-	return FileSearcher::BeginSearch(SearchInstructions(foundPathCallback, progressUpdatedCallback, searchDoneCallback, errorCallback, searchPath, searchPattern, searchString, searchFlags, ignoreFilesLargerThan, callbackContext));
+	// Only SearchWithDictionary and SearchWithProximity set up what their searches need
+	searchFlags &= ~(SearchFlags::kSearchForDictionaryEntries | SearchFlags::kSearchForProximity);
+
+	return FileSearcher::BeginSearch(SearchInstructions(foundPathCallback, progressUpdatedCallback, searchDoneCallback, errorCallback, searchPath, searchPattern, searchString, searchFlags, ignoreFilesLargerThan, maxResults, maxReadBytesPerSecond, maxReadsPerSecond, callbackContext));
+}
+
+extern "C" FileSearcher* SearchWithDictionary(
+	FoundPathCallback foundPathCallback,
+	SearchProgressUpdated progressUpdatedCallback,
+	SearchDoneCallback searchDoneCallback,
+	ErrorCallback errorCallback,
+	DictionaryMatchesCallback dictionaryMatchesCallback,
+	const wchar_t* searchPath,
+	const wchar_t* searchPattern,
+	const wchar_t* dictionaryPath,
+	SearchFlags searchFlags,
+	uint64_t ignoreFilesLargerThan,
+	uint64_t maxResults,
+	uint64_t maxReadBytesPerSecond,
+	uint32_t maxReadsPerSecond,
+	void* callbackContext)
+{
+	// Dictionary entries are only looked for in file contents
+	searchFlags &= ~(SearchFlags::kSearchInFileName | SearchFlags::kSearchInFilePath | SearchFlags::kSearchForDirectories | SearchFlags::kSearchInDirectoryName | SearchFlags::kSearchInDirectoryPath);
+	searchFlags |= SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchForDictionaryEntries;
+
+	if ((searchFlags & (SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSearchContentsAsUtf16)) == SearchFlags::kNone)
+		searchFlags |= SearchFlags::kSearchContentsAsUtf8;
+
+	SearchInstructions searchInstructions(foundPathCallback, progressUpdatedCallback, searchDoneCallback, errorCallback, searchPath, searchPattern, L"", searchFlags, ignoreFilesLargerThan, maxResults, maxReadBytesPerSecond, maxReadsPerSecond, callbackContext);
+	searchInstructions.onDictionaryMatches = dictionaryMatchesCallback;
+	searchInstructions.dictionaryPath = dictionaryPath;
+
+	return FileSearcher::BeginSearch(std::move(searchInstructions));
+}
+
+extern "C" FileSearcher* SearchWithProximity(
+	FoundPathCallback foundPathCallback,
+	SearchProgressUpdated progressUpdatedCallback,
+	SearchDoneCallback searchDoneCallback,
+	ErrorCallback errorCallback,
+	const wchar_t* searchPath,
+	const wchar_t* searchPattern,
+	const wchar_t* firstSearchString,
+	const wchar_t* secondSearchString,
+	uint32_t maxDistance,
+	SearchFlags searchFlags,
+	uint64_t ignoreFilesLargerThan,
+	uint64_t maxResults,
+	uint64_t maxReadBytesPerSecond,
+	uint32_t maxReadsPerSecond,
+	void* callbackContext)
+{
+	// Proximity is only meaningful in file contents
+	searchFlags &= ~(SearchFlags::kSearchInFileName | SearchFlags::kSearchInFilePath | SearchFlags::kSearchForDirectories | SearchFlags::kSearchInDirectoryName | SearchFlags::kSearchInDirectoryPath);
+	searchFlags |= SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchForProximity;
+
+	if ((searchFlags & (SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSearchContentsAsUtf16)) == SearchFlags::kNone)
+		searchFlags |= SearchFlags::kSearchContentsAsUtf8;
+
+	SearchInstructions searchInstructions(foundPathCallback, progressUpdatedCallback, searchDoneCallback, errorCallback, searchPath, searchPattern, firstSearchString, searchFlags, ignoreFilesLargerThan, maxResults, maxReadBytesPerSecond, maxReadsPerSecond, callbackContext);
+	searchInstructions.proximitySearchString = secondSearchString;
+	searchInstructions.maxProximityDistance = maxDistance;
+
+	return FileSearcher::BeginSearch(std::move(searchInstructions));
 }
 
 extern "C" void CleanupSearchOperation(FileSearcher* searcher)
 {
 	searcher->Cleanup();
+}
+
+extern "C" void SetSearchReadRateLimit(FileSearcher* searcher, uint64_t maxBytesPerSecond, uint32_t maxReadsPerSecond)
+{
+	searcher->SetReadRateLimit(maxBytesPerSecond, maxReadsPerSecond);
+}
+
+extern "C" void SetReadChunkSizeOverride(uint32_t chunkSize)
+{
+	ReadChunkPolicy::SetChunkSizeOverride(chunkSize);
+}
+
+extern "C" void SetReadQueueDepthOverride(uint32_t queueDepth)
+{
+	ReadChunkPolicy::SetQueueDepthOverride(queueDepth);
+}
+
+extern "C" BufferSearcher* CreateBufferSearcher(const wchar_t* searchString, SearchFlags searchFlags)
+{
+	return BufferSearcher::Create(searchString, searchFlags);
+}
+
+extern "C" void SearchBuffers(BufferSearcher* bufferSearcher, const SearchBuffer* buffers, uint32_t bufferCount, bool* matches)
+{
+	bufferSearcher->SearchBuffers(buffers, bufferCount, matches);
+}
+
+extern "C" void FreeBufferSearcher(BufferSearcher* bufferSearcher)
+{
+	delete bufferSearcher;
+}
+
+extern "C" StreamSearcher* CreateStreamSearcher(const wchar_t* searchString, SearchFlags searchFlags, StreamMatchCallback matchCallback, void* callbackContext)
+{
+	return StreamSearcher::Create(searchString, searchFlags, matchCallback, callbackContext);
+}
+
+extern "C" void FeedStreamSearcher(StreamSearcher* streamSearcher, const uint8_t* bytes, size_t byteCount)
+{
+	streamSearcher->Feed(bytes, byteCount);
+}
+
+extern "C" void ResetStreamSearcher(StreamSearcher* streamSearcher)
+{
+	streamSearcher->Reset();
+}
+
+extern "C" void FreeStreamSearcher(StreamSearcher* streamSearcher)
+{
+	delete streamSearcher;
 }
\ No newline at end of file
@@ -9,28 +9,47 @@ struct SearchInstructions
 	SearchProgressUpdated onProgressUpdated;
 	SearchDoneCallback onDone;
 	ErrorCallback onError;
+	DictionaryMatchesCallback onDictionaryMatches;
 
 	std::wstring searchPath;
 	std::wstring searchPattern;
 	std::wstring searchString;
 	std::string utf8SearchString;
 
+	// Dictionary searches look for any of the entries in this file instead of searchString
+	std::wstring dictionaryPath;
+	std::string dictionaryContents;
+
+	// Proximity searches look for searchString and this starting no more than maxProximityDistance bytes apart
+	std::wstring proximitySearchString;
+
 	SearchFlags searchFlags;
 	uint64_t ignoreFilesLargerThan;
+	uint64_t maxResults;
+	uint32_t maxProximityDistance;
+
+	// Limits the content reads start out with. SetSearchReadRateLimit can change them afterwards
+	uint64_t maxReadBytesPerSecond;
+	uint32_t maxReadsPerSecond;
 
 	void* callbackContext;
 
 	SearchInstructions(FoundPathCallback foundPathCallback, SearchProgressUpdated progressUpdatedCallback, SearchDoneCallback searchDoneCallback, ErrorCallback errorCallback, const wchar_t* searchPath, const wchar_t* searchPattern, const wchar_t* searchString,
-		SearchFlags searchFlags, uint64_t ignoreFilesLargerThan, void* callbackContext) :
+		SearchFlags searchFlags, uint64_t ignoreFilesLargerThan, uint64_t maxResults, uint64_t maxReadBytesPerSecond, uint32_t maxReadsPerSecond, void* callbackContext) :
 		onFoundPath(foundPathCallback),
 		onProgressUpdated(progressUpdatedCallback),
 		onDone(searchDoneCallback),
 		onError(errorCallback),
+		onDictionaryMatches(nullptr),
 		searchPath(searchPath),
 		searchPattern(searchPattern),
 		searchString(searchString),
 		searchFlags(searchFlags),
 		ignoreFilesLargerThan(ignoreFilesLargerThan),
+		maxResults(maxResults),
+		maxProximityDistance(0),
+		maxReadBytesPerSecond(maxReadBytesPerSecond),
+		maxReadsPerSecond(maxReadsPerSecond),
 		callbackContext(callbackContext)
 	{
 		if (StringUtils::IsAscii(this->searchString))
@@ -50,12 +69,20 @@ struct SearchInstructions
 		onProgressUpdated(other.onProgressUpdated),
 		onDone(other.onDone),
 		onError(other.onError),
+		onDictionaryMatches(other.onDictionaryMatches),
 		searchPath(std::move(other.searchPath)),
 		searchPattern(std::move(other.searchPattern)),
 		searchString(std::move(other.searchString)),
 		utf8SearchString(std::move(other.utf8SearchString)),
+		dictionaryPath(std::move(other.dictionaryPath)),
+		dictionaryContents(std::move(other.dictionaryContents)),
+		proximitySearchString(std::move(other.proximitySearchString)),
 		searchFlags(other.searchFlags),
 		ignoreFilesLargerThan(other.ignoreFilesLargerThan),
+		maxResults(other.maxResults),
+		maxProximityDistance(other.maxProximityDistance),
+		maxReadBytesPerSecond(other.maxReadBytesPerSecond),
+		maxReadsPerSecond(other.maxReadsPerSecond),
 		callbackContext(other.callbackContext)
 	{
 	}
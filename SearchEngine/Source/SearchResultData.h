@@ -7,6 +7,7 @@ struct SearchResultData : NonCopyable
 {
 	std::wstring resultPath;
 	FileFindData resultFindData;
+	std::vector<uint32_t> dictionaryMatches;
 
 	SearchResultData()
 	{
@@ -18,9 +19,17 @@ struct SearchResultData : NonCopyable
 	{
 	}
 
+	SearchResultData(std::wstring&& resultPath, const FileFindData& resultFindData, std::vector<uint32_t>&& dictionaryMatches) :
+		resultPath(std::move(resultPath)),
+		resultFindData(resultFindData),
+		dictionaryMatches(std::move(dictionaryMatches))
+	{
+	}
+
 	SearchResultData(SearchResultData&& other) :
 		resultPath(std::move(other.resultPath)),
-		resultFindData(other.resultFindData)
+		resultFindData(other.resultFindData),
+		dictionaryMatches(std::move(other.dictionaryMatches))
 	{
 	}
 
@@ -28,6 +37,7 @@ struct SearchResultData : NonCopyable
 	{
 		resultPath = std::move(other.resultPath);
 		resultFindData = other.resultFindData;
+		dictionaryMatches = std::move(other.dictionaryMatches);
 		return *this;
 	}
 };
\ No newline at end of file
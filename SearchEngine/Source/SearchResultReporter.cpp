@@ -6,7 +6,10 @@ SearchResultReporter::SearchResultReporter(const SearchInstructions& searchInstr
 	m_FoundPathCallback(searchInstructions.onFoundPath),
     m_ProgressCallback(searchInstructions.onProgressUpdated),
     m_DoneCallback(searchInstructions.onDone),
-	m_CallbackContext(searchInstructions.callbackContext)
+	m_DictionaryMatchesCallback(searchInstructions.onDictionaryMatches),
+	m_CallbackContext(searchInstructions.callbackContext),
+	m_MaxResults(searchInstructions.maxResults),
+	m_HasReachedResultLimit(searchInstructions.maxResults == 0)
 {
 	ZeroMemory(&m_SearchStatistics, sizeof(m_SearchStatistics));
 
@@ -24,8 +27,9 @@ void SearchResultReporter::ReportProgress(bool finishedScanningFileSystem)
 	// Some glitches in the statistics should be okay, as you can't really tell just by looking at them if they're correct or not
 	auto statisticsSnapshot = m_SearchStatistics;
 
+	// Skipped binary files were not scanned, but we're done with them all the same
 	double progress = finishedScanningFileSystem
-		? static_cast<double>(statisticsSnapshot.scannedFileSize) / static_cast<double>(statisticsSnapshot.totalFileSize)
+		? static_cast<double>(statisticsSnapshot.scannedFileSize + statisticsSnapshot.binaryFileSizeSkipped) / static_cast<double>(statisticsSnapshot.totalFileSize)
 		: sqrt(-1); // indeterminate
 
 	statisticsSnapshot.searchTimeInSeconds = GetTotalSearchTimeInSeconds();
@@ -56,11 +60,49 @@ void SearchResultReporter::InitializeSearchResultDispatcherWorkerThread()
 	{
 		auto win32FindData = searchResult.resultFindData.ToWin32FindData(PathUtils::GetFileName(searchResult.resultPath));
 		m_FoundPathCallback(m_CallbackContext, win32FindData, searchResult.resultPath.c_str());
+
+		if (!searchResult.dictionaryMatches.empty() && m_DictionaryMatchesCallback != nullptr)
+			m_DictionaryMatchesCallback(m_CallbackContext, searchResult.resultPath.c_str(), searchResult.dictionaryMatches.data(), static_cast<uint32_t>(searchResult.dictionaryMatches.size()));
 	});
 }
 
+bool SearchResultReporter::ReserveResultSlot()
+{
+	// Several threads may race for the last few result slots, so reserve one first and give it back if we overshot
+	auto resultsFound = InterlockedIncrement(&m_SearchStatistics.resultsFound);
+	if (resultsFound > m_MaxResults)
+	{
+		InterlockedDecrement(&m_SearchStatistics.resultsFound);
+		return false;
+	}
+
+	if (resultsFound == m_MaxResults)
+		m_HasReachedResultLimit = true;
+
+	return true;
+}
+
 void SearchResultReporter::DispatchSearchResult(const FileFindData& findData, std::wstring&& path)
 {
-    InterlockedIncrement(&m_SearchStatistics.resultsFound);
-	PushWorkItem(std::forward<std::wstring>(path), findData);
+	if (ReserveResultSlot())
+		PushWorkItem(std::forward<std::wstring>(path), findData);
+}
+
+void SearchResultReporter::DispatchDictionarySearchResult(const FileFindData& findData, std::wstring&& path, std::vector<uint32_t>&& dictionaryMatches)
+{
+	if (!ReserveResultSlot())
+		return;
+
+	// Overlapping chunks and repeated occurrences report the same entry many times
+	std::sort(dictionaryMatches.begin(), dictionaryMatches.end());
+	dictionaryMatches.erase(std::unique(dictionaryMatches.begin(), dictionaryMatches.end()), dictionaryMatches.end());
+
+	PushWorkItem(std::forward<std::wstring>(path), findData, std::move(dictionaryMatches));
+}
+
+void SearchResultReporter::OnDictionaryBuilt(uint64_t entryCount, uint64_t memoryUsage, double buildTimeInSeconds)
+{
+	m_SearchStatistics.dictionaryEntryCount = entryCount;
+	m_SearchStatistics.dictionaryMemoryUsage = memoryUsage;
+	m_SearchStatistics.dictionaryBuildTimeInSeconds = buildTimeInSeconds;
 }
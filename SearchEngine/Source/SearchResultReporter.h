@@ -11,6 +11,8 @@ public:
 
     void ReportProgress(bool finishedScanningFileSystem);
     void DispatchSearchResult(const FileFindData& findData, std::wstring&& path);
+    void DispatchDictionarySearchResult(const FileFindData& findData, std::wstring&& path, std::vector<uint32_t>&& dictionaryMatches);
+    void OnDictionaryBuilt(uint64_t entryCount, uint64_t memoryUsage, double buildTimeInSeconds);
     void FinishSearch();
 
     inline void DrainWorkQueue() { MyBase::DrainWorkQueue(); }
@@ -18,14 +20,22 @@ public:
 
     inline void AddToScannedFileSize(int64_t size) { InterlockedAdd64(&m_SearchStatistics.scannedFileSize, size); }
     inline void AddToScannedFileCount() { InterlockedIncrement(&m_SearchStatistics.fileContentsSearched); }
+    inline void OnFileBytesRead(int64_t size, bool servedFromCache) { InterlockedAdd64(servedFromCache ? &m_SearchStatistics.bytesReadFromCache : &m_SearchStatistics.bytesReadFromDisk, size); }
+    inline void OnCompressedFileSearched(int64_t compressedSize, int64_t decompressedSize) { InterlockedAdd64(&m_SearchStatistics.compressedFileSize, compressedSize); InterlockedAdd64(&m_SearchStatistics.decompressedFileSize, decompressedSize); }
+    inline void OnBinaryFileSkipped(int64_t skippedSize) { InterlockedIncrement(&m_SearchStatistics.binaryFilesSkipped); InterlockedAdd64(&m_SearchStatistics.binaryFileSizeSkipped, skippedSize); }
     inline void OnDirectoryEnumeratedThreadUnsafe() { m_SearchStatistics.directoriesEnumerated++; }
     inline void OnFileEnumeratedThreadUnsafe() { m_SearchStatistics.filesEnumerated++; }
     inline void OnTotalFileSizeAddedThreadUnsafe(uint64_t value) { m_SearchStatistics.totalFileSize += value; }
+    inline void OnMaxDeviceReadsInFlightThreadUnsafe(uint64_t value) { m_SearchStatistics.maxDeviceReadsInFlight = std::max(m_SearchStatistics.maxDeviceReadsInFlight, value); }
+
+    // Once this returns true, any further results are dropped. Producers should stop as soon as they notice it
+    inline bool HasReachedResultLimit() const { return m_HasReachedResultLimit; }
 
 private:
     typedef ThreadedWorkQueue<SearchResultReporter, SearchResultData> MyBase;
     friend class MyBase;
 
+    bool ReserveResultSlot();
     double GetTotalSearchTimeInSeconds();
     void InitializeSearchResultDispatcherWorkerThread();
 
@@ -34,7 +44,10 @@ private:
     FoundPathCallback m_FoundPathCallback;
     SearchProgressUpdated m_ProgressCallback;
     SearchDoneCallback m_DoneCallback;
+    DictionaryMatchesCallback m_DictionaryMatchesCallback;
     void* m_CallbackContext;
+    const uint64_t m_MaxResults;
+    std::atomic<bool> m_HasReachedResultLimit;
 
     LARGE_INTEGER m_SearchStart;
     LARGE_INTEGER m_PerformanceFrequency;
@@ -0,0 +1,182 @@
+#include "PrecompiledHeader.h"
+#include "DictionaryMatcher.h"
+
+#include <bit>
+
+// Once the cells we scan past while looking for a free base are this densely packed, later searches start after them
+constexpr size_t kDenseCellPercentage = 95;
+
+// The k-gram filter gets this many bits per entry, within the limits below, to keep false positives rare without outgrowing the cache
+constexpr size_t kFilterBitsPerEntry = 16;
+constexpr uint32_t kMinFilterHashBits = 16;
+constexpr uint32_t kMaxFilterHashBits = 25;
+
+constexpr int32_t kUnusedCell = -1;
+
+DictionaryMatcher::DictionaryMatcher() :
+	m_KGramLength(0),
+	m_FilterHashBits(kMinFilterHashBits),
+	m_MaxEntryLength(0),
+	m_NextCheckPosition(0)
+{
+}
+
+void DictionaryMatcher::Build(std::vector<Entry>&& entries)
+{
+	std::erase_if(entries, [](const Entry& entry) { return entry.bytes.empty(); });
+	if (entries.empty())
+		return;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right)
+	{
+		if (left.bytes != right.bytes)
+			return left.bytes < right.bytes;
+
+		return left.index < right.index;
+	});
+
+	auto duplicates = std::unique(entries.begin(), entries.end(), [](const Entry& left, const Entry& right) { return left.bytes == right.bytes; });
+	entries.erase(duplicates, entries.end());
+
+	size_t minEntryLength = std::numeric_limits<size_t>::max();
+	for (const auto& entry : entries)
+	{
+		minEntryLength = std::min(minEntryLength, entry.bytes.size());
+		m_MaxEntryLength = std::max(m_MaxEntryLength, entry.bytes.size());
+	}
+
+	m_KGramLength = std::min(kMaxKGramLength, minEntryLength);
+	m_FilterHashBits = std::clamp(static_cast<uint32_t>(std::bit_width(entries.size() * kFilterBitsPerEntry)), kMinFilterHashBits, kMaxFilterHashBits);
+	m_KGramFilter.assign((1ULL << m_FilterHashBits) / 64, 0);
+
+	for (const auto& entry : entries)
+	{
+		auto hash = HashKGram(LoadKGram(reinterpret_cast<const uint8_t*>(entry.bytes.data())));
+		m_KGramFilter[hash / 64] |= 1ULL << (hash % 64);
+	}
+
+	// Sorted entries sharing a prefix are contiguous, so every trie node is just a range of entries at some depth
+	struct PendingNode
+	{
+		int32_t state;
+		uint32_t first;
+		uint32_t last;
+		uint32_t depth;
+	};
+
+	ReserveCells(entries.size() + 256);
+	m_Cells[0].check = 0; // The root is never anyone's child
+
+	std::vector<PendingNode> pendingNodes;
+	std::vector<uint8_t> labels;
+	std::vector<uint32_t> childRanges;
+	pendingNodes.push_back({ 0, 0, static_cast<uint32_t>(entries.size()), 0 });
+
+	while (!pendingNodes.empty())
+	{
+		auto node = pendingNodes.back();
+		pendingNodes.pop_back();
+
+		// An entry that ends here sorts before all the longer ones sharing its prefix
+		if (entries[node.first].bytes.size() == node.depth)
+			m_Outputs[node.state] = static_cast<int32_t>(entries[node.first++].index);
+
+		if (node.first == node.last)
+			continue;
+
+		labels.clear();
+		childRanges.clear();
+
+		for (auto i = node.first; i < node.last; i++)
+		{
+			auto label = static_cast<uint8_t>(entries[i].bytes[node.depth]);
+			if (labels.empty() || labels.back() != label)
+			{
+				labels.push_back(label);
+				childRanges.push_back(i);
+			}
+		}
+
+		childRanges.push_back(node.last);
+
+		auto base = FindFreeBase(labels);
+		m_Cells[node.state].base = static_cast<int32_t>(base);
+
+		for (size_t i = 0; i < labels.size(); i++)
+		{
+			auto childState = static_cast<int32_t>(base + labels[i]);
+			m_Cells[childState].check = node.state;
+			pendingNodes.push_back({ childState, childRanges[i], childRanges[i + 1], node.depth + 1 });
+		}
+	}
+
+	size_t usedCellCount = m_Cells.size();
+	while (usedCellCount > 0 && m_Cells[usedCellCount - 1].check == kUnusedCell)
+		usedCellCount--;
+
+	m_Cells.resize(usedCellCount);
+	m_Cells.shrink_to_fit();
+	m_Outputs.resize(usedCellCount);
+	m_Outputs.shrink_to_fit();
+}
+
+uint32_t DictionaryMatcher::FindFreeBase(const std::vector<uint8_t>& labels)
+{
+	const size_t firstPosition = std::max<size_t>(m_NextCheckPosition, labels.front() + 1u);
+	size_t occupiedCellCount = 0;
+	size_t position = firstPosition;
+	size_t base;
+
+	for (;; position++)
+	{
+		ReserveCells(position + 1);
+
+		if (m_Cells[position].check != kUnusedCell)
+		{
+			occupiedCellCount++;
+			continue;
+		}
+
+		base = position - labels.front();
+		ReserveCells(base + labels.back() + 1);
+
+		bool allChildrenFit = true;
+		for (size_t i = 1; i < labels.size() && allChildrenFit; i++)
+			allChildrenFit = m_Cells[base + labels[i]].check == kUnusedCell;
+
+		if (allChildrenFit)
+			break;
+	}
+
+	if (100 * occupiedCellCount >= kDenseCellPercentage * (position - firstPosition + 1))
+		m_NextCheckPosition = position;
+
+	if (base > static_cast<size_t>(std::numeric_limits<int32_t>::max() - 256))
+		__fastfail(1);
+
+	return static_cast<uint32_t>(base);
+}
+
+void DictionaryMatcher::ReserveCells(size_t cellCount)
+{
+	if (cellCount <= m_Cells.size())
+		return;
+
+	auto newSize = std::max(cellCount, 2 * m_Cells.size());
+	m_Cells.resize(newSize, Cell{ 0, kUnusedCell });
+	m_Outputs.resize(newSize, kNoOutput);
+}
+
+void DictionaryMatcher::FindMatches(const uint8_t* text, size_t textLength, std::vector<uint32_t>& matchedEntries) const
+{
+	ForEachMatch(text, textLength, textLength, [&matchedEntries](uint32_t entryIndex, size_t)
+	{
+		matchedEntries.push_back(entryIndex);
+		return false;
+	});
+}
+
+size_t DictionaryMatcher::GetMemoryUsage() const
+{
+	return m_Cells.capacity() * sizeof(Cell) + m_Outputs.capacity() * sizeof(int32_t) + m_KGramFilter.capacity() * sizeof(uint64_t);
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "NonCopyable.h"
+
+// Finds every occurrence of any of a large set of literals in one pass over the text.
+// The literals are stored as bytes in a double-array trie, so each transition is a single lookup in one array of cells.
+// Walking the trie from every text position would still be slow, so a bitmap of hashed k-grams (k being up to 8 bytes,
+// and no longer than the shortest literal) sits in front of it and rejects most positions without touching the trie.
+// Built once per search and only read afterwards, so all content search threads share it.
+class DictionaryMatcher : NonCopyable
+{
+public:
+	struct Entry
+	{
+		std::string_view bytes;
+		uint32_t index;
+	};
+
+	DictionaryMatcher();
+
+	// Entries with identical bytes are merged and reported under the lowest index
+	void Build(std::vector<Entry>&& entries);
+
+	// Appends indices of entries found in the text to matchedEntries. The same index can be appended more than once
+	void FindMatches(const uint8_t* text, size_t textLength, std::vector<uint32_t>& matchedEntries) const;
+
+	// Calls onMatch(entryIndex, matchOffset) for every match starting before startLimit, in order of their offsets, until it returns true.
+	// Returns whether onMatch stopped the scan
+	template <typename OnMatch>
+	bool ForEachMatch(const uint8_t* text, size_t textLength, size_t startLimit, OnMatch&& onMatch) const
+	{
+		if (IsEmpty() || textLength < m_KGramLength)
+			return false;
+
+		const auto cells = m_Cells.data();
+		const auto cellCount = static_cast<uint32_t>(m_Cells.size());
+		const auto lastStart = std::min(textLength - m_KGramLength + 1, startLimit);
+		const auto kGramMask = m_KGramLength == sizeof(uint64_t) ? ~0ull : (1ull << (8 * m_KGramLength)) - 1;
+
+		for (size_t i = 0; i < lastStart; i++)
+		{
+			uint64_t kGram;
+			if (textLength - i >= sizeof(uint64_t))
+			{
+				memcpy(&kGram, text + i, sizeof(uint64_t));
+				kGram &= kGramMask;
+			}
+			else
+			{
+				kGram = LoadKGram(text + i);
+			}
+
+			auto hash = HashKGram(kGram);
+			if ((m_KGramFilter[hash / 64] & (1ULL << (hash % 64))) == 0)
+				continue;
+
+			int32_t state = 0;
+			for (size_t j = i; j < textLength; j++)
+			{
+				auto nextState = static_cast<uint32_t>(cells[state].base) + text[j];
+				if (nextState >= cellCount || cells[nextState].check != state)
+					break;
+
+				state = static_cast<int32_t>(nextState);
+
+				if (m_Outputs[state] != kNoOutput && onMatch(static_cast<uint32_t>(m_Outputs[state]), i))
+					return true;
+			}
+		}
+
+		return false;
+	}
+
+	inline bool IsEmpty() const { return m_Cells.empty(); }
+	inline size_t GetMaxEntryLength() const { return m_MaxEntryLength; }
+	size_t GetMemoryUsage() const;
+
+private:
+	struct Cell
+	{
+		int32_t base;
+		int32_t check;
+	};
+
+	static constexpr size_t kMaxKGramLength = 8;
+	static constexpr int32_t kNoOutput = -1;
+
+	inline uint32_t HashKGram(uint64_t kGram) const
+	{
+		return static_cast<uint32_t>((kGram * 0x9E3779B97F4A7C15ull) >> (64 - m_FilterHashBits));
+	}
+
+	inline uint64_t LoadKGram(const uint8_t* bytes) const
+	{
+		uint64_t kGram = 0;
+		memcpy(&kGram, bytes, m_KGramLength);
+		return kGram;
+	}
+
+	uint32_t FindFreeBase(const std::vector<uint8_t>& labels);
+	void ReserveCells(size_t cellCount);
+
+private:
+	std::vector<Cell> m_Cells;
+	std::vector<int32_t> m_Outputs;
+	std::vector<uint64_t> m_KGramFilter;
+	size_t m_KGramLength;
+	uint32_t m_FilterHashBits;
+	size_t m_MaxEntryLength;
+	size_t m_NextCheckPosition;
+};
\ No newline at end of file
@@ -63,27 +63,38 @@ public:
 		PrecomputeMaps();
 	}
 
+	inline uint32_t GetPatternLength() const { return m_PatternLength; }
+
+	// Returns where the first occurrence starts, or textEnd if there is none
 	template <typename TextIterator>
-	bool HasSubstring(TextIterator textBegin, TextIterator textEnd) const
+	TextIterator FindSubstring(TextIterator textBegin, TextIterator textEnd) const
 	{
 		for (;;)
 		{
 			if (textEnd - textBegin < m_PatternLength)
-				return false;
+				return textEnd;
 
+			// Text and pattern can disagree on signedness, so both are compared as unsigned characters
 			uint32_t i = m_PatternLength - 1;
-			while (i != 0 && textBegin[i] == m_Pattern[i])
+			while (i != 0 && static_cast<UnsignedCharType>(textBegin[i]) == static_cast<UnsignedCharType>(m_Pattern[i]))
 				i--;
 
-			if (textBegin[i] == m_Pattern[i])
-				return true;
+			auto textCharacter = static_cast<UnsignedCharType>(textBegin[i]);
+			if (textCharacter == static_cast<UnsignedCharType>(m_Pattern[i]))
+				return textBegin;
 
-			uint32_t shiftAmount = std::max(m_LastCharacterOccurenceMap[textBegin[i]], m_NextSuffixOffset[i]);
+			uint32_t shiftAmount = std::max(m_LastCharacterOccurenceMap[textCharacter], m_NextSuffixOffset[i]);
 			shiftAmount -= m_PatternLength - i - 1;
 			if (textEnd - textBegin < static_cast<int32_t>(shiftAmount))
-				return false;
+				return textEnd;
 
 			textBegin += shiftAmount;
 		}
 	}
+
+	template <typename TextIterator>
+	inline bool HasSubstring(TextIterator textBegin, TextIterator textEnd) const
+	{
+		return FindSubstring(textBegin, textEnd) != textEnd;
+	}
 };
\ No newline at end of file
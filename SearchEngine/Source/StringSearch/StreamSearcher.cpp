@@ -0,0 +1,152 @@
+#include "PrecompiledHeader.h"
+#include "StreamSearcher.h"
+#include "StringUtils.h"
+
+// Case insensitive searches fold and search the input this many bytes at a time
+constexpr size_t kFoldBlockSize = 64 * 1024;
+
+StreamSearcher* StreamSearcher::Create(const wchar_t* searchString, SearchFlags searchFlags, StreamMatchCallback matchCallback, void* callbackContext)
+{
+	std::wstring_view searchStringView(searchString);
+	if (searchStringView.empty() || searchStringView.length() > 1024)
+		return nullptr;
+
+	if ((searchFlags & SearchFlags::kIgnoreCase) != SearchFlags::kNone && !StringUtils::IsAscii(std::wstring(searchStringView)))
+		return nullptr;
+
+	return new StreamSearcher(searchStringView, searchFlags, matchCallback, callbackContext);
+}
+
+StreamSearcher::StreamSearcher(std::wstring_view searchString, SearchFlags searchFlags, StreamMatchCallback matchCallback, void* callbackContext) :
+	m_PatternCount(0),
+	m_IgnoreCase((searchFlags & SearchFlags::kIgnoreCase) != SearchFlags::kNone),
+	m_CarriedLength(0),
+	m_MaxCarriedLength(0),
+	m_StreamOffset(0),
+	m_MatchCallback(matchCallback),
+	m_CallbackContext(callbackContext)
+{
+	std::wstring utf16SearchString(searchString);
+	if (m_IgnoreCase)
+		StringUtils::ToLowerAsciiInline(utf16SearchString);
+
+	if ((searchFlags & (SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSearchContentsAsUtf16)) == SearchFlags::kNone)
+		searchFlags |= SearchFlags::kSearchContentsAsUtf8;
+
+	if ((searchFlags & SearchFlags::kSearchContentsAsUtf8) != SearchFlags::kNone)
+	{
+		auto& pattern = m_Patterns[m_PatternCount++];
+		pattern.bytes = StringUtils::Utf16ToUtf8(utf16SearchString);
+		pattern.alignment = 1;
+	}
+
+	if ((searchFlags & SearchFlags::kSearchContentsAsUtf16) != SearchFlags::kNone)
+	{
+		auto& pattern = m_Patterns[m_PatternCount++];
+		pattern.bytes.assign(reinterpret_cast<const char*>(utf16SearchString.data()), utf16SearchString.length() * sizeof(wchar_t));
+		pattern.alignment = sizeof(wchar_t);
+	}
+
+	for (uint32_t i = 0; i < m_PatternCount; i++)
+	{
+		auto& pattern = m_Patterns[i];
+		pattern.searcher.Initialize(pattern.bytes.data(), pattern.bytes.length());
+
+		// An occurrence that isn't wholly inside one chunk starts within the last patternLength - 1 bytes before it
+		m_MaxCarriedLength = std::max(m_MaxCarriedLength, pattern.bytes.length() - 1);
+	}
+
+	m_SeamBuffer.reset(new uint8_t[2 * m_MaxCarriedLength + 1]);
+
+	if (m_IgnoreCase)
+		m_FoldBuffer.reset(new uint8_t[kFoldBlockSize]);
+}
+
+void StreamSearcher::Feed(const uint8_t* bytes, size_t byteCount)
+{
+	if (!m_IgnoreCase)
+	{
+		SearchBlock(bytes, byteCount);
+	}
+	else
+	{
+		for (size_t offset = 0; offset < byteCount; offset += kFoldBlockSize)
+		{
+			auto blockLength = std::min(kFoldBlockSize, byteCount - offset);
+			StringUtils::ToLowerAscii(bytes + offset, m_FoldBuffer.get(), blockLength);
+			SearchBlock(m_FoldBuffer.get(), blockLength);
+		}
+	}
+
+	// Occurrences of the UTF-8 and UTF-16 patterns are found separately
+	if (m_PatternCount > 1)
+		std::sort(m_MatchOffsets.begin(), m_MatchOffsets.end());
+
+	for (auto matchOffset : m_MatchOffsets)
+		m_MatchCallback(m_CallbackContext, matchOffset);
+
+	m_MatchOffsets.clear();
+}
+
+void StreamSearcher::Reset()
+{
+	m_CarriedLength = 0;
+	m_StreamOffset = 0;
+}
+
+void StreamSearcher::SearchBlock(const uint8_t* block, size_t blockLength)
+{
+	if (blockLength == 0)
+		return;
+
+	auto seam = m_SeamBuffer.get();
+	auto seamLength = m_CarriedLength + std::min(blockLength, m_MaxCarriedLength);
+	memcpy(seam + m_CarriedLength, block, seamLength - m_CarriedLength);
+
+	for (uint32_t i = 0; i < m_PatternCount; i++)
+	{
+		const auto& pattern = m_Patterns[i];
+		const auto patternLength = pattern.bytes.length();
+
+		// Only look at occurrences that start in the carried bytes and end in this block, the rest are found without the seam
+		if (m_CarriedLength > 0)
+		{
+			auto searchBegin = m_CarriedLength - std::min(m_CarriedLength, patternLength - 1);
+			auto searchEnd = std::min(seamLength, m_CarriedLength + patternLength - 1);
+			FindMatches(pattern, seam, searchBegin, searchEnd, m_StreamOffset - m_CarriedLength);
+		}
+
+		FindMatches(pattern, block, 0, blockLength, m_StreamOffset);
+	}
+
+	if (blockLength >= m_MaxCarriedLength)
+	{
+		memcpy(seam, block + blockLength - m_MaxCarriedLength, m_MaxCarriedLength);
+		m_CarriedLength = m_MaxCarriedLength;
+	}
+	else
+	{
+		// The whole block is in the seam buffer already, so only its oldest bytes need to go
+		auto keptLength = std::min(seamLength, m_MaxCarriedLength);
+		memmove(seam, seam + seamLength - keptLength, keptLength);
+		m_CarriedLength = keptLength;
+	}
+
+	m_StreamOffset += blockLength;
+}
+
+void StreamSearcher::FindMatches(const Pattern& pattern, const uint8_t* text, size_t searchBegin, size_t searchEnd, uint64_t textOffset)
+{
+	const auto textEnd = text + searchEnd;
+
+	for (auto position = text + searchBegin; position < textEnd; position++)
+	{
+		position = pattern.searcher.FindSubstring(position, textEnd);
+		if (position == textEnd)
+			break;
+
+		auto matchOffset = textOffset + (position - text);
+		if (matchOffset % pattern.alignment == 0)
+			m_MatchOffsets.push_back(matchOffset);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "NonCopyable.h"
+#include "OrdinalStringSearcher.h"
+#include "SearchEngineTypes.h"
+
+// Searches a byte stream that arrives in chunks of any size, such as a pipe, a socket or decompressor output.
+// The last few bytes of each chunk are kept so that occurrences straddling two chunks are still found, without the caller
+// having to buffer or overlap anything. Every occurrence is reported once, with its offset from the start of the stream.
+class StreamSearcher : NonCopyable
+{
+public:
+	// Returns nullptr for search strings this can't look for: empty ones, ones longer than 1024 characters,
+	// and non-ASCII ones with kIgnoreCase, since case folding happens a byte at a time
+	static StreamSearcher* Create(const wchar_t* searchString, SearchFlags searchFlags, StreamMatchCallback matchCallback, void* callbackContext);
+
+	void Feed(const uint8_t* bytes, size_t byteCount);
+	void Reset();
+
+	inline uint64_t GetStreamOffset() const { return m_StreamOffset; }
+
+private:
+	struct Pattern
+	{
+		std::string bytes;
+		OrdinalStringSearcher<char> searcher;
+
+		// UTF-16 occurrences only count at even stream offsets
+		uint32_t alignment;
+	};
+
+	StreamSearcher(std::wstring_view searchString, SearchFlags searchFlags, StreamMatchCallback matchCallback, void* callbackContext);
+
+	void SearchBlock(const uint8_t* block, size_t blockLength);
+	void FindMatches(const Pattern& pattern, const uint8_t* text, size_t searchBegin, size_t searchEnd, uint64_t textOffset);
+
+private:
+	Pattern m_Patterns[2];
+	uint32_t m_PatternCount;
+	bool m_IgnoreCase;
+
+	// Holds the bytes carried over from earlier chunks followed by the start of the current one
+	std::unique_ptr<uint8_t[]> m_SeamBuffer;
+	size_t m_CarriedLength;
+	size_t m_MaxCarriedLength;
+
+	// Case insensitive searches fold the input here rather than modifying it
+	std::unique_ptr<uint8_t[]> m_FoldBuffer;
+
+	std::vector<uint64_t> m_MatchOffsets;
+	uint64_t m_StreamOffset;
+
+	StreamMatchCallback m_MatchCallback;
+	void* m_CallbackContext;
+};
\ No newline at end of file
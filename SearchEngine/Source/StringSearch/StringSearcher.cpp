@@ -4,9 +4,27 @@
 #include "Utilities/PathUtils.h"
 #include "Utilities/ScopedStackAllocator.h"
 
+// Whitespace runs in the text can be arbitrarily long within a chunk, but only runs up to this long are found when they straddle a seam
+constexpr size_t kMaxWhitespaceRunLengthAcrossChunks = 256;
+
 StringSearcher::StringSearcher(const SearchInstructions& searchInstructions) :
-	m_SearchInstructions(searchInstructions)
+	m_SearchInstructions(searchInstructions),
+	m_DictionaryEntryCount(0),
+	m_DictionaryBuildTimeInSeconds(0),
+	m_ProximityTermsAreEqual(false)
 {
+	if (searchInstructions.SearchForDictionaryEntries())
+	{
+		BuildDictionary();
+		return;
+	}
+
+	if (searchInstructions.SearchForProximity())
+	{
+		BuildProximityTerms();
+		return;
+	}
+
 	// Sanity checks
 	if (searchInstructions.searchString.length() == 0)
 		__fastfail(1);
@@ -21,6 +39,134 @@ StringSearcher::StringSearcher(const SearchInstructions& searchInstructions) :
 
 	if (searchInstructions.SearchInFileContents() && searchInstructions.SearchContentsAsUtf8())
 		m_OrdinalUtf8Searcher.Initialize(searchInstructions.utf8SearchString.c_str(), searchInstructions.utf8SearchString.length());
+
+	if (searchInstructions.SearchInFileContents() && searchInstructions.IgnoreWhitespace())
+	{
+		if (searchInstructions.SearchContentsAsUtf8())
+			m_WhitespaceInsensitiveUtf8Searcher.Initialize(searchInstructions.utf8SearchString.c_str(), searchInstructions.utf8SearchString.length());
+
+		if (searchInstructions.SearchStringIsAscii() || !searchInstructions.IgnoreCase())
+		{
+			m_WhitespaceInsensitiveUtf16Searcher.Initialize(searchInstructions.searchString.c_str(), searchInstructions.searchString.length());
+		}
+		else
+		{
+			// The whitespace insensitive matcher compares ordinally, so non-ASCII case insensitive searches run against lower cased text
+			m_LowerCaseSearchString = StringUtils::ToLowerUnicode(searchInstructions.searchString);
+			m_WhitespaceInsensitiveUtf16Searcher.Initialize(m_LowerCaseSearchString.c_str(), m_LowerCaseSearchString.length());
+		}
+	}
+}
+
+void StringSearcher::BuildDictionary()
+{
+	LARGE_INTEGER buildStart, buildEnd, performanceFrequency;
+	QueryPerformanceCounter(&buildStart);
+
+	// Case insensitive dictionary searches fold ASCII letters in both the entries and the text
+	std::string utf8Entries = m_SearchInstructions.dictionaryContents;
+	if (m_SearchInstructions.IgnoreCase())
+		StringUtils::ToLowerAscii(utf8Entries.data(), utf8Entries.data(), utf8Entries.length());
+
+	std::vector<DictionaryMatcher::Entry> entries;
+	std::wstring utf16Entries;
+	std::vector<std::pair<size_t, uint32_t>> utf16EntryRanges;
+
+	// Entries are transcoded straight into one buffer that can hold all of them
+	if (m_SearchInstructions.SearchContentsAsUtf16())
+		utf16Entries.resize(StringUtils::GetMaxUtf16Length(utf8Entries.length()));
+
+	size_t utf16EntriesLength = 0;
+
+	ForEachDictionaryEntry(utf8Entries, [this, &entries, &utf16Entries, &utf16EntriesLength, &utf16EntryRanges](std::string_view entry, uint32_t lineIndex)
+	{
+		m_DictionaryEntryCount++;
+
+		if (m_SearchInstructions.SearchContentsAsUtf8())
+			entries.push_back({ entry, lineIndex });
+
+		// UTF-16 text is matched byte for byte against the UTF-16 encoding of each entry, in the same trie
+		if (m_SearchInstructions.SearchContentsAsUtf16())
+		{
+			utf16EntryRanges.emplace_back(utf16EntriesLength, lineIndex);
+			utf16EntriesLength += StringUtils::Utf8ToUtf16(entry.data(), entry.length(), utf16Entries.data() + utf16EntriesLength);
+		}
+	});
+
+	for (size_t i = 0; i < utf16EntryRanges.size(); i++)
+	{
+		auto entryStart = utf16EntryRanges[i].first;
+		auto entryEnd = i + 1 < utf16EntryRanges.size() ? utf16EntryRanges[i + 1].first : utf16EntriesLength;
+		auto entryBytes = reinterpret_cast<const char*>(utf16Entries.data() + entryStart);
+		entries.push_back({ std::string_view(entryBytes, (entryEnd - entryStart) * sizeof(wchar_t)), utf16EntryRanges[i].second });
+	}
+
+	m_DictionaryMatcher.Build(std::move(entries));
+
+	QueryPerformanceCounter(&buildEnd);
+	QueryPerformanceFrequency(&performanceFrequency);
+	m_DictionaryBuildTimeInSeconds = static_cast<double>(buildEnd.QuadPart - buildStart.QuadPart) / static_cast<double>(performanceFrequency.QuadPart);
+}
+
+void StringSearcher::BuildProximityTerms()
+{
+	// Both terms go into one small dictionary, so a single pass over the text finds occurrences of either
+	auto firstTerm = m_SearchInstructions.searchString;
+	auto secondTerm = m_SearchInstructions.proximitySearchString;
+
+	if (m_SearchInstructions.IgnoreCase())
+	{
+		StringUtils::ToLowerAscii(firstTerm.data(), firstTerm.data(), firstTerm.length());
+		StringUtils::ToLowerAscii(secondTerm.data(), secondTerm.data(), secondTerm.length());
+	}
+
+	// The dictionary merges identical entries, so the second term would never be reported on its own
+	m_ProximityTermsAreEqual = firstTerm == secondTerm;
+
+	const std::string utf8Terms[] = { StringUtils::Utf16ToUtf8(firstTerm), StringUtils::Utf16ToUtf8(secondTerm) };
+	const std::wstring utf16Terms[] = { std::move(firstTerm), std::move(secondTerm) };
+	std::vector<DictionaryMatcher::Entry> entries;
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		if (m_SearchInstructions.SearchContentsAsUtf8())
+			entries.push_back({ utf8Terms[i], i });
+
+		if (m_SearchInstructions.SearchContentsAsUtf16())
+			entries.push_back({ std::string_view(reinterpret_cast<const char*>(utf16Terms[i].data()), utf16Terms[i].length() * sizeof(wchar_t)), i });
+	}
+
+	m_DictionaryMatcher.Build(std::move(entries));
+}
+
+bool StringSearcher::FindProximityMatch(uint8_t* fileBytes, uint32_t bufferLength, uint32_t searchedLength, uint64_t bufferFileOffset, ProximityWindow& window) const
+{
+	if (m_SearchInstructions.IgnoreCase())
+		StringUtils::ToLowerAscii(fileBytes, fileBytes, bufferLength);
+
+	const auto maxDistance = static_cast<int64_t>(m_SearchInstructions.maxProximityDistance);
+	const bool termsAreEqual = m_ProximityTermsAreEqual;
+
+	// Occurrences come in order of their offsets, so the other term's latest occurrence is the closest one so far. With both terms the same,
+	// that's the term's own previous occurrence
+	return m_DictionaryMatcher.ForEachMatch(fileBytes, bufferLength, searchedLength, [bufferFileOffset, maxDistance, termsAreEqual, &window](uint32_t term, size_t matchOffset)
+	{
+		auto termOffset = static_cast<int64_t>(bufferFileOffset + matchOffset);
+		if (termOffset - window.lastTermOffsets[termsAreEqual ? term : 1 - term] <= maxDistance)
+			return true;
+
+		window.lastTermOffsets[term] = termOffset;
+		return false;
+	});
+}
+
+void StringSearcher::FindDictionaryMatches(uint8_t* fileBytes, uint32_t bufferLength, std::vector<uint32_t>& matchedEntries) const
+{
+	// This folds bytes rather than characters, which for UTF-16 text can occasionally fold the low byte of a non-ASCII code unit
+	if (m_SearchInstructions.IgnoreCase())
+		StringUtils::ToLowerAscii(fileBytes, fileBytes, bufferLength);
+
+	m_DictionaryMatcher.FindMatches(fileBytes, bufferLength, matchedEntries);
 }
 
 bool StringSearcher::SearchForString(std::wstring_view str, ScopedStackAllocator& stackAllocator) const
@@ -43,11 +189,37 @@ bool StringSearcher::SearchForString(std::wstring_view str, ScopedStackAllocator
 	return m_OrdinalUtf16Searcher.HasSubstring(str.begin(), str.end());
 }
 
+bool StringSearcher::SearchUtf16FileContents(std::wstring_view str, ScopedStackAllocator& stackAllocator) const
+{
+	if (!m_SearchInstructions.IgnoreWhitespace())
+		return SearchForString(str, stackAllocator);
+
+	if (!m_SearchInstructions.IgnoreCase())
+		return m_WhitespaceInsensitiveUtf16Searcher.HasSubstring(str.data(), str.data() + str.length());
+
+	auto memory = stackAllocator.Allocate(sizeof(wchar_t) * str.length());
+	auto lowerCase = static_cast<wchar_t*>(memory);
+
+	if (m_SearchInstructions.SearchStringIsAscii())
+	{
+		StringUtils::ToLowerAscii(str.data(), lowerCase, str.length());
+	}
+	else
+	{
+		// Simple case mapping never changes the length of UTF-16 text
+		auto lowerCaseLength = LCMapStringEx(LOCALE_NAME_SYSTEM_DEFAULT, LCMAP_LOWERCASE, str.data(), static_cast<int>(str.length()), lowerCase, static_cast<int>(str.length()), nullptr, nullptr, 0);
+		if (lowerCaseLength != static_cast<int>(str.length()))
+			return false;
+	}
+
+	return m_WhitespaceInsensitiveUtf16Searcher.HasSubstring(lowerCase, lowerCase + str.length());
+}
+
 bool StringSearcher::PerformFileContentSearch(uint8_t* fileBytes, uint32_t bufferLength, ScopedStackAllocator& stackAllocator) const
 {
 	if (m_SearchInstructions.SearchContentsAsUtf16())
 	{
-		if (SearchForString(std::wstring_view(reinterpret_cast<const wchar_t*>(fileBytes), bufferLength / sizeof(wchar_t)), stackAllocator))
+		if (SearchUtf16FileContents(std::wstring_view(reinterpret_cast<const wchar_t*>(fileBytes), bufferLength / sizeof(wchar_t)), stackAllocator))
 			return true;
 	}
 
@@ -60,5 +232,30 @@ bool StringSearcher::PerformFileContentSearch(uint8_t* fileBytes, uint32_t buffe
 	if (m_SearchInstructions.IgnoreCase())
 		StringUtils::ToLowerAscii(fileBytes, fileBytes, bufferLength);
 
+	if (m_SearchInstructions.IgnoreWhitespace())
+	{
+		auto text = reinterpret_cast<const char*>(fileBytes);
+		return m_WhitespaceInsensitiveUtf8Searcher.HasSubstring(text, text + bufferLength);
+	}
+
 	return m_OrdinalUtf8Searcher.HasSubstring(fileBytes, fileBytes + bufferLength);
 }
+
+size_t StringSearcher::GetMaxMatchLengthInBytes() const
+{
+	if (m_SearchInstructions.SearchForDictionaryEntries() || m_SearchInstructions.SearchForProximity())
+		return m_DictionaryMatcher.GetMaxEntryLength();
+
+	size_t maxLength = std::max(m_SearchInstructions.utf8SearchString.length(), m_SearchInstructions.searchString.length() * sizeof(wchar_t));
+
+	if (m_SearchInstructions.SearchInFileContents() && m_SearchInstructions.IgnoreWhitespace())
+	{
+		if (m_SearchInstructions.SearchContentsAsUtf8())
+			maxLength = std::max(maxLength, m_WhitespaceInsensitiveUtf8Searcher.GetMaxMatchLength(kMaxWhitespaceRunLengthAcrossChunks));
+
+		if (m_SearchInstructions.SearchContentsAsUtf16())
+			maxLength = std::max(maxLength, m_WhitespaceInsensitiveUtf16Searcher.GetMaxMatchLength(kMaxWhitespaceRunLengthAcrossChunks) * sizeof(wchar_t));
+	}
+
+	return maxLength;
+}
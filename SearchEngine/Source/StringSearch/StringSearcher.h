@@ -1,14 +1,45 @@
 #pragma once
 
+#include "DictionaryMatcher.h"
 #include "NonCopyable.h"
 #include "OrdinalStringSearcher.h"
 #include "SearchInstructions.h"
 #include "SearchResultData.h"
 #include "UnicodeUtf16StringSearcher.h"
+#include "WhitespaceInsensitiveStringSearcher.h"
 #include "Utilities/WorkQueue.h"
 
 class ScopedStackAllocator;
 
+// Offsets of the latest occurrence of each proximity search term
+struct ProximityWindow
+{
+	int64_t lastTermOffsets[2];
+
+	ProximityWindow()
+	{
+		Reset();
+	}
+
+	inline void Reset()
+	{
+		lastTermOffsets[0] = lastTermOffsets[1] = std::numeric_limits<int64_t>::min() / 2;
+	}
+};
+
+// What a reader carries from one chunk of a file to the next one
+struct FileContentSearchState
+{
+	std::vector<uint32_t> dictionaryMatches;
+	ProximityWindow proximityWindow;
+
+	inline void Reset()
+	{
+		dictionaryMatches.clear();
+		proximityWindow.Reset();
+	}
+};
+
 class StringSearcher : NonCopyable
 {
 public:
@@ -17,10 +48,70 @@ public:
 	bool SearchForString(std::wstring_view str, ScopedStackAllocator& stackAllocator) const;
 	bool PerformFileContentSearch(uint8_t* fileBytes, uint32_t bufferLength, ScopedStackAllocator& stackAllocator) const;
 
+	// Case insensitive searches lower case UTF-8 text, and dictionary entries and proximity terms in any encoding, in place, so callers that don't own the bytes have to pass a copy
+	inline bool ModifiesSearchedBytes() const { return m_SearchInstructions.IgnoreCase() && (m_SearchInstructions.SearchContentsAsUtf8() || m_SearchInstructions.SearchForDictionaryEntries() || m_SearchInstructions.SearchForProximity()); }
+
+	inline bool IsDictionarySearch() const { return m_SearchInstructions.SearchForDictionaryEntries(); }
+
+	// Unlike PerformFileContentSearch, this never stops at the first match: every chunk of the file should be passed in
+	void FindDictionaryMatches(uint8_t* fileBytes, uint32_t bufferLength, std::vector<uint32_t>& matchedEntries) const;
+
+	// Keeps the bytes a DirectStorage chunk needs to read past its own end bounded
+	static constexpr uint32_t kMaxProximityDistance = 64 * 1024;
+
+	inline bool IsProximitySearch() const { return m_SearchInstructions.SearchForProximity(); }
+	inline uint32_t GetMaxProximityDistance() const { return m_SearchInstructions.maxProximityDistance; }
+
+	// Looks for the two proximity terms starting within maxProximityDistance bytes of each other. Only occurrences starting before searchedLength
+	// are considered, the rest of the buffer is only there so that they can be matched in full. The window carries occurrences over from earlier chunks,
+	// so chunks sharing a window must be passed in order. When both terms are the same, it looks for two occurrences of it instead
+	bool FindProximityMatch(uint8_t* fileBytes, uint32_t bufferLength, uint32_t searchedLength, uint64_t bufferFileOffset, ProximityWindow& window) const;
+
+	inline uint64_t GetDictionaryEntryCount() const { return m_DictionaryEntryCount; }
+	inline uint64_t GetDictionaryMemoryUsage() const { return m_DictionaryMatcher.GetMemoryUsage(); }
+	inline double GetDictionaryBuildTimeInSeconds() const { return m_DictionaryBuildTimeInSeconds; }
+
+	// Calls callback with every non-empty line of a dictionary file and its zero based line index
+	template <typename Callback>
+	static void ForEachDictionaryEntry(std::string_view dictionaryContents, Callback&& callback)
+	{
+		if (dictionaryContents.starts_with("\xEF\xBB\xBF"))
+			dictionaryContents.remove_prefix(3);
+
+		for (uint32_t lineIndex = 0; !dictionaryContents.empty(); lineIndex++)
+		{
+			auto lineEnd = dictionaryContents.find('\n');
+			auto line = dictionaryContents.substr(0, lineEnd);
+			dictionaryContents.remove_prefix(lineEnd == std::string_view::npos ? dictionaryContents.length() : lineEnd + 1);
+
+			if (line.ends_with('\r'))
+				line.remove_suffix(1);
+
+			if (!line.empty())
+				callback(line, lineIndex);
+		}
+	}
+
+	// How many bytes consecutive chunks of a file need to overlap by so that no match is lost at the seam
+	size_t GetMaxMatchLengthInBytes() const;
+
+private:
+	void BuildDictionary();
+	void BuildProximityTerms();
+	bool SearchUtf16FileContents(std::wstring_view str, ScopedStackAllocator& stackAllocator) const;
+
 private:
 	const SearchInstructions& m_SearchInstructions;
+	std::wstring m_LowerCaseSearchString;
 
 	OrdinalStringSearcher<char> m_OrdinalUtf8Searcher;
 	UnicodeUtf16StringSearcher m_UnicodeUtf16Searcher;
 	OrdinalStringSearcher<wchar_t> m_OrdinalUtf16Searcher;
+	WhitespaceInsensitiveStringSearcher<char> m_WhitespaceInsensitiveUtf8Searcher;
+	WhitespaceInsensitiveStringSearcher<wchar_t> m_WhitespaceInsensitiveUtf16Searcher;
+
+	DictionaryMatcher m_DictionaryMatcher;
+	uint64_t m_DictionaryEntryCount;
+	double m_DictionaryBuildTimeInSeconds;
+	bool m_ProximityTermsAreEqual;
 };
\ No newline at end of file
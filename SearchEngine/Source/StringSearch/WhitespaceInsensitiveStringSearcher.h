@@ -0,0 +1,263 @@
+#pragma once
+
+#include <bit>
+
+#if defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// Matches a pattern where every whitespace run matches any non-empty whitespace run in the text, so "a b" finds "a\r\n\tb".
+// The pattern is split into literal tokens separated by whitespace runs. Candidates for the first token are found 16 bytes at
+// a time by comparing its first and last characters, and whitespace runs in the text are skipped the same way, so the text
+// never needs to be normalized or copied.
+template <typename CharType>
+class WhitespaceInsensitiveStringSearcher
+{
+private:
+	static_assert(sizeof(CharType) <= 2, "Character types larger than 2 bytes are not supported");
+	typedef typename std::make_unsigned<CharType>::type UnsignedCharType;
+
+	struct Token
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	const CharType* m_Pattern;
+	std::vector<Token> m_Tokens;
+	uint32_t m_WhitespaceRunCount;
+	uint32_t m_MinMatchLength;
+	bool m_StartsWithWhitespace;
+	bool m_EndsWithWhitespace;
+
+#if defined(_M_X64)
+	static constexpr uint32_t kCharsPerBlock = 16 / sizeof(CharType);
+
+	static inline __m128i Load(const CharType* text)
+	{
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+	}
+
+	static inline __m128i Broadcast(CharType c)
+	{
+		if constexpr (sizeof(CharType) == 1)
+			return _mm_set1_epi8(static_cast<char>(c));
+		else
+			return _mm_set1_epi16(static_cast<short>(c));
+	}
+
+	static inline __m128i CompareEqual(__m128i left, __m128i right)
+	{
+		if constexpr (sizeof(CharType) == 1)
+			return _mm_cmpeq_epi8(left, right);
+		else
+			return _mm_cmpeq_epi16(left, right);
+	}
+
+	// One bit per character, so the result can be walked with countr_zero regardless of character size
+	static inline uint32_t ToCharacterMask(__m128i comparison)
+	{
+		if constexpr (sizeof(CharType) == 1)
+			return static_cast<uint32_t>(_mm_movemask_epi8(comparison));
+		else
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(comparison, _mm_setzero_si128())));
+	}
+
+	// ' ' or '\t' through '\r'
+	static inline __m128i ClassifyWhitespace(__m128i text)
+	{
+		if constexpr (sizeof(CharType) == 1)
+		{
+			auto controlWhitespace = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(text, _mm_set1_epi8('\t')), _mm_set1_epi8('\r' - '\t')), _mm_setzero_si128());
+			return _mm_or_si128(controlWhitespace, _mm_cmpeq_epi8(text, _mm_set1_epi8(' ')));
+		}
+		else
+		{
+			auto controlWhitespace = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(text, _mm_set1_epi16(L'\t')), _mm_set1_epi16(L'\r' - L'\t')), _mm_setzero_si128());
+			return _mm_or_si128(controlWhitespace, _mm_cmpeq_epi16(text, _mm_set1_epi16(L' ')));
+		}
+	}
+#endif
+
+	static inline bool IsWhitespace(CharType c)
+	{
+		auto value = static_cast<UnsignedCharType>(c);
+		return value == ' ' || static_cast<UnsignedCharType>(value - '\t') <= '\r' - '\t';
+	}
+
+	static inline const CharType* SkipWhitespace(const CharType* text, const CharType* textEnd)
+	{
+#if defined(_M_X64)
+		constexpr uint32_t kBlockMask = (1u << kCharsPerBlock) - 1;
+
+		while (textEnd - text >= kCharsPerBlock)
+		{
+			auto nonWhitespaceMask = ~ToCharacterMask(ClassifyWhitespace(Load(text))) & kBlockMask;
+			if (nonWhitespaceMask != 0)
+				return text + std::countr_zero(nonWhitespaceMask);
+
+			text += kCharsPerBlock;
+		}
+#endif
+
+		while (text != textEnd && IsWhitespace(*text))
+			text++;
+
+		return text;
+	}
+
+	static inline bool ContainsWhitespace(const CharType* text, const CharType* textEnd)
+	{
+#if defined(_M_X64)
+		while (textEnd - text >= kCharsPerBlock)
+		{
+			if (ToCharacterMask(ClassifyWhitespace(Load(text))) != 0)
+				return true;
+
+			text += kCharsPerBlock;
+		}
+#endif
+
+		for (; text != textEnd; text++)
+		{
+			if (IsWhitespace(*text))
+				return true;
+		}
+
+		return false;
+	}
+
+	inline bool MatchesToken(const Token& token, const CharType* text) const
+	{
+		return memcmp(text, m_Pattern + token.offset, sizeof(CharType) * token.length) == 0;
+	}
+
+	// Checks the rest of the pattern once the first token is known to line up with candidate
+	inline bool MatchesAt(const CharType* textBegin, const CharType* textEnd, const CharType* candidate) const
+	{
+		if (m_StartsWithWhitespace && (candidate == textBegin || !IsWhitespace(candidate[-1])))
+			return false;
+
+		if (!MatchesToken(m_Tokens[0], candidate))
+			return false;
+
+		auto text = candidate + m_Tokens[0].length;
+
+		for (size_t i = 1; i < m_Tokens.size(); i++)
+		{
+			// Tokens never contain whitespace, so skipping the whole run greedily is the only way to line up the next one
+			auto tokenStart = SkipWhitespace(text, textEnd);
+			if (tokenStart == text)
+				return false;
+
+			const auto& token = m_Tokens[i];
+			if (static_cast<size_t>(textEnd - tokenStart) < token.length || !MatchesToken(token, tokenStart))
+				return false;
+
+			text = tokenStart + token.length;
+		}
+
+		if (m_EndsWithWhitespace)
+			return text != textEnd && IsWhitespace(*text);
+
+		return true;
+	}
+
+public:
+	WhitespaceInsensitiveStringSearcher() :
+		m_Pattern(nullptr),
+		m_WhitespaceRunCount(0),
+		m_MinMatchLength(0),
+		m_StartsWithWhitespace(false),
+		m_EndsWithWhitespace(false)
+	{
+	}
+
+	void Initialize(const CharType* pattern, size_t patternLength)
+	{
+		if (patternLength > std::numeric_limits<uint32_t>::max() / 2)
+			__fastfail(1);
+
+		m_Pattern = pattern;
+		m_Tokens.clear();
+		m_WhitespaceRunCount = 0;
+		m_MinMatchLength = 0;
+
+		const auto length = static_cast<uint32_t>(patternLength);
+		m_StartsWithWhitespace = length > 0 && IsWhitespace(pattern[0]);
+		m_EndsWithWhitespace = length > 0 && IsWhitespace(pattern[length - 1]);
+
+		for (uint32_t i = 0; i < length;)
+		{
+			const uint32_t runStart = i;
+			const bool isWhitespaceRun = IsWhitespace(pattern[i]);
+
+			while (i < length && IsWhitespace(pattern[i]) == isWhitespaceRun)
+				i++;
+
+			if (isWhitespaceRun)
+			{
+				// Each whitespace run needs at least one whitespace character in the text
+				m_WhitespaceRunCount++;
+				m_MinMatchLength++;
+			}
+			else
+			{
+				m_Tokens.push_back({ runStart, i - runStart });
+				m_MinMatchLength += i - runStart;
+			}
+		}
+	}
+
+	// Upper bound on how many characters a match can span when no whitespace run in the text is longer than maxWhitespaceRunLength
+	inline size_t GetMaxMatchLength(size_t maxWhitespaceRunLength) const
+	{
+		return m_MinMatchLength + m_WhitespaceRunCount * (maxWhitespaceRunLength - 1);
+	}
+
+	bool HasSubstring(const CharType* textBegin, const CharType* textEnd) const
+	{
+		if (static_cast<size_t>(textEnd - textBegin) < m_MinMatchLength)
+			return false;
+
+		if (m_Tokens.empty())
+			return ContainsWhitespace(textBegin, textEnd);
+
+		const auto& firstToken = m_Tokens[0];
+		const auto firstCharacter = m_Pattern[firstToken.offset];
+		const auto lastCharacter = m_Pattern[firstToken.offset + firstToken.length - 1];
+
+		auto candidate = m_StartsWithWhitespace ? textBegin + 1 : textBegin;
+		const auto candidateEnd = textEnd - firstToken.length + 1;
+
+#if defined(_M_X64)
+		const auto firstCharacters = Broadcast(firstCharacter);
+		const auto lastCharacters = Broadcast(lastCharacter);
+
+		while (candidateEnd - candidate >= kCharsPerBlock)
+		{
+			auto firstMatches = CompareEqual(Load(candidate), firstCharacters);
+			auto lastMatches = CompareEqual(Load(candidate + firstToken.length - 1), lastCharacters);
+			auto candidateMask = ToCharacterMask(_mm_and_si128(firstMatches, lastMatches));
+
+			while (candidateMask != 0)
+			{
+				if (MatchesAt(textBegin, textEnd, candidate + std::countr_zero(candidateMask)))
+					return true;
+
+				candidateMask &= candidateMask - 1;
+			}
+
+			candidate += kCharsPerBlock;
+		}
+#endif
+
+		for (; candidate < candidateEnd; candidate++)
+		{
+			if (*candidate == firstCharacter && candidate[firstToken.length - 1] == lastCharacter && MatchesAt(textBegin, textEnd, candidate))
+				return true;
+		}
+
+		return false;
+	}
+};
\ No newline at end of file
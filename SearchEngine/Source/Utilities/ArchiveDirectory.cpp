@@ -0,0 +1,417 @@
+#include "PrecompiledHeader.h"
+#include "ArchiveDirectory.h"
+#include "StringUtils.h"
+
+#include <charconv>
+
+namespace ArchiveDirectory
+{
+
+constexpr uint32_t kZipEndOfCentralDirectorySignature = 0x06054B50;
+constexpr uint32_t kZip64EndOfCentralDirectorySignature = 0x06064B50;
+constexpr uint32_t kZip64EndOfCentralDirectoryLocatorSignature = 0x07064B50;
+constexpr uint32_t kZipCentralDirectoryEntrySignature = 0x02014B50;
+constexpr uint32_t kZipLocalHeaderSignature = 0x04034B50;
+constexpr uint32_t kZipEndOfCentralDirectorySize = 22;
+constexpr uint32_t kZip64EndOfCentralDirectorySize = 56;
+constexpr uint32_t kZip64EndOfCentralDirectoryLocatorSize = 20;
+constexpr uint32_t kZipCentralDirectoryEntrySize = 46;
+constexpr uint32_t kZipLocalHeaderSize = 30;
+constexpr uint32_t kZipMaxCommentLength = 0xFFFF;
+constexpr uint16_t kZip64ExtraFieldId = 0x0001;
+constexpr uint16_t kZipEncryptedFlag = 1 << 0;
+constexpr uint16_t kZipUtf8NamesFlag = 1 << 11;
+constexpr uint32_t kZipMaxCentralDirectorySize = 256 * 1024 * 1024;
+constexpr uint32_t kCodePage437 = 437;
+
+constexpr uint32_t kTarBlockSize = 512;
+constexpr uint32_t kTarWindowSize = 64 * 1024;
+constexpr uint64_t kUnixEpochInFileTimeSeconds = 11644473600;
+
+static inline uint16_t ReadUInt16(const uint8_t* bytes)
+{
+	return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+static inline uint32_t ReadUInt32(const uint8_t* bytes)
+{
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static inline uint64_t ReadUInt64(const uint8_t* bytes)
+{
+	return ReadUInt32(bytes) | (static_cast<uint64_t>(ReadUInt32(bytes + 4)) << 32);
+}
+
+static std::wstring DecodeMemberPath(std::string_view path, uint32_t codePage)
+{
+	std::wstring result;
+	if (codePage == CP_UTF8)
+	{
+		result = StringUtils::Utf8ToUtf16(path);
+	}
+	else if (!path.empty())
+	{
+		result.resize(MultiByteToWideChar(codePage, 0, path.data(), static_cast<int>(path.length()), nullptr, 0));
+		MultiByteToWideChar(codePage, 0, path.data(), static_cast<int>(path.length()), result.data(), static_cast<int>(result.length()));
+	}
+
+	std::replace(result.begin(), result.end(), L'/', L'\\');
+	return result;
+}
+
+static FILETIME UnixTimeToFileTime(uint64_t unixTime)
+{
+	const auto fileTime = (unixTime + kUnixEpochInFileTimeSeconds) * 10000000;
+
+	FILETIME result;
+	result.dwLowDateTime = static_cast<DWORD>(fileTime);
+	result.dwHighDateTime = static_cast<DWORD>(fileTime >> 32);
+	return result;
+}
+
+bool GetArchiveFormat(std::wstring_view fileName, ArchiveFormat& format)
+{
+	auto extensionIndex = fileName.find_last_of(L'.');
+	if (extensionIndex == std::wstring_view::npos)
+		return false;
+
+	auto extension = fileName.substr(extensionIndex + 1);
+	auto isExtension = [extension](std::wstring_view candidate)
+	{
+		return CompareStringOrdinal(extension.data(), static_cast<int>(extension.length()), candidate.data(), static_cast<int>(candidate.length()), TRUE) == CSTR_EQUAL;
+	};
+
+	// Java archives and NuGet packages are zip files by another name
+	if (isExtension(L"zip") || isExtension(L"jar") || isExtension(L"nupkg"))
+	{
+		format = ArchiveFormat::kZip;
+		return true;
+	}
+
+	if (isExtension(L"tar"))
+	{
+		format = ArchiveFormat::kTar;
+		return true;
+	}
+
+	return false;
+}
+
+// The central directory at the end of a zip file lists every member, and the end of central directory record after it says where it starts.
+// The record is followed by a comment of up to 64 KB, so it has to be looked for. Archives over 4 GB or with more than 65535 members have
+// a zip64 record in front of it that says the same thing in 64 bits
+static bool ListZipMembers(ReadCallback read, void* readContext, uint64_t archiveSize, std::vector<Member>& members)
+{
+	if (archiveSize < kZipEndOfCentralDirectorySize)
+		return false;
+
+	const auto tailSize = static_cast<uint32_t>(std::min<uint64_t>(archiveSize, kZip64EndOfCentralDirectoryLocatorSize + kZipEndOfCentralDirectorySize + kZipMaxCommentLength));
+	const auto tailOffset = archiveSize - tailSize;
+	std::vector<uint8_t> tail(tailSize);
+	if (read(readContext, tailOffset, tail.data(), tailSize) != tailSize)
+		return false;
+
+	int64_t recordIndex = tailSize - kZipEndOfCentralDirectorySize;
+	for (; recordIndex >= 0; recordIndex--)
+	{
+		if (ReadUInt32(&tail[recordIndex]) == kZipEndOfCentralDirectorySignature && recordIndex + kZipEndOfCentralDirectorySize + ReadUInt16(&tail[recordIndex + 20]) <= tailSize)
+			break;
+	}
+
+	if (recordIndex < 0)
+		return false;
+
+	const auto record = &tail[recordIndex];
+	uint64_t entryCount = ReadUInt16(record + 10);
+	uint64_t centralDirectorySize = ReadUInt32(record + 12);
+	uint64_t centralDirectoryOffset = ReadUInt32(record + 16);
+
+	// Split archives keep their central directory on the last disk, and their members on any of them
+	if (ReadUInt16(record + 4) != 0 || ReadUInt16(record + 6) != 0)
+		return false;
+
+	if (recordIndex >= kZip64EndOfCentralDirectoryLocatorSize && ReadUInt32(record - kZip64EndOfCentralDirectoryLocatorSize) == kZip64EndOfCentralDirectoryLocatorSignature)
+	{
+		uint8_t zip64Record[kZip64EndOfCentralDirectorySize];
+		const auto zip64RecordOffset = ReadUInt64(record - kZip64EndOfCentralDirectoryLocatorSize + 8);
+
+		if (read(readContext, zip64RecordOffset, zip64Record, sizeof(zip64Record)) != sizeof(zip64Record) || ReadUInt32(zip64Record) != kZip64EndOfCentralDirectorySignature)
+			return false;
+
+		entryCount = ReadUInt64(zip64Record + 32);
+		centralDirectorySize = ReadUInt64(zip64Record + 40);
+		centralDirectoryOffset = ReadUInt64(zip64Record + 48);
+	}
+
+	if (centralDirectorySize > kZipMaxCentralDirectorySize || centralDirectoryOffset + centralDirectorySize > archiveSize)
+		return false;
+
+	std::vector<uint8_t> centralDirectory(static_cast<size_t>(centralDirectorySize));
+	if (centralDirectorySize != 0 && read(readContext, centralDirectoryOffset, centralDirectory.data(), static_cast<uint32_t>(centralDirectorySize)) != centralDirectorySize)
+		return false;
+
+	size_t entryOffset = 0;
+	for (uint64_t i = 0; i < entryCount; i++)
+	{
+		if (entryOffset + kZipCentralDirectoryEntrySize > centralDirectory.size())
+			return false;
+
+		const auto entry = &centralDirectory[entryOffset];
+		if (ReadUInt32(entry) != kZipCentralDirectoryEntrySignature)
+			return false;
+
+		const auto flags = ReadUInt16(entry + 8);
+		const auto method = ReadUInt16(entry + 10);
+		const auto nameLength = ReadUInt16(entry + 28);
+		const auto extraFieldsLength = ReadUInt16(entry + 30);
+		const auto commentLength = ReadUInt16(entry + 32);
+
+		const auto name = entry + kZipCentralDirectoryEntrySize;
+		const auto extraFields = name + nameLength;
+		entryOffset += kZipCentralDirectoryEntrySize + nameLength + extraFieldsLength + commentLength;
+		if (entryOffset > centralDirectory.size())
+			return false;
+
+		// Directories are there for their names alone
+		if (nameLength == 0 || name[nameLength - 1] == '/')
+			continue;
+
+		Member member;
+		member.size = ReadUInt32(entry + 24);
+		member.compressedSize = ReadUInt32(entry + 20);
+		member.dataOffset = ReadUInt32(entry + 42);
+
+		// Sizes and offsets too big for their 32 bits come from the zip64 extra field instead, in this order, and only the ones that didn't fit
+		for (uint32_t fieldOffset = 0; fieldOffset + 4 <= extraFieldsLength;)
+		{
+			const auto fieldId = ReadUInt16(extraFields + fieldOffset);
+			const auto fieldLength = ReadUInt16(extraFields + fieldOffset + 2);
+			auto value = extraFields + fieldOffset + 4;
+			const auto fieldEnd = value + std::min<uint32_t>(fieldLength, extraFieldsLength - fieldOffset - 4);
+
+			if (fieldId == kZip64ExtraFieldId)
+			{
+				for (auto field : { &member.size, &member.compressedSize, &member.dataOffset })
+				{
+					if (*field == 0xFFFFFFFF && value + 8 <= fieldEnd)
+					{
+						*field = ReadUInt64(value);
+						value += 8;
+					}
+				}
+			}
+
+			fieldOffset += 4 + fieldLength;
+		}
+
+		if (member.dataOffset + member.compressedSize > archiveSize)
+			return false;
+
+		FILETIME localTime;
+		if (!DosDateTimeToFileTime(ReadUInt16(entry + 14), ReadUInt16(entry + 12), &localTime) || !LocalFileTimeToFileTime(&localTime, &member.lastWriteTime))
+			member.lastWriteTime = {};
+
+		if ((flags & kZipEncryptedFlag) != 0)
+		{
+			member.compressionMethod = CompressionMethod::kUnsupported;
+		}
+		else if (method == 0)
+		{
+			member.compressionMethod = CompressionMethod::kStored;
+		}
+		else if (method == 8)
+		{
+			member.compressionMethod = CompressionMethod::kDeflated;
+		}
+		else
+		{
+			member.compressionMethod = CompressionMethod::kUnsupported;
+		}
+
+		member.path = DecodeMemberPath(std::string_view(reinterpret_cast<const char*>(name), nameLength), (flags & kZipUtf8NamesFlag) != 0 ? CP_UTF8 : kCodePage437);
+		members.push_back(std::move(member));
+	}
+
+	// The central directory doesn't have to be in the order the data is in, but reads go better if they are
+	std::sort(members.begin(), members.end(), [](const Member& left, const Member& right) { return left.dataOffset < right.dataOffset; });
+	return true;
+}
+
+bool GetZipMemberDataOffset(ReadCallback read, void* readContext, Member& member)
+{
+	uint8_t localHeader[kZipLocalHeaderSize];
+	if (read(readContext, member.dataOffset, localHeader, sizeof(localHeader)) != sizeof(localHeader) || ReadUInt32(localHeader) != kZipLocalHeaderSignature)
+		return false;
+
+	member.dataOffset += kZipLocalHeaderSize + ReadUInt16(localHeader + 26) + ReadUInt16(localHeader + 28);
+	return true;
+}
+
+// Tar header fields are octal text, except that sizes past 8 GB come in binary, big endian, with the top bit of the first byte set
+static uint64_t ParseTarNumber(const uint8_t* field, size_t length)
+{
+	uint64_t value = 0;
+
+	if ((field[0] & 0x80) != 0)
+	{
+		for (size_t i = 1; i < length; i++)
+			value = (value << 8) | field[i];
+
+		return value;
+	}
+
+	for (size_t i = 0; i < length && field[i] != 0; i++)
+	{
+		if (field[i] >= '0' && field[i] <= '7')
+			value = value * 8 + (field[i] - '0');
+	}
+
+	return value;
+}
+
+static bool IsTarHeaderValid(const uint8_t* header)
+{
+	// The checksum is the sum of the header's bytes, counting its own field as spaces
+	uint32_t checksum = 0;
+	for (uint32_t i = 0; i < kTarBlockSize; i++)
+		checksum += i >= 148 && i < 156 ? ' ' : header[i];
+
+	return checksum == ParseTarNumber(header + 148, 8);
+}
+
+// A tar file is a header followed by the member's data, padded to whole blocks, over and over. Names too long for the header come in a
+// GNU long name entry or a pax extended header in front of it
+static bool ListTarMembers(ReadCallback read, void* readContext, uint64_t archiveSize, std::vector<Member>& members)
+{
+	std::vector<uint8_t> window(kTarWindowSize);
+	uint64_t windowOffset = 0;
+	uint32_t windowLength = 0;
+
+	// Headers are read a window at a time, since they're mostly close together
+	auto getBytes = [&](uint64_t offset, uint32_t length) -> const uint8_t*
+	{
+		if (length > kTarWindowSize)
+			return nullptr;
+
+		if (offset < windowOffset || offset + length > windowOffset + windowLength)
+		{
+			windowOffset = offset;
+			windowLength = read(readContext, offset, window.data(), static_cast<uint32_t>(std::min<uint64_t>(kTarWindowSize, archiveSize - offset)));
+			if (windowLength < length)
+				return nullptr;
+		}
+
+		return &window[offset - windowOffset];
+	};
+
+	std::string longPath;
+	uint64_t headerOffset = 0;
+
+	while (headerOffset + kTarBlockSize <= archiveSize)
+	{
+		auto header = getBytes(headerOffset, kTarBlockSize);
+		if (header == nullptr)
+			return false;
+
+		// The archive ends with blocks of zeros
+		if (std::all_of(header, header + kTarBlockSize, [](uint8_t byte) { return byte == 0; }))
+			break;
+
+		// Past the first header, that's just where the readable part of the archive ends
+		if (!IsTarHeaderValid(header))
+			return headerOffset != 0;
+
+		const auto dataOffset = headerOffset + kTarBlockSize;
+		const auto size = ParseTarNumber(header + 124, 12);
+		const auto typeFlag = header[156];
+		headerOffset = dataOffset + (size + kTarBlockSize - 1) / kTarBlockSize * kTarBlockSize;
+
+		if (dataOffset + size > archiveSize)
+			return false;
+
+		// Paths that don't fit in a window aren't worth the trouble, the member keeps the one in its header
+		if ((typeFlag == 'L' || typeFlag == 'x') && size <= kTarWindowSize)
+		{
+			auto data = getBytes(dataOffset, static_cast<uint32_t>(size));
+			if (data == nullptr)
+				return false;
+
+			std::string_view records(reinterpret_cast<const char*>(data), static_cast<size_t>(size));
+			if (typeFlag == 'L')
+			{
+				longPath = records.substr(0, records.find('\0'));
+				continue;
+			}
+
+			// Pax records are "<length> <key>=<value>\n", where the length counts the whole record
+			while (!records.empty())
+			{
+				size_t recordLength = 0;
+				auto lengthEnd = records.find(' ');
+				if (lengthEnd == std::string_view::npos || std::from_chars(records.data(), records.data() + lengthEnd, recordLength).ec != std::errc() || recordLength <= lengthEnd || recordLength > records.length())
+					break;
+
+				auto record = records.substr(lengthEnd + 1, recordLength - lengthEnd - 2);
+				if (record.starts_with("path="))
+					longPath = record.substr(5);
+
+				records.remove_prefix(recordLength);
+			}
+
+			continue;
+		}
+
+		// Directories, links and devices have no data of their own
+		if (typeFlag != '0' && typeFlag != '\0' && typeFlag != '7')
+		{
+			longPath.clear();
+			continue;
+		}
+
+		std::string path;
+		if (!longPath.empty())
+		{
+			path = std::move(longPath);
+			longPath.clear();
+		}
+		else
+		{
+			const auto name = reinterpret_cast<const char*>(header);
+			const auto prefix = reinterpret_cast<const char*>(header + 345);
+			path.assign(name, strnlen(name, 100));
+
+			if (memcmp(header + 257, "ustar", 5) == 0 && prefix[0] != 0)
+				path = std::string(prefix, strnlen(prefix, 155)) + "/" + path;
+		}
+
+		Member member;
+		member.path = DecodeMemberPath(path, CP_UTF8);
+		member.dataOffset = dataOffset;
+		member.compressedSize = size;
+		member.size = size;
+		member.lastWriteTime = UnixTimeToFileTime(ParseTarNumber(header + 136, 12));
+		member.compressionMethod = CompressionMethod::kStored;
+		members.push_back(std::move(member));
+	}
+
+	return true;
+}
+
+bool ListMembers(ArchiveFormat format, ReadCallback read, void* readContext, uint64_t archiveSize, std::vector<Member>& members)
+{
+	members.clear();
+
+	switch (format)
+	{
+	case ArchiveFormat::kZip:
+		return ListZipMembers(read, readContext, archiveSize, members);
+
+	case ArchiveFormat::kTar:
+		return ListTarMembers(read, readContext, archiveSize, members);
+	}
+
+	return false;
+}
+
+}
\ No newline at end of file
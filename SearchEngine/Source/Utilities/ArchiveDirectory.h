@@ -0,0 +1,43 @@
+#pragma once
+
+// Lists the members of zip and tar files, so their names can be searched and their data read straight out of the archive, without
+// extracting anything
+namespace ArchiveDirectory
+{
+
+// Reads up to length bytes at offset and returns how many it got, which is fewer at the end of the file or when the read fails
+typedef uint32_t (*ReadCallback)(void* context, uint64_t offset, uint8_t* buffer, uint32_t length);
+
+enum class ArchiveFormat
+{
+	kZip,
+	kTar,
+};
+
+enum class CompressionMethod
+{
+	kStored,
+	kDeflated,
+	kUnsupported, // Encrypted, or compressed some other way, so only the name can be searched
+};
+
+struct Member
+{
+	std::wstring path; // Within the archive, with backslashes
+	uint64_t dataOffset; // Zip members have their local header here, until GetZipMemberDataOffset skips it
+	uint64_t compressedSize;
+	uint64_t size;
+	FILETIME lastWriteTime;
+	CompressionMethod compressionMethod;
+};
+
+// Goes by the extension, since that's all there is to go by before the file is opened
+bool GetArchiveFormat(std::wstring_view fileName, ArchiveFormat& format);
+
+// Files only, in the order their data is in the archive, as far as the archive says. False if the file isn't an archive of that format
+bool ListMembers(ArchiveFormat format, ReadCallback read, void* readContext, uint64_t archiveSize, std::vector<Member>& members);
+
+// The local header in front of a zip member's data repeats its name, and can have extra fields the central directory doesn't
+bool GetZipMemberDataOffset(ReadCallback read, void* readContext, Member& member);
+
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "PrecompiledHeader.h"
+#include "BinaryFileDetection.h"
+
+#include <bit>
+
+#if defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm64_neon.h>
+#endif
+
+// No point in looking at a whole chunk, the beginning of the file is representative enough
+constexpr size_t kClassificationSampleSize = 64 * 1024;
+constexpr size_t kBlockSize = 16;
+
+// Percentages of the sample above which we declare the file binary
+constexpr size_t kMaxTextNulPercentage = 1;
+constexpr size_t kMaxTextInvalidUtf8Percentage = 10;
+
+// UTF-16 text has most of its NULs on one side of each code unit
+constexpr size_t kMinUtf16NulAlignmentPercentage = 90;
+
+// Returns bit masks of NUL bytes and bytes with the high bit set in a 16 byte block
+static inline void ClassifyBlock(const uint8_t* block, uint32_t& nulMask, uint32_t& nonAsciiMask)
+{
+#if defined(_M_X64)
+	auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+	nulMask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_setzero_si128())));
+	nonAsciiMask = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#elif defined(_M_ARM64)
+	static const uint8_t kLaneBits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	const auto laneBits = vld1q_u8(kLaneBits);
+
+	auto bytes = vld1q_u8(block);
+	auto nul = vandq_u8(vceqq_u8(bytes, vdupq_n_u8(0)), laneBits);
+	auto nonAscii = vandq_u8(vcgeq_u8(bytes, vdupq_n_u8(0x80)), laneBits);
+
+	nulMask = vaddv_u8(vget_low_u8(nul)) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(nul))) << 8);
+	nonAsciiMask = vaddv_u8(vget_low_u8(nonAscii)) | (static_cast<uint32_t>(vaddv_u8(vget_high_u8(nonAscii))) << 8);
+#else
+	nulMask = 0;
+	nonAsciiMask = 0;
+
+	for (uint32_t i = 0; i < kBlockSize; i++)
+	{
+		nulMask |= static_cast<uint32_t>(block[i] == 0) << i;
+		nonAsciiMask |= static_cast<uint32_t>(block[i] >= 0x80) << i;
+	}
+#endif
+}
+
+// Returns the length of a valid UTF-8 sequence starting at bytes, or 0 if it's invalid
+static inline size_t GetValidUtf8SequenceLength(const uint8_t* bytes, size_t remaining)
+{
+	const auto lead = bytes[0];
+	size_t sequenceLength;
+	uint8_t minSecondByte = 0x80;
+	uint8_t maxSecondByte = 0xBF;
+
+	if (lead >= 0xC2 && lead <= 0xDF)
+	{
+		sequenceLength = 2;
+	}
+	else if (lead >= 0xE0 && lead <= 0xEF)
+	{
+		sequenceLength = 3;
+
+		if (lead == 0xE0)
+			minSecondByte = 0xA0; // Overlong encoding
+		else if (lead == 0xED)
+			maxSecondByte = 0x9F; // Surrogates
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4)
+	{
+		sequenceLength = 4;
+
+		if (lead == 0xF0)
+			minSecondByte = 0x90; // Overlong encoding
+		else if (lead == 0xF4)
+			maxSecondByte = 0x8F; // Past U+10FFFF
+	}
+	else
+	{
+		return 0;
+	}
+
+	// The sample might cut a perfectly valid sequence in half
+	if (remaining < sequenceLength)
+		return remaining;
+
+	if (bytes[1] < minSecondByte || bytes[1] > maxSecondByte)
+		return 0;
+
+	for (size_t i = 2; i < sequenceLength; i++)
+	{
+		if ((bytes[i] & 0xC0) != 0x80)
+			return 0;
+	}
+
+	return sequenceLength;
+}
+
+bool BinaryFileDetection::IsBinary(const uint8_t* bytes, size_t length)
+{
+	length = std::min(length, kClassificationSampleSize);
+	if (length == 0)
+		return false;
+
+	// Byte order marks are a dead giveaway
+	if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+		return false;
+
+	if (length >= 2 && ((bytes[0] == 0xFF && bytes[1] == 0xFE) || (bytes[0] == 0xFE && bytes[1] == 0xFF)))
+		return false;
+
+	size_t nulCount = 0;
+	size_t oddNulCount = 0;
+	size_t invalidUtf8Count = 0;
+	size_t offset = 0;
+
+	while (offset < length)
+	{
+		if (length - offset >= kBlockSize)
+		{
+			uint32_t nulMask, nonAsciiMask;
+			ClassifyBlock(bytes + offset, nulMask, nonAsciiMask);
+
+			// Skip over the ASCII prefix of the block in one go, and only fall back to decoding byte by byte past it
+			auto asciiPrefixLength = std::countr_zero(nonAsciiMask | (1u << kBlockSize));
+			auto asciiPrefixNulMask = nulMask & ((1u << asciiPrefixLength) - 1);
+			auto oddBytesMask = (offset & 1) != 0 ? 0x5555u : 0xAAAAu;
+
+			nulCount += std::popcount(asciiPrefixNulMask);
+			oddNulCount += std::popcount(asciiPrefixNulMask & oddBytesMask);
+			offset += asciiPrefixLength;
+
+			if (asciiPrefixLength == kBlockSize)
+				continue;
+		}
+
+		if (bytes[offset] < 0x80)
+		{
+			if (bytes[offset] == 0)
+			{
+				nulCount++;
+				oddNulCount += offset & 1;
+			}
+
+			offset++;
+			continue;
+		}
+
+		auto sequenceLength = GetValidUtf8SequenceLength(bytes + offset, length - offset);
+		if (sequenceLength == 0)
+		{
+			invalidUtf8Count++;
+			offset++;
+		}
+		else
+		{
+			offset += sequenceLength;
+		}
+	}
+
+	if (nulCount * 100 > length * kMaxTextNulPercentage)
+	{
+		// Mostly ASCII UTF-16 text without a byte order mark: NULs all land on the same side of each code unit
+		auto evenNulCount = nulCount - oddNulCount;
+		auto alignedNulCount = std::max(oddNulCount, evenNulCount);
+		if (alignedNulCount * 100 < nulCount * kMinUtf16NulAlignmentPercentage)
+			return true;
+
+		return false;
+	}
+
+	return invalidUtf8Count * 100 > length * kMaxTextInvalidUtf8Percentage;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace BinaryFileDetection
+{
+
+// Looks at the beginning of a file and decides whether it's worth searching as text.
+// Files with a noticeable amount of NUL bytes (unless they look like UTF-16) or invalid UTF-8 sequences are considered binary.
+bool IsBinary(const uint8_t* bytes, size_t length);
+
+}
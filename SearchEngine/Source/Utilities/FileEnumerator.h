@@ -11,6 +11,7 @@ enum class FileSystemEnumerationFlags
 
 MAKE_BIT_OPERATORS_FOR_ENUM_CLASS(FileSystemEnumerationFlags)
 
+// onFileEnumerated returns false to stop the enumeration, even partway through a directory
 template <typename Allocator, typename EnumerationCallback>
 inline void EnumerateFileSystem(const std::wstring& searchPath, std::wstring_view searchPattern, FileSystemEnumerationFlags enumerationFlags, Allocator& allocator, EnumerationCallback onFileEnumerated)
 {
@@ -34,7 +35,8 @@ inline void EnumerateFileSystem(const std::wstring& searchPath, std::wstring_vie
 		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 && (enumerationFlags & FileSystemEnumerationFlags::kEnumerateFiles) == FileSystemEnumerationFlags::kEnumerateNone)
 			continue;
 		
-		onFileEnumerated(findData);
+		if (!onFileEnumerated(findData))
+			return;
 	}
 	while (FindNextFileW(findHandle, &findData) != FALSE);
 }
\ No newline at end of file
@@ -0,0 +1,563 @@
+#include "PrecompiledHeader.h"
+#include "GzipDecoder.h"
+
+constexpr size_t kMaxDistance = 32 * 1024;
+
+constexpr uint32_t kHeaderCrcFlag = 1 << 1;
+constexpr uint32_t kExtraFieldFlag = 1 << 2;
+constexpr uint32_t kFileNameFlag = 1 << 3;
+constexpr uint32_t kCommentFlag = 1 << 4;
+constexpr uint32_t kReservedFlags = 0xE0;
+
+constexpr uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+constexpr uint8_t kLengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+constexpr uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+constexpr uint8_t kDistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+constexpr uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static inline uint32_t ReverseBits(uint32_t code, uint32_t bitCount)
+{
+	uint32_t reversed = 0;
+	for (uint32_t i = 0; i < bitCount; i++, code >>= 1)
+		reversed = (reversed << 1) | (code & 1);
+
+	return reversed;
+}
+
+bool GzipDecoder::HuffmanTable::Build(const uint8_t* codeLengths, uint32_t symbolCount)
+{
+	memset(lengthCounts, 0, sizeof(lengthCounts));
+	for (uint32_t i = 0; i < symbolCount; i++)
+		lengthCounts[codeLengths[i]]++;
+
+	lengthCounts[0] = 0;
+
+	// More codes of some length than there's room for can't be decoded. Fewer is fine, those bits just never show up
+	int32_t codesLeft = 1;
+	for (uint32_t length = 1; length <= kMaxCodeLength; length++)
+	{
+		codesLeft = (codesLeft << 1) - lengthCounts[length];
+		if (codesLeft < 0)
+			return false;
+	}
+
+	uint16_t offsets[kMaxCodeLength + 1];
+	offsets[1] = 0;
+	for (uint32_t length = 1; length < kMaxCodeLength; length++)
+		offsets[length + 1] = offsets[length] + lengthCounts[length];
+
+	for (uint32_t i = 0; i < symbolCount; i++)
+	{
+		if (codeLengths[i] != 0)
+			symbols[offsets[codeLengths[i]]++] = static_cast<uint16_t>(i);
+	}
+
+	// Codes come in order of length, and within a length in order of symbol. Deflate sends them starting with their top bit
+	memset(fastLookup, 0, sizeof(fastLookup));
+	uint32_t code = 0;
+	uint32_t symbolIndex = 0;
+
+	for (uint32_t length = 1; length <= kFastLookupBits; length++, code <<= 1)
+	{
+		for (uint32_t i = 0; i < lengthCounts[length]; i++, code++, symbolIndex++)
+		{
+			for (uint32_t bits = ReverseBits(code, length); bits < ARRAYSIZE(fastLookup); bits += 1 << length)
+				fastLookup[bits] = { symbols[symbolIndex], static_cast<uint8_t>(length) };
+		}
+	}
+
+	return true;
+}
+
+GzipDecoder::GzipDecoder(Format format, ReadInputCallback readInput, void* readInputContext, size_t minHistorySize) :
+	m_Format(format),
+	m_ReadInput(readInput),
+	m_ReadInputContext(readInputContext),
+	m_InputPosition(0),
+	m_IsInputEnd(false),
+	m_BitBuffer(0),
+	m_BitCount(0),
+	m_State(format == Format::kGzip ? State::kMemberHeader : State::kBlockHeader),
+	m_IsLastBlock(false),
+	m_HasDecodedMember(false),
+	m_StoredBytesLeft(0),
+	m_CopyLength(0),
+	m_CopyDistance(0),
+	m_LiteralTable(nullptr),
+	m_DistanceTable(nullptr),
+	m_HistorySize(std::max(kMaxDistance, minHistorySize)),
+	m_Window(new uint8_t[m_HistorySize + kOutputBlockSize]),
+	m_OutputEnd(0),
+	m_WindowOffset(0),
+	m_MemberOffset(0)
+{
+	uint8_t codeLengths[288];
+	memset(codeLengths, 8, 144);
+	memset(codeLengths + 144, 9, 112);
+	memset(codeLengths + 256, 7, 24);
+	memset(codeLengths + 280, 8, 8);
+	m_FixedLiteralTable.Build(codeLengths, 288);
+
+	memset(codeLengths, 5, 30);
+	m_FixedDistanceTable.Build(codeLengths, 30);
+}
+
+bool GzipDecoder::IsGzip(const uint8_t* bytes, size_t length)
+{
+	return length >= 3 && bytes[0] == 0x1F && bytes[1] == 0x8B && bytes[2] == 8;
+}
+
+void GzipDecoder::FillBits()
+{
+	while (m_BitCount <= 56)
+	{
+		if (m_InputPosition == m_Input.size())
+		{
+			if (m_IsInputEnd)
+				return;
+
+			m_Input = m_ReadInput(m_ReadInputContext);
+			m_InputPosition = 0;
+
+			if (m_Input.empty())
+			{
+				m_IsInputEnd = true;
+				return;
+			}
+		}
+
+		m_BitBuffer |= static_cast<uint64_t>(m_Input[m_InputPosition++]) << m_BitCount;
+		m_BitCount += 8;
+	}
+}
+
+bool GzipDecoder::GetBits(uint32_t bitCount, uint32_t& value)
+{
+	if (m_BitCount < bitCount)
+	{
+		FillBits();
+		if (m_BitCount < bitCount)
+			return false;
+	}
+
+	value = static_cast<uint32_t>(m_BitBuffer & ((static_cast<uint64_t>(1) << bitCount) - 1));
+	m_BitBuffer >>= bitCount;
+	m_BitCount -= bitCount;
+	return true;
+}
+
+bool GzipDecoder::DecodeSymbol(const HuffmanTable& table, uint32_t& symbol)
+{
+	// At the end of the input, the bits past the last ones are zeros, so only a code that fits in what's left counts
+	if (m_BitCount < kMaxCodeLength)
+		FillBits();
+
+	const auto& entry = table.fastLookup[m_BitBuffer & (ARRAYSIZE(table.fastLookup) - 1)];
+	if (entry.length != 0)
+	{
+		if (entry.length > m_BitCount)
+			return false;
+
+		symbol = entry.symbol;
+		m_BitBuffer >>= entry.length;
+		m_BitCount -= entry.length;
+		return true;
+	}
+
+	uint32_t code = 0;
+	uint32_t firstCode = 0;
+	uint32_t symbolIndex = 0;
+
+	for (uint32_t length = 1; length <= kMaxCodeLength && length <= m_BitCount; length++)
+	{
+		code |= (m_BitBuffer >> (length - 1)) & 1;
+
+		const uint32_t codeCount = table.lengthCounts[length];
+		if (code < firstCode + codeCount)
+		{
+			symbol = table.symbols[symbolIndex + code - firstCode];
+			m_BitBuffer >>= length;
+			m_BitCount -= length;
+			return true;
+		}
+
+		symbolIndex += codeCount;
+		firstCode = (firstCode + codeCount) << 1;
+		code <<= 1;
+	}
+
+	return false;
+}
+
+bool GzipDecoder::ReadMemberHeader()
+{
+	// Members start on a byte boundary
+	m_BitBuffer >>= m_BitCount % 8;
+	m_BitCount -= m_BitCount % 8;
+
+	// Anything after the last member, like padding, is ignored, the way gzip itself does
+	uint32_t id1, id2;
+	if (!GetBits(8, id1) || !GetBits(8, id2) || id1 != 0x1F || id2 != 0x8B)
+	{
+		if (!m_HasDecodedMember)
+			return false;
+
+		m_State = State::kFinished;
+		return true;
+	}
+
+	uint32_t method, flags, ignored;
+	if (!GetBits(8, method) || method != 8 || !GetBits(8, flags) || (flags & kReservedFlags) != 0)
+		return false;
+
+	// Modification time, extra flags and operating system
+	if (!GetBits(32, ignored) || !GetBits(16, ignored))
+		return false;
+
+	if ((flags & kExtraFieldFlag) != 0)
+	{
+		uint32_t extraFieldLength;
+		if (!GetBits(16, extraFieldLength))
+			return false;
+
+		for (uint32_t i = 0; i < extraFieldLength; i++)
+		{
+			if (!GetBits(8, ignored))
+				return false;
+		}
+	}
+
+	// The file name and the comment are both zero terminated
+	for (auto flag : { kFileNameFlag, kCommentFlag })
+	{
+		if ((flags & flag) == 0)
+			continue;
+
+		uint32_t character;
+		do
+		{
+			if (!GetBits(8, character))
+				return false;
+		}
+		while (character != 0);
+	}
+
+	if ((flags & kHeaderCrcFlag) != 0 && !GetBits(16, ignored))
+		return false;
+
+	m_MemberOffset = m_WindowOffset + m_OutputEnd;
+	m_State = State::kBlockHeader;
+	return true;
+}
+
+bool GzipDecoder::ReadBlockHeader()
+{
+	uint32_t isLastBlock, blockType;
+	if (!GetBits(1, isLastBlock) || !GetBits(2, blockType))
+		return false;
+
+	m_IsLastBlock = isLastBlock != 0;
+
+	switch (blockType)
+	{
+	case 0:
+	{
+		m_BitBuffer >>= m_BitCount % 8;
+		m_BitCount -= m_BitCount % 8;
+
+		uint32_t length, lengthComplement;
+		if (!GetBits(16, length) || !GetBits(16, lengthComplement) || length != (~lengthComplement & 0xFFFF))
+			return false;
+
+		m_StoredBytesLeft = length;
+		m_State = State::kStoredBlock;
+		return true;
+	}
+
+	case 1:
+		m_LiteralTable = &m_FixedLiteralTable;
+		m_DistanceTable = &m_FixedDistanceTable;
+		m_State = State::kHuffmanBlock;
+		return true;
+
+	case 2:
+		if (!ReadDynamicTables())
+			return false;
+
+		m_LiteralTable = &m_DynamicLiteralTable;
+		m_DistanceTable = &m_DynamicDistanceTable;
+		m_State = State::kHuffmanBlock;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// The code lengths of a block's codes come Huffman coded themselves, with codes for runs of the same length
+bool GzipDecoder::ReadDynamicTables()
+{
+	uint32_t literalCount, distanceCount, codeLengthCount;
+	if (!GetBits(5, literalCount) || !GetBits(5, distanceCount) || !GetBits(4, codeLengthCount))
+		return false;
+
+	literalCount += 257;
+	distanceCount += 1;
+	codeLengthCount += 4;
+
+	if (literalCount > 286 || distanceCount > 30)
+		return false;
+
+	uint8_t codeLengthCodeLengths[ARRAYSIZE(kCodeLengthOrder)] = {};
+	for (uint32_t i = 0; i < codeLengthCount; i++)
+	{
+		uint32_t codeLength;
+		if (!GetBits(3, codeLength))
+			return false;
+
+		codeLengthCodeLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(codeLength);
+	}
+
+	HuffmanTable codeLengthTable;
+	if (!codeLengthTable.Build(codeLengthCodeLengths, ARRAYSIZE(codeLengthCodeLengths)))
+		return false;
+
+	uint8_t codeLengths[286 + 30];
+	const uint32_t totalCount = literalCount + distanceCount;
+
+	for (uint32_t i = 0; i < totalCount;)
+	{
+		uint32_t symbol;
+		if (!DecodeSymbol(codeLengthTable, symbol))
+			return false;
+
+		if (symbol < 16)
+		{
+			codeLengths[i++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		uint32_t repeatCount;
+		uint8_t codeLength = 0;
+
+		if (symbol == 16)
+		{
+			if (i == 0 || !GetBits(2, repeatCount))
+				return false;
+
+			codeLength = codeLengths[i - 1];
+			repeatCount += 3;
+		}
+		else if (symbol == 17)
+		{
+			if (!GetBits(3, repeatCount))
+				return false;
+
+			repeatCount += 3;
+		}
+		else
+		{
+			if (!GetBits(7, repeatCount))
+				return false;
+
+			repeatCount += 11;
+		}
+
+		if (i + repeatCount > totalCount)
+			return false;
+
+		memset(codeLengths + i, codeLength, repeatCount);
+		i += repeatCount;
+	}
+
+	// A block without an end can't be decoded
+	if (codeLengths[256] == 0)
+		return false;
+
+	return m_DynamicLiteralTable.Build(codeLengths, literalCount) && m_DynamicDistanceTable.Build(codeLengths + literalCount, distanceCount);
+}
+
+bool GzipDecoder::CopyStoredBlock(size_t outputCapacity)
+{
+	auto window = m_Window.get();
+
+	// The header left the bit buffer on a byte boundary. What's in it comes first, then the rest straight from the input
+	while (m_StoredBytesLeft != 0 && m_OutputEnd < outputCapacity)
+	{
+		if (m_BitCount >= 8)
+		{
+			window[m_OutputEnd++] = static_cast<uint8_t>(m_BitBuffer);
+			m_BitBuffer >>= 8;
+			m_BitCount -= 8;
+			m_StoredBytesLeft--;
+			continue;
+		}
+
+		if (m_InputPosition == m_Input.size())
+		{
+			FillBits();
+			if (m_BitCount == 0)
+				return false;
+
+			continue;
+		}
+
+		const auto copyLength = std::min({ static_cast<size_t>(m_StoredBytesLeft), outputCapacity - m_OutputEnd, m_Input.size() - m_InputPosition });
+		memcpy(window + m_OutputEnd, m_Input.data() + m_InputPosition, copyLength);
+		m_OutputEnd += copyLength;
+		m_InputPosition += copyLength;
+		m_StoredBytesLeft -= static_cast<uint32_t>(copyLength);
+	}
+
+	if (m_StoredBytesLeft == 0)
+		m_State = GetStateAfterBlock();
+
+	return true;
+}
+
+bool GzipDecoder::DecodeHuffmanBlock(size_t outputCapacity)
+{
+	auto window = m_Window.get();
+	const auto memberBegin = static_cast<size_t>(m_MemberOffset > m_WindowOffset ? m_MemberOffset - m_WindowOffset : 0);
+
+	while (m_OutputEnd < outputCapacity)
+	{
+		if (m_CopyLength != 0)
+		{
+			const auto copyLength = std::min<size_t>(m_CopyLength, outputCapacity - m_OutputEnd);
+			const auto source = window + m_OutputEnd - m_CopyDistance;
+			const auto destination = window + m_OutputEnd;
+
+			// A back reference can overlap what it produces, so that a distance of 1 repeats a single byte
+			if (m_CopyDistance >= copyLength)
+			{
+				memcpy(destination, source, copyLength);
+			}
+			else
+			{
+				for (size_t i = 0; i < copyLength; i++)
+					destination[i] = source[i];
+			}
+
+			m_OutputEnd += copyLength;
+			m_CopyLength -= static_cast<uint32_t>(copyLength);
+			continue;
+		}
+
+		uint32_t symbol;
+		if (!DecodeSymbol(*m_LiteralTable, symbol))
+			return false;
+
+		if (symbol < 256)
+		{
+			window[m_OutputEnd++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+
+		if (symbol == 256)
+		{
+			m_State = GetStateAfterBlock();
+			return true;
+		}
+
+		symbol -= 257;
+		if (symbol >= ARRAYSIZE(kLengthBase))
+			return false;
+
+		uint32_t extraBits, distanceSymbol;
+		if (!GetBits(kLengthExtraBits[symbol], extraBits))
+			return false;
+
+		m_CopyLength = kLengthBase[symbol] + extraBits;
+
+		if (!DecodeSymbol(*m_DistanceTable, distanceSymbol) || distanceSymbol >= ARRAYSIZE(kDistanceBase) || !GetBits(kDistanceExtraBits[distanceSymbol], extraBits))
+			return false;
+
+		m_CopyDistance = kDistanceBase[distanceSymbol] + extraBits;
+		if (m_CopyDistance > m_OutputEnd - memberBegin)
+			return false;
+	}
+
+	return true;
+}
+
+// The CRC isn't checked, since that would cost about as much as decompressing. The size catches truncated and mangled members well enough
+bool GzipDecoder::ReadMemberTrailer()
+{
+	m_BitBuffer >>= m_BitCount % 8;
+	m_BitCount -= m_BitCount % 8;
+
+	uint32_t crc, size;
+	if (!GetBits(32, crc) || !GetBits(32, size))
+		return false;
+
+	if (size != static_cast<uint32_t>(m_WindowOffset + m_OutputEnd - m_MemberOffset))
+		return false;
+
+	m_HasDecodedMember = true;
+	m_State = State::kMemberHeader;
+	return true;
+}
+
+// Bare deflate data ends with its last block, while a gzip member has its trailer after it and maybe more members after that
+GzipDecoder::State GzipDecoder::GetStateAfterBlock() const
+{
+	if (!m_IsLastBlock)
+		return State::kBlockHeader;
+
+	return m_Format == Format::kGzip ? State::kMemberTrailer : State::kFinished;
+}
+
+GzipDecoder::Status GzipDecoder::Decode(std::span<const uint8_t>& output)
+{
+	// Only the history has to stay in the window, what's before it can go
+	if (m_OutputEnd > m_HistorySize)
+	{
+		const auto discardedLength = m_OutputEnd - m_HistorySize;
+		memmove(m_Window.get(), m_Window.get() + discardedLength, m_HistorySize);
+		m_WindowOffset += discardedLength;
+		m_OutputEnd = m_HistorySize;
+	}
+
+	const auto outputBegin = m_OutputEnd;
+	const auto outputCapacity = outputBegin + kOutputBlockSize;
+
+	while (m_OutputEnd < outputCapacity && m_State != State::kFinished && m_State != State::kCorrupt)
+	{
+		bool succeeded = false;
+
+		switch (m_State)
+		{
+		case State::kMemberHeader:
+			succeeded = ReadMemberHeader();
+			break;
+
+		case State::kBlockHeader:
+			succeeded = ReadBlockHeader();
+			break;
+
+		case State::kStoredBlock:
+			succeeded = CopyStoredBlock(outputCapacity);
+			break;
+
+		case State::kHuffmanBlock:
+			succeeded = DecodeHuffmanBlock(outputCapacity);
+			break;
+
+		case State::kMemberTrailer:
+			succeeded = ReadMemberTrailer();
+			break;
+		}
+
+		if (!succeeded)
+			m_State = State::kCorrupt;
+	}
+
+	// Whatever came out before something went wrong is still worth searching
+	output = std::span<const uint8_t>(m_Window.get() + outputBegin, m_OutputEnd - outputBegin);
+
+	if (!output.empty())
+		return Status::kHasOutput;
+
+	return m_State == State::kFinished ? Status::kFinished : Status::kCorrupt;
+}
\ No newline at end of file
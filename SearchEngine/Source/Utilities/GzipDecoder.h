@@ -0,0 +1,112 @@
+#pragma once
+
+#include "NonCopyable.h"
+
+// Decompresses gzip files (RFC 1952 around RFC 1951 deflate data), member after member, so concatenated ones such as appended rotated logs
+// come out whole, or bare deflate data (RFC 1951), the way zip files store their members. Compressed bytes are pulled from the caller whenever
+// the decoder runs out of them, and what they decompress to comes out a block at a time. The decoder keeps the output that came before each
+// block right in front of it, since back references reach into it
+class GzipDecoder : NonCopyable
+{
+public:
+	enum class Format
+	{
+		kGzip,
+		kDeflate,
+	};
+
+	// Hands over the next compressed bytes, which have to stay put until the next call. Empty at the end of the file
+	typedef std::span<const uint8_t> (*ReadInputCallback)(void* context);
+
+	enum class Status
+	{
+		kHasOutput,
+		kFinished,
+		kCorrupt, // Including files that end in the middle of a member. Whatever came out before that is still good
+	};
+
+	static constexpr size_t kOutputBlockSize = 256 * 1024;
+
+	// At least minHistorySize bytes of earlier output, as far as there is any, are kept in front of every block
+	GzipDecoder(Format format, ReadInputCallback readInput, void* readInputContext, size_t minHistorySize);
+
+	static bool IsGzip(const uint8_t* bytes, size_t length);
+
+	// Decompresses up to kOutputBlockSize bytes, which stay put until the next call
+	Status Decode(std::span<const uint8_t>& output);
+
+private:
+	static constexpr uint32_t kMaxCodeLength = 15;
+	static constexpr uint32_t kFastLookupBits = 10;
+
+	// Canonical Huffman codes. Codes up to kFastLookupBits long are looked up by their bits directly, longer ones are walked a bit at a time
+	struct HuffmanTable
+	{
+		struct Entry
+		{
+			uint16_t symbol;
+			uint8_t length; // 0 for codes too long for the lookup
+		};
+
+		Entry fastLookup[1 << kFastLookupBits];
+		uint16_t lengthCounts[kMaxCodeLength + 1];
+		uint16_t symbols[288];
+
+		bool Build(const uint8_t* codeLengths, uint32_t symbolCount);
+	};
+
+	enum class State
+	{
+		kMemberHeader,
+		kBlockHeader,
+		kStoredBlock,
+		kHuffmanBlock,
+		kMemberTrailer,
+		kFinished,
+		kCorrupt,
+	};
+
+	void FillBits();
+	bool GetBits(uint32_t bitCount, uint32_t& value);
+	bool DecodeSymbol(const HuffmanTable& table, uint32_t& symbol);
+
+	bool ReadMemberHeader();
+	bool ReadBlockHeader();
+	bool ReadDynamicTables();
+	bool CopyStoredBlock(size_t outputCapacity);
+	bool DecodeHuffmanBlock(size_t outputCapacity);
+	bool ReadMemberTrailer();
+	State GetStateAfterBlock() const;
+
+private:
+	const Format m_Format;
+	ReadInputCallback m_ReadInput;
+	void* m_ReadInputContext;
+	std::span<const uint8_t> m_Input;
+	size_t m_InputPosition;
+	bool m_IsInputEnd;
+
+	uint64_t m_BitBuffer;
+	uint32_t m_BitCount;
+
+	State m_State;
+	bool m_IsLastBlock;
+	bool m_HasDecodedMember;
+	uint32_t m_StoredBytesLeft;
+	uint32_t m_CopyLength; // Of a back reference that didn't fit in the last block
+	uint32_t m_CopyDistance;
+
+	const HuffmanTable* m_LiteralTable;
+	const HuffmanTable* m_DistanceTable;
+	HuffmanTable m_DynamicLiteralTable;
+	HuffmanTable m_DynamicDistanceTable;
+	HuffmanTable m_FixedLiteralTable;
+	HuffmanTable m_FixedDistanceTable;
+
+	// Earlier output followed by the current block
+	const size_t m_HistorySize;
+	std::unique_ptr<uint8_t[]> m_Window;
+	size_t m_OutputEnd;
+	uint64_t m_WindowOffset; // Of the start of the window in the output
+	uint64_t m_MemberOffset; // Of the start of the current member. Back references can't reach past it
+};
\ No newline at end of file
@@ -11,13 +11,13 @@ private:
 	SLIST_HEADER* m_WorkList;
 	SemaphoreHandleHolder m_WorkSemaphore;
 
+protected:
 	struct WorkEntry
 	{
 		SLIST_ENTRY slistEntry;
 		WorkItem workItem;
 	};
 
-protected:
 	inline WorkQueue() :
 		m_WorkList(nullptr)
 	{
@@ -144,6 +144,51 @@ public:
 		}
 	}
 
+	// Same as DoWork, but hands the callback everything that's already queued when it wakes up, up to maxBatchSize items at once.
+	// It never waits for a batch to fill up. An item isBatchable turns down ends the batch it's in, so items that take long never
+	// pile up behind each other on one thread while the others sit idle
+	template <typename IsBatchable, typename Callback>
+	inline void DoBatchedWork(size_t maxBatchSize, IsBatchable&& isBatchable, Callback&& callback)
+	{
+		std::vector<typename MyBase::WorkEntry*> workEntries;
+		std::vector<WorkItem*> workItems;
+		bool isDone = false;
+
+		while (!isDone)
+		{
+			auto waitResult = WaitForSingleObject(MyBase::GetWorkSemaphore(), INFINITE);
+			Assert(waitResult == WAIT_OBJECT_0);
+
+			// Every item taken has to take its count off the semaphore too, or another thread would wake up to an empty queue and quit
+			for (;;)
+			{
+				auto workEntry = MyBase::PopWorkEntry();
+				if (workEntry == nullptr)
+				{
+					isDone = true;
+					break;
+				}
+
+				workEntries.push_back(workEntry);
+				workItems.push_back(&workEntry->workItem);
+
+				if (workEntries.size() == maxBatchSize || !isBatchable(workEntry->workItem) || WaitForSingleObject(MyBase::GetWorkSemaphore(), 0) != WAIT_OBJECT_0)
+					break;
+			}
+
+			if (workEntries.empty())
+				continue;
+
+			callback(std::span<WorkItem* const>(workItems));
+
+			for (auto workEntry : workEntries)
+				MyBase::DeleteWorkEntry(workEntry);
+
+			workEntries.clear();
+			workItems.clear();
+		}
+	}
+
 	inline void CompleteAllWork()
 	{
 		if (m_WorkerThreadHandles.empty())
@@ -8,7 +8,7 @@
 struct TestStringSearcher
 {
 	TestStringSearcher(const wchar_t* searchString, SearchFlags searchFlags) :
-		m_SearchInstructions(nullptr, nullptr, nullptr, nullptr, L"", L"", searchString, searchFlags, 0, nullptr),
+		m_SearchInstructions(nullptr, nullptr, nullptr, nullptr, L"", L"", searchString, searchFlags, 0, std::numeric_limits<uint64_t>::max(), 0, 0, nullptr),
 		m_StringSearcher(m_SearchInstructions)
 	{
 	}
@@ -1,6 +1,7 @@
 #include "PrecompiledHeader.h"
 #include "TestMacros.h"
 #include "TestHelpers.h"
+#include "StringUtils.h"
 
 // Extensive edge-case functional tests for the SearchEngine
 
@@ -181,6 +182,9 @@ SEARCH_TEST(SearchStringLongerThanMaximumLengthRaisesError)
         std::wstring(1025, L'A').c_str(),
         SearchFlags::kSearchForFiles | SearchFlags::kSearchInFilePath | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8,
         std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
         &testContext);
 
     if (searcher != nullptr)
@@ -193,4 +197,31 @@ SEARCH_TEST(SearchStringLongerThanMaximumLengthRaisesError)
 
     CHECK(!testContext.errors.empty(), L"Search operation with too long search string did not produce errors.");
     CHECK(!testContext.foundSomething, L"Search operation with too long search string should not find any files.");
+}
+
+TEST(UnicodeTranscodingMatchesWin32Conversions)
+{
+    // Long enough ASCII runs to go through the vectorized paths, mixed with every UTF-8 sequence length
+    const std::wstring testStrings[] =
+    {
+        L"",
+        L"C:\\Windows\\System32\\drivers\\etc\\hosts",
+        L"caf\u00E9 na\u00EFve r\u00E9sum\u00E9 with a long ASCII tail after it",
+        L"\u20AC\u4E2D\u6587\U0001F600 mixed \u0394\u03B5\u03BB\u03C4\u03B1 and plain text of all kinds",
+        L"\U0001F600\U0001F600\U0001F600\U0001F600\U0001F600\U0001F600\U0001F600\U0001F600",
+    };
+
+    for (const auto& testString : testStrings)
+    {
+        auto win32Utf8Length = WideCharToMultiByte(CP_UTF8, 0, testString.data(), static_cast<int>(testString.length()), nullptr, 0, nullptr, nullptr);
+        std::string win32Utf8(win32Utf8Length, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, testString.data(), static_cast<int>(testString.length()), win32Utf8.data(), win32Utf8Length, nullptr, nullptr);
+
+        CHECK(StringUtils::Utf16ToUtf8(testString) == win32Utf8, std::format(L"UTF-8 encoding of '{}' does not match WideCharToMultiByte", testString));
+        CHECK(StringUtils::Utf8ToUtf16(win32Utf8) == testString, std::format(L"UTF-8 decoding of '{}' did not round trip", testString));
+    }
+
+    // Lone surrogates, truncated sequences and bytes that can never appear in UTF-8 each become one U+FFFD
+    CHECK(StringUtils::Utf16ToUtf8(std::wstring_view(L"a\xD800" L"b\xDC00", 4)) == "a\xEF\xBF\xBD" "b\xEF\xBF\xBD", L"Lone surrogates were not replaced");
+    CHECK(StringUtils::Utf8ToUtf16("a\xE2\x82" "b\xFF" "c\xC0\xAF") == L"a\xFFFD" L"b\xFFFD" L"c\xFFFD\xFFFD", L"Invalid UTF-8 was not replaced");
 }
\ No newline at end of file
@@ -0,0 +1,1013 @@
+#include "PrecompiledHeader.h"
+#include "TestMacros.h"
+#include "TestHelpers.h"
+
+#include <winioctl.h>
+
+// Functional tests for the optional search behaviours that sit on top of plain name and content searches
+
+SEARCH_TEST(MaxResultsLimitsFileContentResults)
+{
+    constexpr char kTestData[] = "needle in a haystack";
+
+    std::vector<Testing::TestFile> testFiles;
+    for (int i = 0; i < 16; i++)
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"file{}.txt", i), std::span<const char>(kTestData, sizeof(kTestData) - 1));
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8, std::numeric_limits<uint64_t>::max(), 3);
+
+    CHECK(searchResults.size() == 3, std::format(L"Expected exactly 3 search results, found {}", searchResults.size()));
+}
+
+SEARCH_TEST(MaxResultsLimitsFileNameResults)
+{
+    constexpr char kTestData[] = "x";
+
+    std::vector<Testing::TestFile> testFiles;
+    for (int i = 0; i < 16; i++)
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"limited{}.txt", i), std::span<const char>(kTestData, sizeof(kTestData) - 1));
+
+    auto searchResults = PerformTestSearch(L"*", L"limited", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileName, std::numeric_limits<uint64_t>::max(), 1);
+
+    CHECK(searchResults.size() == 1, std::format(L"Expected exactly 1 search result, found {}", searchResults.size()));
+}
+
+SEARCH_TEST(MaxResultsZeroFindsNothing)
+{
+    constexpr char kTestData[] = "needle";
+    Testing::TestFile testFile(GetTestDirectory(), L"needle.txt", std::span<const char>(kTestData, sizeof(kTestData) - 1));
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileName | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8, std::numeric_limits<uint64_t>::max(), 0);
+
+    CHECK(searchResults.empty(), L"A search with a result limit of zero should not report anything");
+}
+
+SEARCH_TEST(SkipBinaryFilesIgnoresBinaryContent)
+{
+    std::vector<char> binaryData(4096);
+    for (size_t i = 0; i < binaryData.size(); i++)
+        binaryData[i] = static_cast<char>(i % 7 == 0 ? 0 : i * 31);
+
+    constexpr char kNeedle[] = "needle";
+    memcpy(binaryData.data() + 1000, kNeedle, sizeof(kNeedle) - 1);
+
+    constexpr char kTextData[] = "a plain text file with a needle in it\r\n";
+
+    Testing::TestFile binaryFile(GetTestDirectory(), L"binary.bin", binaryData);
+    Testing::TestFile textFile(GetTestDirectory(), L"text.txt", std::span<const char>(kTextData, sizeof(kTextData) - 1));
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8);
+    CHECK(searchResults.size() == 2, std::format(L"Expected 2 search results without skipping binary files, found {}", searchResults.size()));
+
+    searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSkipBinaryFiles);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 search result when skipping binary files, found {}", searchResults.size()));
+    CHECK(searchResults.front() == textFile.GetPath(), std::format(L"Expected to find '{}', found '{}'", textFile.GetPath(), searchResults.front()));
+}
+
+SEARCH_TEST(SkipBinaryFilesKeepsUtf16Text)
+{
+    constexpr wchar_t kTextData[] = L"\xFEFFUTF-16 text files are full of zero bytes but still contain a needle";
+    Testing::TestFile textFile(GetTestDirectory(), L"utf16.txt", std::span<const char>(reinterpret_cast<const char*>(kTextData), sizeof(kTextData) - sizeof(wchar_t)));
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf16 | SearchFlags::kSkipBinaryFiles);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 search result, found {}", searchResults.size()));
+}
+
+SEARCH_TEST(IgnoreWhitespaceMatchesAnyWhitespaceRun)
+{
+    constexpr char kTestData[] = "int main(int argc,\r\n\t\tchar** argv)\r\n{\r\n}\r\n";
+    Testing::TestFile testFile(GetTestDirectory(), L"main.cpp", std::span<const char>(kTestData, sizeof(kTestData) - 1));
+
+    auto searchResults = PerformTestSearch(L"*", L"int argc, char** argv", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8);
+    CHECK(searchResults.empty(), L"Whitespace differences should prevent a match unless kIgnoreWhitespace is set");
+
+    searchResults = PerformTestSearch(L"*", L"int argc, char** argv", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreWhitespace);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 search result, found {}", searchResults.size()));
+
+    searchResults = PerformTestSearch(L"*", L"int argc,char** argv", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreWhitespace);
+    CHECK(searchResults.empty(), L"Whitespace in the text should not match where the search string has none");
+}
+
+SEARCH_TEST(IgnoreWhitespaceMatchesAcrossChunkSeams)
+{
+    // 8 MB is a chunk boundary for every read backend, whatever chunk size the file gets
+    constexpr size_t kSeamOffset = 8 * 1024 * 1024;
+    constexpr char kPhrase[] = "first\r\n    \t\r\n    second";
+
+    std::vector<char> testData(kSeamOffset + 4096, 'x');
+    memcpy(testData.data() + kSeamOffset - 10, kPhrase, sizeof(kPhrase) - 1);
+
+    Testing::TestFile testFile(GetTestDirectory(), L"seam.txt", testData);
+
+    auto searchResults = PerformTestSearch(L"*", L"first second", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreWhitespace);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 search result, found {}", searchResults.size()));
+}
+
+SEARCH_TEST(IgnoreWhitespaceUtf16CaseInsensitive)
+{
+    constexpr wchar_t kTestData[] = L"\xFEFFThe Quick\t\tBrown\r\nFox";
+    Testing::TestFile testFile(GetTestDirectory(), L"utf16.txt", std::span<const char>(reinterpret_cast<const char*>(kTestData), sizeof(kTestData) - sizeof(wchar_t)));
+
+    auto searchResults = PerformTestSearch(L"*", L"quick brown fox", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf16 | SearchFlags::kIgnoreCase | SearchFlags::kIgnoreWhitespace);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 search result, found {}", searchResults.size()));
+}
+
+SEARCH_TEST(DictionarySearchReportsMatchedEntriesPerFile)
+{
+    constexpr char kDictionary[] = "alpha\r\nbeta\n\ngamma\ndelta";
+    constexpr char kFirstFile[] = "some alpha text followed by gamma";
+    constexpr char kSecondFile[] = "just beta here";
+    constexpr char kThirdFile[] = "nothing of interest";
+
+    auto dictionaryDirectory = GetTestDirectory().SubDirectory(L"dictionary");
+    Testing::TestFile dictionary(dictionaryDirectory, L"entries.dic", std::span<const char>(kDictionary, sizeof(kDictionary) - 1));
+    Testing::TestFile firstFile(GetTestDirectory(), L"first.txt", std::span<const char>(kFirstFile, sizeof(kFirstFile) - 1));
+    Testing::TestFile secondFile(GetTestDirectory(), L"second.txt", std::span<const char>(kSecondFile, sizeof(kSecondFile) - 1));
+    Testing::TestFile thirdFile(GetTestDirectory(), L"third.txt", std::span<const char>(kThirdFile, sizeof(kThirdFile) - 1));
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::map<std::wstring, std::vector<uint32_t>> matchedEntries;
+        std::vector<std::wstring> foundPaths;
+        std::vector<std::wstring> errors;
+        SearchStatistics statistics = {};
+    } testContext;
+
+    auto searcher = ::SearchWithDictionary(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics& statistics)
+        {
+            static_cast<TestContext*>(context)->statistics = statistics;
+            static_cast<TestContext*>(context)->doneEvent.Set();
+        },
+        [](void* context, const wchar_t* errorMessage) { static_cast<TestContext*>(context)->errors.emplace_back(errorMessage); },
+        [](void* context, const wchar_t* path, const uint32_t* matchedEntries, uint32_t matchedEntryCount)
+        {
+            static_cast<TestContext*>(context)->matchedEntries[path].assign(matchedEntries, matchedEntries + matchedEntryCount);
+        },
+        GetTestDirectory().c_str(),
+        L"*.txt",
+        dictionary.GetPath().c_str(),
+        SearchFlags::kSearchContentsAsUtf8 | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start dictionary search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    CHECK(testContext.errors.empty(), L"Dictionary search encountered errors");
+    CHECK(testContext.foundPaths.size() == 2, std::format(L"Expected 2 search results, found {}", testContext.foundPaths.size()));
+    CHECK(testContext.matchedEntries[firstFile.GetPath()] == std::vector<uint32_t>({ 0, 3 }), L"Wrong dictionary entries reported for the first file");
+    CHECK(testContext.matchedEntries[secondFile.GetPath()] == std::vector<uint32_t>({ 1 }), L"Wrong dictionary entries reported for the second file");
+    CHECK(testContext.statistics.dictionaryEntryCount == 4, std::format(L"Expected 4 dictionary entries, got {}", testContext.statistics.dictionaryEntryCount));
+    CHECK(testContext.statistics.dictionaryMemoryUsage > 0, L"Dictionary memory usage was not reported");
+}
+
+SEARCH_TEST(InvertContentMatchReportsFilesWithoutMatch)
+{
+    constexpr char kLicensed[] = "// Licensed under the MIT license\r\nint x;\r\n";
+    constexpr char kUnlicensed[] = "int y;\r\n";
+
+    // Only the very end of the big file rules it out, so every chunk of it has to be searched
+    std::vector<char> bigUnlicensed(6 * 1024 * 1024, ' ');
+    constexpr char kLateMatch[] = "Licensed under";
+    memcpy(bigUnlicensed.data() + bigUnlicensed.size() - sizeof(kLateMatch), kLateMatch, sizeof(kLateMatch) - 1);
+
+    Testing::TestFile licensedFile(GetTestDirectory(), L"licensed.cpp", std::span<const char>(kLicensed, sizeof(kLicensed) - 1));
+    Testing::TestFile unlicensedFile(GetTestDirectory(), L"unlicensed.cpp", std::span<const char>(kUnlicensed, sizeof(kUnlicensed) - 1));
+    Testing::TestFile emptyFile(GetTestDirectory(), L"empty.cpp", std::span<const char>());
+    Testing::TestFile bigFile(GetTestDirectory(), L"big.cpp", bigUnlicensed);
+
+    auto searchResults = PerformTestSearch(L"*", L"Licensed under", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kInvertContentMatch);
+    std::sort(searchResults.begin(), searchResults.end());
+
+    std::vector<std::wstring> expectedResults = { emptyFile.GetPath(), unlicensedFile.GetPath() };
+    std::sort(expectedResults.begin(), expectedResults.end());
+
+    CHECK(searchResults == expectedResults, std::format(L"Expected only the files without a license header, found {} results", searchResults.size()));
+}
+
+
+SEARCH_TEST(ProximitySearchFindsTermsWithinDistance)
+{
+    constexpr uint32_t kMaxDistance = 256;
+    constexpr char kNearFile[] = "request timeout after 30s, then a connection ERROR was logged";
+
+    std::vector<char> farFile(4096, ' ');
+    memcpy(farFile.data(), "error", 5);
+    memcpy(farFile.data() + 1000, "timeout", 7);
+
+    // The pair straddles 8 MB, which is a chunk boundary for every read backend
+    constexpr size_t kSeamOffset = 8 * 1024 * 1024;
+    std::vector<char> seamFile(kSeamOffset + 4096, ' ');
+    memcpy(seamFile.data() + kSeamOffset - 100, "error", 5);
+    memcpy(seamFile.data() + kSeamOffset + 100, "timeout", 7);
+
+    Testing::TestFile nearTestFile(GetTestDirectory(), L"near.txt", std::span<const char>(kNearFile, sizeof(kNearFile) - 1));
+    Testing::TestFile farTestFile(GetTestDirectory(), L"far.txt", farFile);
+    Testing::TestFile seamTestFile(GetTestDirectory(), L"seam.txt", seamFile);
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+        std::vector<std::wstring> errors;
+    } testContext;
+
+    auto searcher = ::SearchWithProximity(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics&) { static_cast<TestContext*>(context)->doneEvent.Set(); },
+        [](void* context, const wchar_t* errorMessage) { static_cast<TestContext*>(context)->errors.emplace_back(errorMessage); },
+        GetTestDirectory().c_str(),
+        L"*.txt",
+        L"error",
+        L"timeout",
+        kMaxDistance,
+        SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreCase | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start proximity search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    std::sort(testContext.foundPaths.begin(), testContext.foundPaths.end());
+    std::vector<std::wstring> expectedResults = { nearTestFile.GetPath(), seamTestFile.GetPath() };
+    std::sort(expectedResults.begin(), expectedResults.end());
+
+    CHECK(testContext.errors.empty(), L"Proximity search encountered errors");
+    CHECK(testContext.foundPaths == expectedResults, std::format(L"Expected the near and seam files only, found {} results", testContext.foundPaths.size()));
+}
+
+SEARCH_TEST(ProximitySearchWithEqualTermsFindsTwoOccurrences)
+{
+    constexpr char kTwiceFile[] = "error: disk full, then another ERROR right after";
+    constexpr char kOnceFile[] = "a single error and nothing else";
+
+    std::vector<char> farFile(4096, ' ');
+    memcpy(farFile.data(), "error", 5);
+    memcpy(farFile.data() + 1000, "error", 5);
+
+    Testing::TestFile twiceTestFile(GetTestDirectory(), L"twice.txt", std::span<const char>(kTwiceFile, sizeof(kTwiceFile) - 1));
+    Testing::TestFile onceTestFile(GetTestDirectory(), L"once.txt", std::span<const char>(kOnceFile, sizeof(kOnceFile) - 1));
+    Testing::TestFile farTestFile(GetTestDirectory(), L"far.txt", farFile);
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+        std::vector<std::wstring> errors;
+    } testContext;
+
+    auto searcher = ::SearchWithProximity(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics&) { static_cast<TestContext*>(context)->doneEvent.Set(); },
+        [](void* context, const wchar_t* errorMessage) { static_cast<TestContext*>(context)->errors.emplace_back(errorMessage); },
+        GetTestDirectory().c_str(),
+        L"*.txt",
+        L"error",
+        L"Error",
+        256,
+        SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreCase | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start proximity search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    CHECK(testContext.errors.empty(), L"Proximity search encountered errors");
+    CHECK(testContext.foundPaths == std::vector<std::wstring>({ twiceTestFile.GetPath() }), std::format(L"Expected only the file with two close occurrences, found {} results", testContext.foundPaths.size()));
+}
+
+SEARCH_TEST(FileMappingFindsSameResultsAsReads)
+{
+    // Enough files above the mapping threshold that the reader sees the cache is warm and starts mapping them
+    constexpr size_t kFileSize = 512 * 1024;
+    std::vector<char> fileContents(kFileSize, 'x');
+    memcpy(fileContents.data() + kFileSize - 100, "NEEDLE", 6);
+
+    std::vector<Testing::TestFile> testFiles;
+    for (int i = 0; i < 32; i++)
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"file{}.txt", i), fileContents);
+
+    constexpr size_t kSeamOffset = 5 * 1024 * 1024;
+    std::vector<char> seamFileContents(kSeamOffset + 4096, 'x');
+    memcpy(seamFileContents.data() + kSeamOffset - 3, "NEEDLE", 6);
+    Testing::TestFile seamFile(GetTestDirectory(), L"seam.txt", seamFileContents);
+
+    auto searchResults = PerformTestSearch(L"*", L"NEEDLE", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kUseFileMapping);
+    CHECK(searchResults.size() == testFiles.size() + 1, std::format(L"Expected {} search results, found {}", testFiles.size() + 1, searchResults.size()));
+
+    // Case insensitive searches lower case what they search in place, so they read the files even when mapping is asked for
+    searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreCase | SearchFlags::kUseFileMapping);
+    CHECK(searchResults.size() == testFiles.size() + 1, std::format(L"Expected {} case insensitive search results, found {}", testFiles.size() + 1, searchResults.size()));
+
+    // What they lower case must never reach the files themselves
+    FileHandleHolder seamFileHandle = CreateFileW(seamFile.GetPath().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    CHECK(seamFileHandle != INVALID_HANDLE_VALUE, L"Failed to open the seam file");
+
+    std::vector<char> contentsAfterSearch(seamFileContents.size());
+    DWORD bytesRead;
+    CHECK(ReadFile(seamFileHandle, contentsAfterSearch.data(), static_cast<DWORD>(contentsAfterSearch.size()), &bytesRead, nullptr) && bytesRead == contentsAfterSearch.size(), L"Failed to read the seam file");
+    CHECK(contentsAfterSearch == seamFileContents, L"Searching modified the file");
+}
+
+SEARCH_TEST(FileMappingProximitySearchIgnoresCase)
+{
+    // Enough files above the mapping threshold that the reader sees the cache is warm and starts mapping them
+    constexpr size_t kFileSize = 512 * 1024;
+    std::vector<char> fileContents(kFileSize, 'x');
+    memcpy(fileContents.data() + kFileSize - 200, "ERROR", 5);
+    memcpy(fileContents.data() + kFileSize - 100, "TIMEOUT", 7);
+
+    std::vector<Testing::TestFile> testFiles;
+    for (int i = 0; i < 32; i++)
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"file{}.txt", i), fileContents);
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+        std::vector<std::wstring> errors;
+    } testContext;
+
+    auto searcher = ::SearchWithProximity(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics&) { static_cast<TestContext*>(context)->doneEvent.Set(); },
+        [](void* context, const wchar_t* errorMessage) { static_cast<TestContext*>(context)->errors.emplace_back(errorMessage); },
+        GetTestDirectory().c_str(),
+        L"*.txt",
+        L"error",
+        L"timeout",
+        256,
+        SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreCase | SearchFlags::kUseFileMapping | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start proximity search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    CHECK(testContext.errors.empty(), L"Proximity search encountered errors");
+    CHECK(testContext.foundPaths.size() == testFiles.size(), std::format(L"Expected {} search results, found {}", testFiles.size(), testContext.foundPaths.size()));
+
+    // The terms are lower cased in place, which must never reach the files themselves
+    FileHandleHolder fileHandle = CreateFileW(testFiles.back().GetPath().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    CHECK(fileHandle != INVALID_HANDLE_VALUE, L"Failed to open the searched file");
+
+    std::vector<char> contentsAfterSearch(fileContents.size());
+    DWORD bytesRead;
+    CHECK(ReadFile(fileHandle, contentsAfterSearch.data(), static_cast<DWORD>(contentsAfterSearch.size()), &bytesRead, nullptr) && bytesRead == contentsAfterSearch.size(), L"Failed to read the searched file");
+    CHECK(contentsAfterSearch == fileContents, L"Searching modified the file");
+}
+
+SEARCH_TEST(UnbufferedReadsFindMatchesAtSeamsAndInPartialSectors)
+{
+    // 8 MB is a chunk boundary, and neither file ends on a sector boundary
+    constexpr size_t kSeamOffset = 8 * 1024 * 1024;
+
+    std::vector<char> seamFileContents(kSeamOffset + 1234, 'x');
+    memcpy(seamFileContents.data() + kSeamOffset - 3, "needle", 6);
+
+    std::vector<char> tailFileContents(kSeamOffset + 1234, 'x');
+    memcpy(tailFileContents.data() + tailFileContents.size() - 6, "needle", 6);
+
+    std::vector<char> missFileContents(kSeamOffset + 1234, 'x');
+
+    Testing::TestFile seamFile(GetTestDirectory(), L"seam.txt", seamFileContents);
+    Testing::TestFile tailFile(GetTestDirectory(), L"tail.txt", tailFileContents);
+    Testing::TestFile missFile(GetTestDirectory(), L"miss.txt", missFileContents);
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kUseUnbufferedIO);
+    std::sort(searchResults.begin(), searchResults.end());
+
+    std::vector<std::wstring> expectedResults = { seamFile.GetPath(), tailFile.GetPath() };
+    std::sort(expectedResults.begin(), expectedResults.end());
+
+    CHECK(searchResults == expectedResults, std::format(L"Expected the seam and tail files only, found {} results", searchResults.size()));
+}
+
+SEARCH_TEST(SmallFilesAreSearchedAcrossBatchAndSizeLimits)
+{
+    // More files than fit in one batch, from empty up to just past the largest size that's read whole. Only the results are checked:
+    // batched reads find the same files as reads one at a time
+    std::vector<Testing::TestFile> testFiles;
+    std::vector<std::wstring> expectedResults;
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        std::vector<char> fileContents(i * 661, 'x');
+        if (i % 3 == 0 && fileContents.size() >= 6)
+            memcpy(fileContents.data() + fileContents.size() - 6, "needle", 6);
+
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"file{}.txt", i), fileContents);
+        if (i % 3 == 0 && i > 0)
+            expectedResults.push_back(testFiles.back().GetPath());
+    }
+
+    for (size_t fileSize : { 64 * 1024, 64 * 1024 + 1 })
+    {
+        std::vector<char> fileContents(fileSize, 'x');
+        memcpy(fileContents.data() + fileSize - 6, "needle", 6);
+
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"edge{}.txt", fileSize), fileContents);
+        expectedResults.push_back(testFiles.back().GetPath());
+    }
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8);
+    std::sort(searchResults.begin(), searchResults.end());
+    std::sort(expectedResults.begin(), expectedResults.end());
+
+    CHECK(searchResults == expectedResults, std::format(L"Expected {} search results, found {}", expectedResults.size(), searchResults.size()));
+}
+
+SEARCH_TEST(LargeFilesAreSearchedInRanges)
+{
+    // Big enough to be split into 64 MB ranges, with the only match straddling the boundary between the second and third one
+    constexpr size_t kRangeBoundary = 128 * 1024 * 1024;
+    std::vector<char> fileContents(2 * kRangeBoundary + 4096, 'x');
+    memcpy(fileContents.data() + kRangeBoundary - 3, "needle", 6);
+
+    Testing::TestFile testFile(GetTestDirectory(), L"large.txt", fileContents);
+
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 search result, found {}", searchResults.size()));
+
+    searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kInvertContentMatch);
+    CHECK(searchResults.empty(), std::format(L"Expected no inverted results, found {}", searchResults.size()));
+
+    searchResults = PerformTestSearch(L"*", L"haystack", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kInvertContentMatch);
+    CHECK(searchResults.size() == 1, std::format(L"Expected 1 inverted result, found {}", searchResults.size()));
+}
+
+SEARCH_TEST(SearchCompletesWithOneReadInFlightPerDevice)
+{
+    // Every thread but one waits for room on the device, whether it's on a small file, a file read in chunks, or a range of a split one
+    std::vector<Testing::TestFile> testFiles;
+    std::vector<std::wstring> expectedResults;
+
+    for (size_t i = 0; i < 64; i++)
+    {
+        std::vector<char> fileContents(1000 + i * 97, 'x');
+        if (i % 2 == 0)
+            memcpy(fileContents.data() + fileContents.size() - 6, "needle", 6);
+
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"small{}.txt", i), fileContents);
+        if (i % 2 == 0)
+            expectedResults.push_back(testFiles.back().GetPath());
+    }
+
+    std::vector<char> chunkedFileContents(20 * 1024 * 1024, 'x');
+    memcpy(chunkedFileContents.data() + chunkedFileContents.size() - 6, "needle", 6);
+    testFiles.emplace_back(GetTestDirectory(), L"chunked.txt", chunkedFileContents);
+    expectedResults.push_back(testFiles.back().GetPath());
+
+    std::vector<char> splitFileContents(256 * 1024 * 1024 + 4096, 'x');
+    memcpy(splitFileContents.data() + splitFileContents.size() - 6, "needle", 6);
+    testFiles.emplace_back(GetTestDirectory(), L"split.txt", splitFileContents);
+    expectedResults.push_back(testFiles.back().GetPath());
+
+    // Put back even when a check fails, or every search after this one would be held to a single read too
+    struct QueueDepthOverride
+    {
+        QueueDepthOverride(uint32_t queueDepth) { ::SetReadQueueDepthOverride(queueDepth); }
+        ~QueueDepthOverride() { ::SetReadQueueDepthOverride(0); }
+    };
+
+    QueueDepthOverride queueDepthOverride(1);
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+        SearchStatistics statistics;
+    } testContext;
+
+    auto searcher = ::Search(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics& searchStatistics)
+        {
+            auto testContext = static_cast<TestContext*>(context);
+            testContext->statistics = searchStatistics;
+            testContext->doneEvent.Set();
+        },
+        [](void*, const wchar_t*) {},
+        GetTestDirectory().c_str(),
+        L"*",
+        L"needle",
+        SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    std::sort(testContext.foundPaths.begin(), testContext.foundPaths.end());
+    std::sort(expectedResults.begin(), expectedResults.end());
+
+    CHECK(testContext.foundPaths == expectedResults, std::format(L"Expected {} search results, found {}", expectedResults.size(), testContext.foundPaths.size()));
+
+    // DirectStorage queues its reads itself, without a limit per device
+    if constexpr (ExtraSearchFlags != SearchFlags::kUseDirectStorage)
+    {
+        const auto maxReadsInFlight = testContext.statistics.maxDeviceReadsInFlight;
+        CHECK(maxReadsInFlight == 1, std::format(L"Expected at most 1 read in flight on the device, counted {}", maxReadsInFlight));
+    }
+}
+
+SEARCH_TEST(ReadRateLimitHoldsContentReadsToBudget)
+{
+    // 8 MB at 4 MB a second takes 2 seconds, less the credit the budget starts out with and the first read, which goes right away
+    constexpr uint64_t kMaxBytesPerSecond = 4 * 1024 * 1024;
+    std::vector<Testing::TestFile> testFiles;
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        std::vector<char> fileContents(1024 * 1024, 'x');
+        memcpy(fileContents.data() + fileContents.size() - 6, "needle", 6);
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"file{}.txt", i), fileContents);
+    }
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+    } testContext;
+
+    const auto searchStart = GetTickCount64();
+    auto searcher = ::Search(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics&) { static_cast<TestContext*>(context)->doneEvent.Set(); },
+        [](void*, const wchar_t*) {},
+        GetTestDirectory().c_str(),
+        L"*",
+        L"needle",
+        SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        kMaxBytesPerSecond,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+
+    const auto searchDuration = GetTickCount64() - searchStart;
+    CleanupSearchOperation(searcher);
+
+    CHECK(testContext.foundPaths.size() == testFiles.size(), std::format(L"Expected {} search results, found {}", testFiles.size(), testContext.foundPaths.size()));
+    CHECK(searchDuration >= 1500, std::format(L"Expected the search to take at least 1.5 seconds, took {} ms", searchDuration));
+}
+
+SEARCH_TEST(CacheNeutralReadsAccountForEveryByteRead)
+{
+    std::vector<Testing::TestFile> testFiles;
+    uint64_t totalFileSize = 0;
+
+    for (size_t i = 0; i < 32; i++)
+    {
+        std::vector<char> fileContents(4096 + i * 100, 'x');
+        memcpy(fileContents.data() + fileContents.size() - 6, "needle", 6);
+        testFiles.emplace_back(GetTestDirectory(), std::format(L"small{}.txt", i), fileContents);
+        totalFileSize += fileContents.size();
+    }
+
+    std::vector<char> largeFileContents(3 * 1024 * 1024 + 123, 'x');
+    memcpy(largeFileContents.data() + largeFileContents.size() / 2, "needle", 6);
+    testFiles.emplace_back(GetTestDirectory(), L"large.txt", largeFileContents);
+    totalFileSize += largeFileContents.size();
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+        SearchStatistics statistics;
+    } testContext;
+
+    auto searcher = ::Search(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics& searchStatistics)
+        {
+            auto testContext = static_cast<TestContext*>(context);
+            testContext->statistics = searchStatistics;
+            testContext->doneEvent.Set();
+        },
+        [](void*, const wchar_t*) {},
+        GetTestDirectory().c_str(),
+        L"*",
+        L"needle",
+        SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kCacheNeutralReads | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    CHECK(testContext.foundPaths.size() == testFiles.size(), std::format(L"Expected {} search results, found {}", testFiles.size(), testContext.foundPaths.size()));
+
+    // DirectStorage reads don't go through the cache at all, so there's nothing to tell apart
+    if constexpr (ExtraSearchFlags != SearchFlags::kUseDirectStorage)
+    {
+        const auto bytesRead = static_cast<uint64_t>(testContext.statistics.bytesReadFromCache + testContext.statistics.bytesReadFromDisk);
+        CHECK(bytesRead >= totalFileSize, std::format(L"Expected at least {} bytes read from cache or disk, counted {}", totalFileSize, bytesRead));
+    }
+}
+
+SEARCH_TEST(SparseFileHolesAreSearchedAsZeros)
+{
+    // 64 KB is the unit sparse files get allocated in, and the blocks sit well past the first chunk of a file this size
+    constexpr uint64_t kFileSize = 96 * 1024 * 1024;
+    constexpr uint64_t kBlockSize = 64 * 1024;
+    constexpr uint64_t kMiddle = kFileSize / 2;
+
+    struct DataBlock
+    {
+        uint64_t offset;
+        std::string_view text;
+        bool isTextAtEnd;
+    };
+
+    auto writeSparseFile = [](const Testing::TestFile& testFile, std::initializer_list<DataBlock> blocks)
+    {
+        FileHandleHolder fileHandle = CreateFileW(testFile.GetPath().c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        CHECK(fileHandle != INVALID_HANDLE_VALUE, std::format(L"Failed to open '{}': {}", testFile.GetPath(), GetLastError()));
+
+        DWORD bytesReturned;
+        CHECK(DeviceIoControl(fileHandle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytesReturned, nullptr), std::format(L"Failed to make '{}' sparse: {}", testFile.GetPath(), GetLastError()));
+
+        FILE_END_OF_FILE_INFO endOfFile = {};
+        endOfFile.EndOfFile.QuadPart = kFileSize;
+        CHECK(SetFileInformationByHandle(fileHandle, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile)), L"Failed to set the file size");
+
+        for (const auto& dataBlock : blocks)
+        {
+            std::vector<char> block(kBlockSize, 'x');
+            memcpy(block.data() + (dataBlock.isTextAtEnd ? block.size() - dataBlock.text.size() : 0), dataBlock.text.data(), dataBlock.text.size());
+
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(dataBlock.offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(dataBlock.offset >> 32);
+
+            DWORD bytesWritten;
+            CHECK(WriteFile(fileHandle, block.data(), static_cast<DWORD>(block.size()), &bytesWritten, &overlapped) && bytesWritten == block.size(), L"Failed to write a block");
+        }
+    };
+
+    Testing::TestFile afterHoleFile(GetTestDirectory(), L"afterhole.bin", std::span<const char>());
+    Testing::TestFile beforeHoleFile(GetTestDirectory(), L"beforehole.bin", std::span<const char>());
+    Testing::TestFile acrossHoleFile(GetTestDirectory(), L"acrosshole.bin", std::span<const char>());
+    Testing::TestFile emptyFile(GetTestDirectory(), L"empty.bin", std::span<const char>());
+
+    writeSparseFile(afterHoleFile, { { kMiddle, "needle", false } });
+    writeSparseFile(beforeHoleFile, { { kMiddle - kBlockSize, "needle", true } });
+    writeSparseFile(acrossHoleFile, { { kMiddle - kBlockSize, "nee", true }, { kMiddle + kBlockSize, "dle", false } });
+    writeSparseFile(emptyFile, {});
+
+    struct TestContext
+    {
+        Event<EventType::ManualReset> doneEvent;
+        std::vector<std::wstring> foundPaths;
+        SearchStatistics statistics;
+    } testContext;
+
+    auto searcher = ::Search(
+        [](void* context, const WIN32_FIND_DATAW&, const wchar_t* path) { static_cast<TestContext*>(context)->foundPaths.emplace_back(path); },
+        [](void*, const SearchStatistics&, double) {},
+        [](void* context, const SearchStatistics& searchStatistics)
+        {
+            auto testContext = static_cast<TestContext*>(context);
+            testContext->statistics = searchStatistics;
+            testContext->doneEvent.Set();
+        },
+        [](void*, const wchar_t*) {},
+        GetTestDirectory().c_str(),
+        L"*",
+        L"needle",
+        SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | ExtraSearchFlags,
+        std::numeric_limits<uint64_t>::max(),
+        std::numeric_limits<uint64_t>::max(),
+        0,
+        0,
+        &testContext);
+
+    CHECK(searcher != nullptr, L"Failed to start search");
+
+    auto waitResult = WaitForSingleObject(testContext.doneEvent, INFINITE);
+    CHECK(waitResult == WAIT_OBJECT_0, L"Failed to wait for search operation to complete");
+    CleanupSearchOperation(searcher);
+
+    std::sort(testContext.foundPaths.begin(), testContext.foundPaths.end());
+
+    std::vector<std::wstring> expectedResults = { afterHoleFile.GetPath(), beforeHoleFile.GetPath() };
+    std::sort(expectedResults.begin(), expectedResults.end());
+
+    CHECK(testContext.foundPaths == expectedResults, std::format(L"Expected {} search results, found {}", expectedResults.size(), testContext.foundPaths.size()));
+
+    // Only the overlapped reader skips holes. It reads each file's first chunk and the chunks around its blocks, which comes to a fraction
+    // of one file, where reading the holes too would take all four
+    if constexpr (ExtraSearchFlags == SearchFlags::kUseOverlappedIO)
+    {
+        const auto bytesRead = static_cast<uint64_t>(testContext.statistics.bytesReadFromCache + testContext.statistics.bytesReadFromDisk);
+        CHECK(bytesRead < kFileSize, std::format(L"Expected less than {} bytes read from cache or disk, counted {}", kFileSize, bytesRead));
+    }
+}
+
+SEARCH_TEST(GzipFilesAreSearchedDecompressed)
+{
+    // Stored blocks keep a compressor out of the test, and a match split by a block header can only be found in the decompressed text
+    auto appendGzipMember = [](std::vector<char>& file, std::string_view contents, size_t blockSize)
+    {
+        const char header[] = { 0x1F, static_cast<char>(0x8B), 8, 0, 0, 0, 0, 0, 0, static_cast<char>(0xFF) };
+        file.insert(file.end(), header, header + sizeof(header));
+
+        for (size_t offset = 0;; offset += blockSize)
+        {
+            const auto length = static_cast<uint16_t>(std::min(blockSize, contents.size() - offset));
+            const bool isLastBlock = offset + length == contents.size();
+            const char blockHeader[] = { static_cast<char>(isLastBlock), static_cast<char>(length), static_cast<char>(length >> 8), static_cast<char>(~length), static_cast<char>(~length >> 8) };
+            file.insert(file.end(), blockHeader, blockHeader + sizeof(blockHeader));
+            file.insert(file.end(), contents.data() + offset, contents.data() + offset + length);
+
+            if (isLastBlock)
+                break;
+        }
+
+        uint32_t crc = 0xFFFFFFFF;
+        for (auto c : contents)
+        {
+            crc ^= static_cast<uint8_t>(c);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+
+        const uint32_t trailer[] = { ~crc, static_cast<uint32_t>(contents.size()) };
+        file.insert(file.end(), reinterpret_cast<const char*>(trailer), reinterpret_cast<const char*>(trailer) + sizeof(trailer));
+    };
+
+    auto makeText = [](size_t length, size_t needleOffset)
+    {
+        std::string text(length, 'x');
+        if (needleOffset != std::string::npos)
+            text.replace(needleOffset, 6, "needle");
+
+        return text;
+    };
+
+    // Big enough to be read in chunks. The second one has its match across two blocks of decompressed output as well
+    std::vector<char> splitByBlockHeader, splitByOutputBlock, rotated, quiet;
+    appendGzipMember(splitByBlockHeader, makeText(3 * 1024 * 1024, 40 * 65535 - 3), 65535);
+    appendGzipMember(splitByOutputBlock, makeText(600 * 1024, 256 * 1024 - 3), 32768);
+    appendGzipMember(quiet, makeText(3 * 1024 * 1024, std::string::npos), 65535);
+
+    // Small enough to be read whole, with the match in its second member
+    appendGzipMember(rotated, makeText(4000, std::string::npos), 1000);
+    appendGzipMember(rotated, makeText(4000, 997), 1000);
+
+    constexpr char kPlainText[] = "a needle that isn't compressed";
+
+    Testing::TestFile splitByBlockHeaderFile(GetTestDirectory(), L"splitbyblockheader.log.gz", splitByBlockHeader);
+    Testing::TestFile splitByOutputBlockFile(GetTestDirectory(), L"splitbyoutputblock.log.gz", splitByOutputBlock);
+    Testing::TestFile rotatedFile(GetTestDirectory(), L"rotated.log.gz", rotated);
+    Testing::TestFile quietFile(GetTestDirectory(), L"quiet.log.gz", quiet);
+    Testing::TestFile plainFile(GetTestDirectory(), L"plain.log", std::span<const char>(kPlainText, sizeof(kPlainText) - 1));
+
+    // Compressed files aren't binary once decompressed, so skipping binary files doesn't skip them
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSkipBinaryFiles | SearchFlags::kSearchCompressedFiles);
+    std::sort(searchResults.begin(), searchResults.end());
+
+    // Only the Overlapped reader decompresses. The others search the compressed bytes, where the matches are all split or the file is binary
+    std::vector<std::wstring> expectedResults = { plainFile.GetPath() };
+    if constexpr (ExtraSearchFlags == SearchFlags::kUseOverlappedIO)
+        expectedResults.insert(expectedResults.end(), { splitByBlockHeaderFile.GetPath(), splitByOutputBlockFile.GetPath(), rotatedFile.GetPath() });
+
+    std::sort(expectedResults.begin(), expectedResults.end());
+    CHECK(searchResults == expectedResults, std::format(L"Expected {} search results, found {}", expectedResults.size(), searchResults.size()));
+}
+
+SEARCH_TEST(ArchiveMembersAreSearchedByNameAndContents)
+{
+    struct ArchiveMember
+    {
+        std::string_view path;
+        std::string_view contents;
+    };
+
+    const ArchiveMember kMembers[] =
+    {
+        { "docs/readme.txt", "a needle in the docs" },
+        { "src/needle.cpp", "nothing to see" },
+        { "src/main.cpp", "nothing here either" },
+    };
+
+    auto appendInteger = [](std::vector<char>& file, uint32_t value, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            file.push_back(static_cast<char>(value >> (8 * i)));
+    };
+
+    // Stored members keep a compressor out of the test. A zip lists them in its central directory, at the end of the file
+    std::vector<char> zip, centralDirectory;
+    for (const auto& member : kMembers)
+    {
+        uint32_t crc = 0xFFFFFFFF;
+        for (auto c : member.contents)
+        {
+            crc ^= static_cast<uint8_t>(c);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+
+        const auto localHeaderOffset = static_cast<uint32_t>(zip.size());
+        const auto size = static_cast<uint32_t>(member.contents.size());
+        const auto pathLength = static_cast<uint32_t>(member.path.size());
+
+        appendInteger(zip, 0x04034B50, 4);
+        appendInteger(zip, 20, 2);
+        appendInteger(zip, 0, 4); // Flags, stored
+        appendInteger(zip, 0x00210000, 4); // 1 January 1980
+        appendInteger(zip, ~crc, 4);
+        appendInteger(zip, size, 4);
+        appendInteger(zip, size, 4);
+        appendInteger(zip, pathLength, 2);
+        appendInteger(zip, 0, 2);
+        zip.insert(zip.end(), member.path.begin(), member.path.end());
+        zip.insert(zip.end(), member.contents.begin(), member.contents.end());
+
+        appendInteger(centralDirectory, 0x02014B50, 4);
+        appendInteger(centralDirectory, 20, 2);
+        appendInteger(centralDirectory, 20, 2);
+        appendInteger(centralDirectory, 0, 4);
+        appendInteger(centralDirectory, 0x00210000, 4);
+        appendInteger(centralDirectory, ~crc, 4);
+        appendInteger(centralDirectory, size, 4);
+        appendInteger(centralDirectory, size, 4);
+        appendInteger(centralDirectory, pathLength, 2);
+        appendInteger(centralDirectory, 0, 4); // Extra field and comment
+        appendInteger(centralDirectory, 0, 4); // Disk and internal attributes
+        appendInteger(centralDirectory, 0, 4); // External attributes
+        appendInteger(centralDirectory, localHeaderOffset, 4);
+        centralDirectory.insert(centralDirectory.end(), member.path.begin(), member.path.end());
+    }
+
+    const auto centralDirectoryOffset = static_cast<uint32_t>(zip.size());
+    zip.insert(zip.end(), centralDirectory.begin(), centralDirectory.end());
+    appendInteger(zip, 0x06054B50, 4);
+    appendInteger(zip, 0, 4);
+    appendInteger(zip, static_cast<uint32_t>(std::size(kMembers)), 2);
+    appendInteger(zip, static_cast<uint32_t>(std::size(kMembers)), 2);
+    appendInteger(zip, static_cast<uint32_t>(centralDirectory.size()), 4);
+    appendInteger(zip, centralDirectoryOffset, 4);
+    appendInteger(zip, 0, 2);
+
+    // A tar is a header in front of every member, and its data padded to whole blocks
+    std::vector<char> tar;
+    for (const auto& member : kMembers)
+    {
+        char header[512] = {};
+        memcpy(header, member.path.data(), member.path.size());
+        memcpy(header + 100, "0000644", 7);
+        snprintf(header + 124, 12, "%011o", static_cast<uint32_t>(member.contents.size()));
+        memcpy(header + 136, "00000000000", 11);
+        header[156] = '0';
+        memcpy(header + 257, "ustar\0" "00", 8);
+
+        uint32_t checksum = 0;
+        for (size_t i = 0; i < sizeof(header); i++)
+            checksum += i >= 148 && i < 156 ? ' ' : static_cast<uint8_t>(header[i]);
+
+        snprintf(header + 148, 8, "%06o", checksum);
+        header[155] = ' ';
+
+        tar.insert(tar.end(), header, header + sizeof(header));
+        tar.insert(tar.end(), member.contents.begin(), member.contents.end());
+        tar.resize((tar.size() + 511) / 512 * 512);
+    }
+
+    tar.resize(tar.size() + 1024);
+
+    Testing::TestFile zipFile(GetTestDirectory(), L"bundle.zip", zip);
+    Testing::TestFile tarFile(GetTestDirectory(), L"bundle.tar", tar);
+
+    // Only the Overlapped reader looks inside archives. The others search the archives themselves, and stored members are right there in them
+    auto searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileContents | SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kSearchInArchives);
+    std::sort(searchResults.begin(), searchResults.end());
+
+    std::vector<std::wstring> expectedResults = { zipFile.GetPath(), tarFile.GetPath() };
+    if constexpr (ExtraSearchFlags == SearchFlags::kUseOverlappedIO)
+        expectedResults = { zipFile.GetPath() + L"!docs\\readme.txt", tarFile.GetPath() + L"!docs\\readme.txt" };
+
+    std::sort(expectedResults.begin(), expectedResults.end());
+    CHECK(searchResults == expectedResults, std::format(L"Expected {} search results, found {}", expectedResults.size(), searchResults.size()));
+
+    // Members are matched by name without searching contents at all
+    searchResults = PerformTestSearch(L"*", L"needle", SearchFlags::kSearchForFiles | SearchFlags::kSearchInFileName | SearchFlags::kSearchInArchives);
+    std::sort(searchResults.begin(), searchResults.end());
+
+    expectedResults.clear();
+    if constexpr (ExtraSearchFlags == SearchFlags::kUseOverlappedIO)
+        expectedResults = { zipFile.GetPath() + L"!src\\needle.cpp", tarFile.GetPath() + L"!src\\needle.cpp" };
+
+    std::sort(expectedResults.begin(), expectedResults.end());
+    CHECK(searchResults == expectedResults, std::format(L"Expected {} search results, found {}", expectedResults.size(), searchResults.size()));
+}
+
+TEST(StreamSearcherReportsMatchesAcrossChunks)
+{
+    constexpr char kStream[] = "a NEEDLE, then a needle split across chunks, and needleneedle";
+    std::vector<uint64_t> matchOffsets;
+
+    auto streamSearcher = ::CreateStreamSearcher(L"needle", SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreCase, [](void* context, uint64_t matchOffset)
+    {
+        static_cast<std::vector<uint64_t>*>(context)->push_back(matchOffset);
+    }, &matchOffsets);
+
+    CHECK(streamSearcher != nullptr, L"Failed to create stream searcher");
+
+    // Feeding one byte at a time splits every occurrence, and the input must come back unmodified
+    std::string stream(kStream);
+    for (size_t i = 0; i < stream.length(); i++)
+        ::FeedStreamSearcher(streamSearcher, reinterpret_cast<const uint8_t*>(stream.data() + i), 1);
+
+    CHECK(stream == kStream, L"Stream searcher modified its input");
+    CHECK(matchOffsets == std::vector<uint64_t>({ 2, 17, 49, 55 }), std::format(L"Expected 4 matches at the right offsets, found {}", matchOffsets.size()));
+
+    matchOffsets.clear();
+    ::ResetStreamSearcher(streamSearcher);
+    ::FeedStreamSearcher(streamSearcher, reinterpret_cast<const uint8_t*>(stream.data()), stream.length());
+    CHECK(matchOffsets == std::vector<uint64_t>({ 2, 17, 49, 55 }), L"Feeding the whole stream at once found different matches");
+
+    ::FreeStreamSearcher(streamSearcher);
+}
+
+TEST(SearchBuffersReportsMatchesPerBufferWithoutModifyingThem)
+{
+    constexpr char kMatching[] = "some NEEDLE in a buffer";
+    constexpr char kNotMatching[] = "NEEDL E";
+
+    // Big enough to be split across work items, with the match straddling two of them
+    std::vector<char> bigBuffer(20 * 1024 * 1024, 'X');
+    memcpy(bigBuffer.data() + 16 * 1024 * 1024 - 3, "Needle", 6);
+    const auto bigBufferCopy = bigBuffer;
+
+    const SearchBuffer buffers[] =
+    {
+        { kMatching, sizeof(kMatching) - 1 },
+        { kNotMatching, sizeof(kNotMatching) - 1 },
+        { nullptr, 0 },
+        { bigBuffer.data(), bigBuffer.size() },
+    };
+
+    auto bufferSearcher = ::CreateBufferSearcher(L"needle", SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kIgnoreCase);
+    CHECK(bufferSearcher != nullptr, L"Failed to create buffer searcher");
+
+    bool matches[ARRAYSIZE(buffers)];
+    ::SearchBuffers(bufferSearcher, buffers, ARRAYSIZE(buffers), matches);
+    ::FreeBufferSearcher(bufferSearcher);
+
+    CHECK(matches[0] && !matches[1] && !matches[2] && matches[3], L"Wrong buffers reported as matching");
+    CHECK(strcmp(kMatching, "some NEEDLE in a buffer") == 0 && bigBuffer == bigBufferCopy, L"Buffer search modified its input");
+}
\ No newline at end of file
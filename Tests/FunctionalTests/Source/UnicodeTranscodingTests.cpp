@@ -0,0 +1,118 @@
+#include "PrecompiledHeader.h"
+#include "TestMacros.h"
+#include "UnicodeTranscoding.h"
+
+// These only use UnicodeTranscoding.h, with char16_t code units and expected bytes spelled out, so they mean the same wherever it's built.
+// The vectorized ASCII paths copy 16 bytes or 8 code units at a time with SSE2 and 8 bytes or 4 code units without it
+
+static std::string ToUtf8(std::u16string_view utf16)
+{
+    std::string utf8(StringUtils::GetMaxUtf8Length(utf16.length()), '\0');
+    utf8.resize(StringUtils::Utf16ToUtf8(utf16.data(), utf16.length(), utf8.data()));
+    return utf8;
+}
+
+static std::u16string ToUtf16(std::string_view utf8)
+{
+    std::u16string utf16(StringUtils::GetMaxUtf16Length(utf8.length()), u'\0');
+    utf16.resize(StringUtils::Utf8ToUtf16(utf8.data(), utf8.length(), utf16.data()));
+    return utf16;
+}
+
+TEST(UnicodeTranscodingAsciiRunBoundaries)
+{
+    struct NonAsciiCharacter
+    {
+        std::u16string_view utf16;
+        std::string_view utf8;
+    };
+
+    const NonAsciiCharacter kNonAsciiCharacters[] =
+    {
+        { u"\u00E9", "\xC3\xA9" },
+        { u"\u20AC", "\xE2\x82\xAC" },
+        { u"\U0001F600", "\xF0\x9F\x98\x80" },
+    };
+
+    // Every ASCII run length across two vector widths, with a non-ASCII character at every position, so that the vectorized loops
+    // stop and pick up again at each offset within a block
+    for (size_t length = 0; length <= 40; length++)
+    {
+        std::u16string asciiUtf16;
+        std::string asciiUtf8;
+
+        for (size_t i = 0; i < length; i++)
+        {
+            const auto c = static_cast<char>(0x20 + (i * 7) % 0x60);
+            asciiUtf16 += static_cast<char16_t>(c);
+            asciiUtf8 += c;
+        }
+
+        CHECK(ToUtf8(asciiUtf16) == asciiUtf8, std::format(L"Encoding {} ASCII characters changed them", length));
+        CHECK(ToUtf16(asciiUtf8) == asciiUtf16, std::format(L"Decoding {} ASCII characters changed them", length));
+
+        for (const auto& nonAscii : kNonAsciiCharacters)
+        {
+            for (size_t position = 0; position <= length; position++)
+            {
+                auto utf16 = asciiUtf16;
+                utf16.insert(position, nonAscii.utf16);
+
+                auto utf8 = asciiUtf8;
+                utf8.insert(position, nonAscii.utf8);
+
+                CHECK(ToUtf8(utf16) == utf8, std::format(L"Encoding U+{:X} after {} of {} ASCII characters went wrong", static_cast<uint32_t>(nonAscii.utf16[0]), position, length));
+                CHECK(ToUtf16(utf8) == utf16, std::format(L"Decoding U+{:X} after {} of {} ASCII characters went wrong", static_cast<uint32_t>(nonAscii.utf16[0]), position, length));
+            }
+        }
+    }
+}
+
+TEST(UnicodeTranscodingSurrogatePairs)
+{
+    // The first and last supplementary code points, and the BMP code points right around the surrogate range
+    CHECK(ToUtf8(u"\U00010000") == "\xF0\x90\x80\x80", L"U+10000 was not encoded as 4 bytes");
+    CHECK(ToUtf8(u"\U0010FFFF") == "\xF4\x8F\xBF\xBF", L"U+10FFFF was not encoded as 4 bytes");
+    CHECK(ToUtf8(u"\uD7FF\uE000\uFFFF") == "\xED\x9F\xBF" "\xEE\x80\x80" "\xEF\xBF\xBF", L"Code points next to the surrogate range were not encoded as 3 bytes");
+
+    CHECK(ToUtf16("\xF0\x90\x80\x80") == u"\U00010000", L"U+10000 was not decoded into a surrogate pair");
+    CHECK(ToUtf16("\xF4\x8F\xBF\xBF") == u"\U0010FFFF", L"U+10FFFF was not decoded into a surrogate pair");
+    CHECK(ToUtf16("\xED\x9F\xBF" "\xEE\x80\x80" "\xEF\xBF\xBF") == u"\uD7FF\uE000\uFFFF", L"Code points next to the surrogate range were not decoded");
+
+    // Pairs back to back, and one split from the ASCII before and after it
+    CHECK(ToUtf8(u"\U0001F600\U0001F601") == "\xF0\x9F\x98\x80" "\xF0\x9F\x98\x81", L"Adjacent surrogate pairs were not encoded");
+    CHECK(ToUtf16("abcdefghijklmnop\xF0\x9F\x98\x80qrstuvwxyz") == u"abcdefghijklmnop\U0001F600qrstuvwxyz", L"A surrogate pair between ASCII runs was not decoded");
+}
+
+TEST(UnicodeTranscodingReplacesLoneSurrogates)
+{
+    // Each lone surrogate becomes one U+FFFD, and doesn't take the code unit after it along
+    CHECK(ToUtf8(std::u16string(u"a\xD800", 2)) == "a\xEF\xBF\xBD", L"A high surrogate at the end was not replaced");
+    CHECK(ToUtf8(std::u16string(u"\xD800" u"b", 2)) == "\xEF\xBF\xBD" "b", L"A high surrogate followed by ASCII was not replaced");
+    CHECK(ToUtf8(std::u16string(u"\xDC00" u"b", 2)) == "\xEF\xBF\xBD" "b", L"A low surrogate on its own was not replaced");
+    CHECK(ToUtf8(std::u16string(u"\xDC00\xD800", 2)) == "\xEF\xBF\xBD" "\xEF\xBF\xBD", L"A pair in the wrong order was not replaced unit by unit");
+    CHECK(ToUtf8(std::u16string(u"\xD800\xD83D\xDE00", 3)) == "\xEF\xBF\xBD" "\xF0\x9F\x98\x80", L"A high surrogate before a valid pair took the pair along");
+    CHECK(ToUtf8(std::u16string(u"\xD800\u00E9", 2)) == "\xEF\xBF\xBD" "\xC3\xA9", L"A high surrogate before a 2 byte character took it along");
+}
+
+TEST(UnicodeTranscodingReplacesInvalidUtf8)
+{
+    // Overlong forms are caught at their first byte or their second, and each byte left over becomes its own U+FFFD
+    CHECK(ToUtf16("\xC0\xAF") == u"\uFFFD\uFFFD", L"An overlong 2 byte form was not replaced");
+    CHECK(ToUtf16("\xC1\xBF") == u"\uFFFD\uFFFD", L"An overlong 2 byte form was not replaced");
+    CHECK(ToUtf16("\xE0\x80\xAF") == u"\uFFFD\uFFFD\uFFFD", L"An overlong 3 byte form was not replaced");
+    CHECK(ToUtf16("\xF0\x80\x80\xAF") == u"\uFFFD\uFFFD\uFFFD\uFFFD", L"An overlong 4 byte form was not replaced");
+
+    // Encoded surrogates, code points past U+10FFFF, and bytes that can't start a sequence
+    CHECK(ToUtf16("\xED\xA0\x80") == u"\uFFFD\uFFFD\uFFFD", L"An encoded surrogate was not replaced");
+    CHECK(ToUtf16("\xF4\x90\x80\x80") == u"\uFFFD\uFFFD\uFFFD\uFFFD", L"A code point past U+10FFFF was not replaced");
+    CHECK(ToUtf16("a\x80" "b\xF5" "c\xFF") == u"a\uFFFD" u"b\uFFFD" u"c\uFFFD", L"Bytes that can't start a sequence were not replaced");
+
+    // A truncated sequence becomes one U+FFFD, and whatever cut it short is decoded on its own
+    CHECK(ToUtf16("a\xC3") == u"a\uFFFD", L"A 2 byte sequence truncated by the end was not replaced");
+    CHECK(ToUtf16("a\xE2\x82") == u"a\uFFFD", L"A 3 byte sequence truncated by the end was not replaced");
+    CHECK(ToUtf16("a\xF0\x9F\x98") == u"a\uFFFD", L"A 4 byte sequence truncated by the end was not replaced");
+    CHECK(ToUtf16("\xE2\x82" "b") == u"\uFFFD" u"b", L"A 3 byte sequence truncated by ASCII was not replaced");
+    CHECK(ToUtf16("\xE2\x82\xC3\xA9") == u"\uFFFD\u00E9", L"A 3 byte sequence truncated by another sequence was not replaced");
+    CHECK(ToUtf16("\xF0\x9F\x98\xF0\x9F\x98\x80") == u"\uFFFD\U0001F600", L"A 4 byte sequence truncated by another one was not replaced");
+}
\ No newline at end of file
@@ -105,3 +105,49 @@ DEFINE_CONTENT_PERFORMANCE_TEST_DATA_LAYOUT(MixedFilesBySize, SourceFilesSearchL
 DEFINE_FILE_CONTENTS_PERFORMANCE_TESTS(ShortSearchString);
 DEFINE_FILE_CONTENTS_PERFORMANCE_TESTS(LongSearchString);
 DEFINE_FILE_CONTENTS_PERFORMANCE_TESTS(UnicodeSearchString);
+
+
+// Sweeps the read chunk size over the sizes the default policy picks from and a few beyond them, on a mix of file sizes and on large files alone
+#define DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, ChunkSizeKB) \
+    static Testing::ReadOverridePerformanceTestT<Testing::PerformanceIntegrationTestWrapper<FileContentsPathPerformanceTest<&k##Files##Layout, SearchString>, SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kUseOverlappedIO>, \
+        &SetReadChunkSizeOverride, ChunkSizeKB * 1024, L"ReadChunkSize_" L#Files L"_" L#SearchString L"_" L#ChunkSizeKB L"KB"> s_ReadChunkSize_##Files##_##SearchString##_##ChunkSizeKB##_instance
+
+#define DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TESTS(Files, SearchString) \
+    DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, 64); \
+    DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, 256); \
+    DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, 1024); \
+    DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, 4096); \
+    DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, 8192); \
+    DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TEST(Files, SearchString, 32768);
+
+DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TESTS(MixedFilesBySize, ShortSearchString);
+DEFINE_READ_CHUNK_SIZE_PERFORMANCE_TESTS(BinaryFiles, ShortSearchString);
+
+// Sweeps how many reads are kept in flight, from one per search thread to far more than any device queues
+#define DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, QueueDepth) \
+    static Testing::ReadOverridePerformanceTestT<Testing::PerformanceIntegrationTestWrapper<FileContentsPathPerformanceTest<&k##Files##Layout, SearchString>, SearchFlags::kSearchContentsAsUtf8 | SearchFlags::kUseOverlappedIO>, \
+        &SetReadQueueDepthOverride, QueueDepth, L"ReadQueueDepth_" L#Files L"_" L#SearchString L"_" L#QueueDepth> s_ReadQueueDepth_##Files##_##SearchString##_##QueueDepth##_instance
+
+#define DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TESTS(Files, SearchString) \
+    DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, 1); \
+    DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, 16); \
+    DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, 32); \
+    DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, 64); \
+    DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, 128); \
+    DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TEST(Files, SearchString, 256);
+
+DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TESTS(MixedFilesBySize, ShortSearchString);
+DEFINE_READ_QUEUE_DEPTH_PERFORMANCE_TESTS(LargeSourceFiles, ShortSearchString);
+
+// Cancels searches partway through, on every read backend, with large files that keep chunked reads in flight and with a mix of file sizes
+#define DEFINE_CANCEL_LATENCY_PERFORMANCE_TEST(Files, SearchString, Backend, BackendSearchFlags) \
+    static Testing::CancelLatencyPerformanceTestT<Testing::PerformanceIntegrationTestWrapper<FileContentsPathPerformanceTest<&k##Files##Layout, SearchString>, SearchFlags::kSearchContentsAsUtf8 | BackendSearchFlags>, \
+        L"CancelLatency_" L#Files L"_" L#SearchString L"_" L#Backend> s_CancelLatency_##Files##_##SearchString##_##Backend##_instance
+
+#define DEFINE_CANCEL_LATENCY_PERFORMANCE_TESTS(Files, SearchString) \
+    DEFINE_CANCEL_LATENCY_PERFORMANCE_TEST(Files, SearchString, OverlappedIO, SearchFlags::kUseOverlappedIO); \
+    DEFINE_CANCEL_LATENCY_PERFORMANCE_TEST(Files, SearchString, DirectStorage, SearchFlags::kUseDirectStorage); \
+    DEFINE_CANCEL_LATENCY_PERFORMANCE_TEST(Files, SearchString, CompletionPort, SearchFlags::kUseCompletionPort);
+
+DEFINE_CANCEL_LATENCY_PERFORMANCE_TESTS(BinaryFiles, ShortSearchString);
+DEFINE_CANCEL_LATENCY_PERFORMANCE_TESTS(MixedFilesBySize, ShortSearchString);
\ No newline at end of file
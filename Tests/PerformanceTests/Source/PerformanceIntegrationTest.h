@@ -1,6 +1,7 @@
 #pragma once
 #include "PerformanceTest.h"
 #include "PerformanceTestDataLayout.h"
+#include "TestLogger.h"
 
 namespace Testing
 {
@@ -128,6 +129,120 @@ namespace Testing
         }
     };
 
+    // Times the search with one of the read tuning overrides set to Value, and checks that it finds what the defaults do
+    template <PerformanceIntegrationTestFull T, void (*SetReadOverride)(uint32_t), uint32_t Value, CompileTimeStringW Name>
+    class ReadOverridePerformanceTestT : PerformanceIntegrationTestBase
+    {
+    public:
+        ReadOverridePerformanceTestT() :
+            PerformanceIntegrationTestBase(Name.value, T::PerformanceTestDataLayout)
+        {
+        }
+
+        void Run(const PreparedPerformanceTestLayout& testLayout) const final override
+        {
+            static constexpr size_t kIterations = 20;
+
+            struct ScopedReadOverride
+            {
+                ScopedReadOverride() { SetReadOverride(Value); }
+                ~ScopedReadOverride() { SetReadOverride(0); }
+            };
+
+            auto expectedPaths = testLayout.PerformTestSearch(T::SearchPattern, T::SearchString.value, T::SearchFlags);
+            std::sort(expectedPaths.begin(), expectedPaths.end());
+
+            ScopedReadOverride readOverride;
+
+            m_MedianTime = RunPerformanceTestIterations(kIterations,
+            [&]()
+            {
+                testLayout.InvalidateTestFileCache();
+            },
+            [&]()
+            {
+                return testLayout.PerformTestSearch(T::SearchPattern, T::SearchString.value, T::SearchFlags);
+            },
+            [&](size_t i, std::vector<std::wstring>& foundPaths)
+            {
+                std::sort(foundPaths.begin(), foundPaths.end());
+                CHECK(foundPaths == expectedPaths, std::format(L"Found {} paths with the override set to {}, but {} with the defaults at iteration #{}", foundPaths.size(), Value, expectedPaths.size(), i));
+            });
+        }
+    };
+
+    // Cancels the search at points spread over the time it takes to run to completion from a cold cache, and times CleanupSearchOperation.
+    // The 99th percentile is what gets compared to the baseline, and it has to stay within the budget CleanupSearchOperation promises
+    template <PerformanceIntegrationTestFull T, CompileTimeStringW Name>
+    class CancelLatencyPerformanceTestT : PerformanceIntegrationTestBase
+    {
+    public:
+        CancelLatencyPerformanceTestT() :
+            PerformanceIntegrationTestBase(Name.value, T::PerformanceTestDataLayout)
+        {
+        }
+
+        void Run(const PreparedPerformanceTestLayout& testLayout) const final override
+        {
+            static constexpr size_t kIterations = 100;
+            static constexpr double kCancelLatencyBudget = 0.1;
+
+            LARGE_INTEGER frequency, start, end;
+            QueryPerformanceFrequency(&frequency);
+
+            testLayout.InvalidateTestFileCache();
+            QueryPerformanceCounter(&start);
+            testLayout.PerformTestSearch(T::SearchPattern, T::SearchString.value, T::SearchFlags);
+            QueryPerformanceCounter(&end);
+
+            const double searchTime = static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+            std::vector<double> cancelLatencies;
+            cancelLatencies.resize(kIterations);
+
+            for (size_t i = 0; i < kIterations; i++)
+            {
+                std::vector<std::wstring> errors;
+                testLayout.InvalidateTestFileCache();
+
+                auto searcher = ::Search(
+                    [](void*, const WIN32_FIND_DATAW&, const wchar_t*) {},
+                    [](void*, const SearchStatistics&, double) {},
+                    [](void*, const SearchStatistics&) {},
+                    [](void* context, const wchar_t* errorMessage) { static_cast<std::vector<std::wstring>*>(context)->emplace_back(errorMessage); },
+                    testLayout.GetTestDirectory().c_str(),
+                    T::SearchPattern,
+                    T::SearchString.value,
+                    T::SearchFlags,
+                    std::numeric_limits<uint64_t>::max(),
+                    std::numeric_limits<uint64_t>::max(),
+                    0,
+                    0,
+                    &errors);
+
+                CHECK(searcher != nullptr, std::format(L"Failed to start the search at iteration #{}", i));
+
+                Sleep(static_cast<DWORD>(searchTime * 1000.0 * (i + 0.5) / kIterations));
+
+                QueryPerformanceCounter(&start);
+                CleanupSearchOperation(searcher);
+                QueryPerformanceCounter(&end);
+
+                CHECK(errors.empty(), std::format(L"Search operation encountered {} errors at iteration #{}", errors.size(), i));
+                cancelLatencies[i] = static_cast<double>(end.QuadPart - start.QuadPart) / frequency.QuadPart;
+            }
+
+            std::sort(cancelLatencies.begin(), cancelLatencies.end());
+            const auto medianLatency = cancelLatencies[kIterations / 2];
+            const auto p99Latency = cancelLatencies[kIterations * 99 / 100 - 1];
+            m_MedianTime = p99Latency;
+
+            PrintToStdout(std::format(L"    Cancel latency: {:.2f} ms median, {:.2f} ms 99th percentile, {:.2f} ms worst, cancelling a {:.2f} ms search\r\n",
+                medianLatency * 1000.0, p99Latency * 1000.0, cancelLatencies.back() * 1000.0, searchTime * 1000.0));
+
+            CHECK(p99Latency <= kCancelLatencyBudget, std::format(L"99th percentile cancel latency of {:.2f} ms is over the {:.0f} ms budget", p99Latency * 1000.0, kCancelLatencyBudget * 1000.0));
+        }
+    };
+
     template <PerformanceIntegrationTest T, CompileTimeStringW TestName>
     struct ContentPerformanceTestWithoutUtf8IgnoreCaseT :
         PerformanceIntegrationTestT<PerformanceIntegrationTestWrapper<T, SearchFlags::kSearchContentsAsUtf8>, TestName + L"_UTF8">,
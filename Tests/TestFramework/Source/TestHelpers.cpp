@@ -94,7 +94,7 @@ Testing::TestFile::TestFile(const TestDirectory& testDirectory, std::wstring_vie
 }
 
 template <typename BaseClass>
-std::vector<std::wstring> Testing::SearchTestImpl<BaseClass>::PerformTestSearch(const wchar_t* searchPattern, const wchar_t* searchString, SearchFlags searchFlags, uint64_t ignoreFilesLargerThan) const
+std::vector<std::wstring> Testing::SearchTestImpl<BaseClass>::PerformTestSearch(const wchar_t* searchPattern, const wchar_t* searchString, SearchFlags searchFlags, uint64_t ignoreFilesLargerThan, uint64_t maxResults) const
 {
     struct TestContext
     {
@@ -128,6 +128,9 @@ std::vector<std::wstring> Testing::SearchTestImpl<BaseClass>::PerformTestSearch(
         searchString,
         searchFlags | m_ExtraSearchFlags,
         ignoreFilesLargerThan,
+        maxResults,
+        0,
+        0,
         &testContext);
 
     if (searcher != nullptr)
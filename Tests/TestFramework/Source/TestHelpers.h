@@ -83,7 +83,7 @@ namespace Testing
             return *m_TestDirectory;
         }
 
-        std::vector<std::wstring> PerformTestSearch(const wchar_t* searchPattern, const wchar_t* searchString, SearchFlags searchFlags, uint64_t ignoreFilesLargerThan = std::numeric_limits<uint64_t>::max()) const;
+        std::vector<std::wstring> PerformTestSearch(const wchar_t* searchPattern, const wchar_t* searchString, SearchFlags searchFlags, uint64_t ignoreFilesLargerThan = std::numeric_limits<uint64_t>::max(), uint64_t maxResults = std::numeric_limits<uint64_t>::max()) const;
 
     protected:
         mutable std::optional<Testing::TestDirectory> m_TestDirectory;
@@ -26,8 +26,9 @@
         }                                                                                                       \
         void Run() const final override;                                                                        \
     };                                                                                                          \
-    Test_##name<SearchFlags::kNone> Test_##name##Overlapped_instance(L#name ## "Overlapped");                   \
+    Test_##name<SearchFlags::kUseOverlappedIO> Test_##name##Overlapped_instance(L#name ## "Overlapped");        \
     Test_##name<SearchFlags::kUseDirectStorage> Test_##name##DirectStorage_instance(L#name ## "DirectStorage"); \
+    Test_##name<SearchFlags::kUseCompletionPort> Test_##name##CompletionPort_instance(L#name ## "CompletionPort"); \
     template <SearchFlags ExtraSearchFlags>                                                                     \
     void Test_##name<ExtraSearchFlags>::Run() const
 